@@ -7,10 +7,19 @@ QT += network
 
 include(qtsingleapplication/qtsingleapplication.pri)
 
+HEADERS += \
+    controlserver.h \
+    dataserver.h
+
 SOURCES += \
+    controlserver.cpp \
+    dataserver.cpp \
     main.cpp
 
-
-
-
-
+# Benchmark run modes (-peerbench, -ribbonbench, ...), not shipped by default.
+# Build with "qmake CONFIG+=benchmarks" to enable them.
+benchmarks {
+    DEFINES += APP_BENCHMARKS
+    HEADERS += benchmark.h
+    SOURCES += benchmark.cpp
+}
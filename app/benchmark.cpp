@@ -0,0 +1,354 @@
+#include "benchmark.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEvent>
+#include <QtCore/QTextStream>
+#include <QtCore/QThreadPool>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QWidget>
+
+#include <vector>
+
+#include <utils/arena.h>
+#include <utils/taskscheduler.h>
+#include <utils/toolbutton.h>
+
+#include "qtsingleapplication/qtsingleapplication.h"
+
+namespace {
+    enum {
+        Timeout = 5000
+    };
+
+    void printRate(QTextStream &out, const char *name, int count,
+            qint64 elapsed)
+    {
+        elapsed = qMax(elapsed, qint64(1));
+        out << name << ": " << count << " in " << elapsed << " ms, "
+            << qint64(count) * 1000 / elapsed << "/s\n";
+    }
+
+    /*
+        Counts the paints and layout passes of a ribbon. Emulating the font
+        set by ToolButton::paintEvent() formerly, the first paint of every
+        button is followed by a font change.
+    */
+    class RibbonCounter : public QObject
+    {
+    public:
+        explicit RibbonCounter(bool fontChangeOnPaint)
+            : paints(0), layouts(0), m_fontChangeOnPaint(fontChangeOnPaint) {}
+
+        int paints;
+        int layouts;
+
+    protected:
+        bool eventFilter(QObject *object, QEvent *event)
+        {
+            if (event->type() == QEvent::LayoutRequest) {
+                ++layouts;
+            } else if (event->type() == QEvent::Paint) {
+                ++paints;
+                if (m_fontChangeOnPaint && !m_painted.contains(object)) {
+                    m_painted.append(object);
+                    QEvent fontChange(QEvent::FontChange);
+                    QCoreApplication::sendEvent(object, &fontChange);
+                }
+            }
+            return false;
+        }
+
+    private:
+        const bool m_fontChangeOnPaint;
+        QList<QObject *> m_painted;
+    };
+
+    // Tiny unit of work, counts its runs
+    class TinyTask : public QRunnable
+    {
+    public:
+        explicit TinyTask(QAtomicInt *done) : m_done(done) {}
+
+        void run()
+        {
+            volatile int sum = 0;
+            for (int i = 0; i < 100; ++i)
+                sum += i;
+            m_done->ref();
+        }
+
+    private:
+        QAtomicInt *const m_done;
+    };
+
+    // Starts tiny tasks from a worker, as recursive computations do
+    template <typename Pool>
+    class SpawnTask : public QRunnable
+    {
+    public:
+        SpawnTask(Pool *pool, QAtomicInt *done, int children)
+            : m_pool(pool), m_done(done), m_children(children) {}
+
+        void run()
+        {
+            for (int i = 0; i < m_children; ++i)
+                m_pool->start(new TinyTask(m_done));
+        }
+
+    private:
+        Pool *const m_pool;
+        QAtomicInt *const m_done;
+        const int m_children;
+    };
+
+    // Runs count tiny tasks, started by the calling thread if fanout is 0,
+    // by tasks starting fanout tasks each otherwise
+    template <typename Pool>
+    qint64 runTinyTasks(Pool *pool, int count, int fanout)
+    {
+        QAtomicInt done;
+        QElapsedTimer timer;
+        timer.start();
+        if (fanout == 0) {
+            for (int i = 0; i < count; ++i)
+                pool->start(new TinyTask(&done));
+        } else {
+            for (int i = 0; i < count / fanout; ++i)
+                pool->start(new SpawnTask<Pool>(pool, &done, fanout));
+        }
+        pool->waitForDone();
+        return timer.elapsed();
+    }
+
+    // Parsed field of a request
+    struct RequestField
+    {
+        RequestField(const QByteArray &name, const QByteArray &value)
+            : name(name), value(value) {}
+
+        QByteArray name;
+        QByteArray value;
+    };
+
+    /*
+        Parses a request of fields into objects and containers of the arena
+        of scope if not null, of the heap otherwise, as a handler of a
+        typical request does. Returns a checksum so nothing is optimized out.
+    */
+    int handleRequest(const QByteArray &request, Utils::ArenaScope *scope)
+    {
+        typedef std::vector<RequestField *, Utils::ArenaAllocator<RequestField *> >
+            ArenaFields;
+        typedef std::vector<RequestField *> HeapFields;
+
+        const QList<QByteArray> parts = request.split('&');
+        int checksum = 0;
+        if (scope != 0) {
+            Utils::Arena *const arena = scope->arena();
+            ArenaFields fields((Utils::ArenaAllocator<RequestField *>(arena)));
+            fields.reserve(parts.size());
+            foreach (const QByteArray &part, parts) {
+                const int separator = part.indexOf('=');
+                fields.push_back(arena->create<RequestField>(
+                            part.left(separator), part.mid(separator + 1)));
+            }
+            for (size_t i = 0; i < fields.size(); ++i)
+                checksum += fields[i]->name.size() + fields[i]->value.size();
+        } else {
+            HeapFields fields;
+            fields.reserve(parts.size());
+            foreach (const QByteArray &part, parts) {
+                const int separator = part.indexOf('=');
+                fields.push_back(new RequestField(part.left(separator),
+                            part.mid(separator + 1)));
+            }
+            for (size_t i = 0; i < fields.size(); ++i) {
+                checksum += fields[i]->name.size() + fields[i]->value.size();
+                delete fields[i];
+            }
+        }
+        return checksum;
+    }
+
+    // Shows a ribbon of buttons and resizes it round by round
+    qint64 runRibbonRounds(RibbonCounter *counter, int buttons, int rounds)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QWidget ribbon;
+        ribbon.installEventFilter(counter);
+        QHBoxLayout *const layout = new QHBoxLayout(&ribbon);
+        for (int i = 0; i < buttons; ++i) {
+            Utils::ToolButton *const button = new Utils::ToolButton(&ribbon);
+            button->setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
+            button->setText(QString::fromLatin1("Ribbon command %1").arg(i % 16));
+            button->installEventFilter(counter);
+            layout->addWidget(button);
+        }
+
+        ribbon.show();
+        while (!ribbon.testAttribute(Qt::WA_Mapped) && timer.elapsed() < Timeout)
+            QCoreApplication::processEvents();
+        QCoreApplication::processEvents();
+
+        const QSize size = ribbon.size();
+        for (int i = 0; i < rounds; ++i) {
+            ribbon.resize(size.width() + (i % 2) * 16, size.height());
+            ribbon.repaint();
+            QCoreApplication::processEvents();
+        }
+        return timer.elapsed();
+    }
+}
+
+/*!
+    Sends messages to the running instance, e.g. "-peerbench 10000", one
+    connection per message by sendMessage() first, then over the persistent
+    channel by postMessage() with batched acknowledgements. The running
+    instance handles the messages as usual.
+ */
+int Benchmark::runPeer(QtSingleApplication *app, const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (!app->isRunning()) {
+        err << "No running instance to send messages to\n";
+        return 1;
+    }
+    const int count = qMax(arguments.value(0, "1000").toInt(), 1);
+    const QString message = QLatin1String("peerbench");
+
+    app->setPersistentConnection(false);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        if (!app->sendMessage(message, Timeout)) {
+            err << "sendMessage() failed after " << i << " messages\n";
+            return 2;
+        }
+    }
+    printRate(out, "sendMessage", count, timer.elapsed());
+
+    app->setPersistentConnection(true);
+    timer.restart();
+    for (int i = 0; i < count; ++i) {
+        if (app->postMessage(message, Timeout) == 0) {
+            err << "postMessage() failed after " << i << " messages\n";
+            return 2;
+        }
+    }
+    if (!app->flushMessages(Timeout)) {
+        err << "Messages were not acknowledged\n";
+        return 2;
+    }
+    printRate(out, "postMessage", count, timer.elapsed());
+    return 0;
+}
+
+
+/*!
+    Shows a ribbon of ToolButtons and resizes it, e.g. "-ribbonbench 64 100"
+    for 64 buttons and 100 resizes. Prints the paints and layout passes,
+    once as ToolButton behaves now and once emulating the font change that
+    setting the font in paintEvent() caused before.
+ */
+int Benchmark::runRibbon(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+
+    const int buttons = qMax(arguments.value(0, "64").toInt(), 1);
+    const int rounds = qMax(arguments.value(1, "100").toInt(), 1);
+
+    const char *const names[] = { "font set while painting", "font set once" };
+    for (int i = 0; i < 2; ++i) {
+        RibbonCounter counter(i == 0);
+        const qint64 elapsed = runRibbonRounds(&counter, buttons, rounds);
+        out << names[i] << ": " << buttons << " buttons, " << rounds
+            << " rounds in " << elapsed << " ms, " << counter.paints
+            << " paints, " << counter.layouts << " layouts\n";
+    }
+    return 0;
+}
+
+
+/*!
+    Runs tiny tasks by Utils::TaskScheduler and by QThreadPool with the
+    same number of threads, e.g. "-schedbench 100000 64" for 100000 tasks
+    and tasks starting 64 tasks each. Prints the time of both for tasks
+    started by the main thread and for tasks started by the workers.
+ */
+int Benchmark::runScheduler(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+
+    const int count = qMax(arguments.value(0, "100000").toInt(), 1);
+    const int fanout = qBound(1, arguments.value(1, "64").toInt(), count);
+
+    Utils::TaskScheduler scheduler;
+    QThreadPool pool;
+    pool.setMaxThreadCount(scheduler.workerCount());
+    out << scheduler.workerCount() << " threads\n";
+
+    for (int i = 0; i < 2; ++i) {
+        const int spawned = i == 0 ? 0 : fanout;
+        const char *const name = i == 0
+            ? "started by main thread" : "started by workers";
+        const int tasks = spawned == 0 ? count : count / fanout * fanout;
+
+        printRate(out, (QByteArray("QThreadPool, ") + name).constData(),
+                tasks, runTinyTasks(&pool, count, spawned));
+        const int stolen = scheduler.stolenCount();
+        printRate(out, (QByteArray("TaskScheduler, ") + name).constData(),
+                tasks, runTinyTasks(&scheduler, count, spawned));
+        out << "  " << scheduler.stolenCount() - stolen << " tasks stolen\n";
+    }
+    return 0;
+}
+
+
+/*!
+    Handles requests of many small fields, e.g. "-arenabench 100000 32" for
+    100000 requests of 32 fields, with the objects of each request
+    allocated on the heap and in an ArenaScope. Prints the time of both and
+    how many chunks the arena took from the heap.
+ */
+int Benchmark::runArena(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+
+    const int count = qMax(arguments.value(0, "100000").toInt(), 1);
+    const int fieldCount = qMax(arguments.value(1, "32").toInt(), 1);
+
+    QByteArray request;
+    for (int i = 0; i < fieldCount; ++i) {
+        if (i > 0)
+            request += '&';
+        request += "field" + QByteArray::number(i) + "=value"
+            + QByteArray::number(i * 7919);
+    }
+
+    int checksum = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i)
+        checksum += handleRequest(request, 0);
+    printRate(out, "heap", count, timer.elapsed());
+    out << "  " << qint64(count) * (fieldCount + 1)
+        << " objects and vector buffers allocated from the heap\n";
+
+    Utils::Arena arena;
+    timer.restart();
+    for (int i = 0; i < count; ++i) {
+        Utils::ArenaScope scope(&arena);
+        checksum -= handleRequest(request, &scope);
+    }
+    printRate(out, "arena", count, timer.elapsed());
+    out << "  " << arena.chunkAllocations() << " chunks allocated from the heap, "
+        << arena.bytesReserved() << " bytes reserved\n";
+
+    // Both ways see the same fields
+    return checksum == 0 ? 0 : 2;
+}
@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QtCore/QStringList>
+
+class QtSingleApplication;
+
+/*!
+    \brief Micro-benchmarks run instead of the application.
+
+    Every benchmark prints its timings to the standard output and returns
+    the exit code of the process. The benchmarks are only built with
+    \c {CONFIG+=benchmarks}, release builds of the application do not
+    contain them.
+ */
+class Benchmark
+{
+public:
+    static int runPeer(QtSingleApplication *app, const QStringList &arguments);
+    static int runRibbon(const QStringList &arguments);
+    static int runScheduler(const QStringList &arguments);
+    static int runArena(const QStringList &arguments);
+};
+
+#endif // BENCHMARK_H
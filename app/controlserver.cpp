@@ -0,0 +1,361 @@
+#include "controlserver.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QTextStream>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#include <utils/tracefn.h>
+
+#include <pluginloader/pluginmanager.h>
+#include <pluginloader/pluginspec.h>
+
+namespace {
+    const QDataStream::Version STREAM_VERSION = QDataStream::Qt_4_7;
+
+    QByteArray buildFrame(quint8 code, const QVariant &value)
+    {
+        QByteArray frame;
+        QDataStream out(&frame, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << quint32(0) << code << value;
+        out.device()->seek(0);
+        out << quint32(frame.size() - sizeof(quint32));
+        return frame;
+    }
+
+    QString stateName(PluginLoader::PluginSpec::State state)
+    {
+        switch (state) {
+        case PluginLoader::PluginSpec::Invalid:
+            return QLatin1String("Invalid");
+        case PluginLoader::PluginSpec::Read:
+            return QLatin1String("Read");
+        case PluginLoader::PluginSpec::Resolved:
+            return QLatin1String("Resolved");
+        case PluginLoader::PluginSpec::Loaded:
+            return QLatin1String("Loaded");
+        case PluginLoader::PluginSpec::Initialized:
+            return QLatin1String("Initialized");
+        }
+        return QString();
+    }
+}
+
+/*!
+    Constructs a control server listening on \a serverName once listen() is
+    called.
+ */
+ControlServer::ControlServer(const QString &serverName, QObject *parent)
+    : QObject(parent),
+    m_server(new QLocalServer(this)),
+    m_serverName(serverName)
+{
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+ControlServer::~ControlServer()
+{
+}
+
+/*!
+    Starts listening for incoming requests.
+    \return true on success
+ */
+bool ControlServer::listen()
+{
+    bool listening = m_server->listen(m_serverName);
+#if defined(Q_OS_UNIX)
+    // Socket file left behind by crashed instance, only the running instance
+    // calls this method so nobody else can listen on it
+    if (!listening
+            && m_server->serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalServer::removeServer(m_serverName);
+        listening = m_server->listen(m_serverName);
+    }
+#endif
+    if (!listening) {
+        qWarning("%s: Listen on '%s' failed: %s", Q_FUNC_INFO,
+                qPrintable(m_serverName), qPrintable(m_server->errorString()));
+    }
+    return listening;
+}
+
+//! The name of the local socket the server listens on
+QString ControlServer::serverName() const
+{
+    return m_serverName;
+}
+
+/*!
+    Sends one \a command with \a argument to the control server listening on
+    \a serverName and waits up to \a timeout milliseconds for each step of the
+    communication. Useful for command line clients.
+    \param result filled by the result of the command
+    \param errorString if not null, filled by the reason of the failure
+    \return true if the command was successfully executed
+ */
+bool ControlServer::request(const QString &serverName, Command command,
+        const QVariant &argument, QVariant *result, QString *errorString,
+        int timeout)
+{
+    Q_ASSERT(result != 0);
+
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(timeout)) {
+        if (errorString != 0)
+            *errorString = socket.errorString();
+        return false;
+    }
+
+    socket.write(buildFrame(quint8(command), argument));
+    if (!socket.waitForBytesWritten(timeout)) {
+        if (errorString != 0)
+            *errorString = socket.errorString();
+        return false;
+    }
+
+    QDataStream in(&socket);
+    in.setVersion(STREAM_VERSION);
+
+    quint32 size = 0;
+    while (socket.bytesAvailable() < qint64(sizeof(quint32))) {
+        if (!socket.waitForReadyRead(timeout)) {
+            if (errorString != 0)
+                *errorString = socket.errorString();
+            return false;
+        }
+    }
+    in >> size;
+    while (socket.bytesAvailable() < qint64(size)) {
+        if (!socket.waitForReadyRead(timeout)) {
+            if (errorString != 0)
+                *errorString = socket.errorString();
+            return false;
+        }
+    }
+
+    quint8 status;
+    in >> status >> *result;
+    socket.disconnectFromServer();
+
+    if (in.status() != QDataStream::Ok) {
+        if (errorString != 0)
+            *errorString = tr("Malformed reply");
+        return false;
+    }
+    if (status != Ok) {
+        if (errorString != 0) {
+            *errorString = status == UnknownCommand
+                ? tr("Unknown command") : tr("Bad request");
+        }
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::acceptConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        m_pendingSizes.insert(socket, 0);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(dropConnection()));
+        if (socket->bytesAvailable() > 0)
+            readRequest();
+    }
+}
+
+void ControlServer::readRequest()
+{
+    QLocalSocket *const socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket == 0 || !m_pendingSizes.contains(socket))
+        return;
+
+    // Requests may be pipelined, process all complete frames
+    forever {
+        quint32 size = m_pendingSizes.value(socket);
+        if (size == 0) {
+            if (socket->bytesAvailable() < qint64(sizeof(quint32)))
+                return;
+            QDataStream in(socket);
+            in.setVersion(STREAM_VERSION);
+            in >> size;
+            if (size == 0 || size > MaxRequestSize) {
+                qWarning("%s: Invalid request size %u, dropping client",
+                        Q_FUNC_INFO, size);
+                socket->abort();
+                return;
+            }
+            m_pendingSizes.insert(socket, size);
+        }
+
+        if (socket->bytesAvailable() < qint64(size))
+            return;
+
+        m_pendingSizes.insert(socket, 0);
+        processRequest(socket, socket->read(size));
+    }
+}
+
+void ControlServer::dropConnection()
+{
+    QLocalSocket *const socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket == 0)
+        return;
+
+    m_pendingSizes.remove(socket);
+    socket->deleteLater();
+}
+
+void ControlServer::processRequest(QLocalSocket *socket,
+        const QByteArray &body)
+{
+    QDataStream in(body);
+    in.setVersion(STREAM_VERSION);
+
+    quint8 command;
+    QVariant argument;
+    in >> command >> argument;
+
+    quint8 status = BadRequest;
+    QVariant result;
+    if (in.status() == QDataStream::Ok)
+        result = execute(command, argument, &status);
+
+    socket->write(buildFrame(status, result));
+}
+
+QVariant ControlServer::execute(quint8 command, const QVariant &argument,
+        quint8 *status) const
+{
+    using namespace PluginLoader;
+
+    *status = Ok;
+
+    switch (command) {
+    case Metrics:
+        return PluginManager::instance()->metrics();
+
+    case PluginStates: {
+        QVariantList plugins;
+        foreach (PluginSpec *spec, PluginManager::instance()->pluginSpecs()) {
+            const PluginStatistics statistics = spec->statistics();
+
+            QVariantMap plugin;
+            plugin.insert(QLatin1String("name"), spec->name());
+            plugin.insert(QLatin1String("version"), spec->version());
+            plugin.insert(QLatin1String("state"), stateName(spec->state()));
+            plugin.insert(QLatin1String("enabled"), spec->isEnabled());
+            plugin.insert(QLatin1String("indirectlyDisabled"),
+                    spec->isIndirectlyDisabled());
+            plugin.insert(QLatin1String("error"), spec->errorString());
+            plugin.insert(QLatin1String("loadTime"), statistics.loadTime);
+            plugin.insert(QLatin1String("initializationTime"),
+                    statistics.initializationTime);
+            plugin.insert(QLatin1String("shutdownTime"),
+                    statistics.shutdownTime);
+            plugin.insert(QLatin1String("memoryDelta"),
+                    statistics.memoryDelta);
+            plugin.insert(QLatin1String("thread"), statistics.thread);
+            plugins.append(plugin);
+        }
+        return plugins;
+    }
+
+    case SetTracing: {
+        const bool wasEnabled = Utils::Tracer::isEnabled();
+        if (argument.type() == QVariant::Bool)
+            Utils::Tracer::setEnabled(argument.toBool());
+        else if (argument.isValid())
+            *status = BadRequest;
+        return wasEnabled;
+    }
+
+    default:
+        *status = UnknownCommand;
+        return QVariant();
+    }
+}
+
+/*!
+    Executes the command given by \a arguments against the control server
+    listening on \a serverName and prints the result to standard output.
+    Recognized commands are:
+    \list
+    \o \c metrics - prints the metrics snapshot
+    \o \c plugins - prints state and timings of every plugin
+    \o \c trace [on|off] - switches or queries runtime tracing
+    \endlist
+    \return the process exit code
+ */
+int ControlClient::run(const QString &serverName, const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (arguments.isEmpty()) {
+        err << "Missing control command (metrics, plugins, trace [on|off])\n";
+        return 1;
+    }
+
+    ControlServer::Command command;
+    QVariant argument;
+    const QString name = arguments.at(0);
+    if (name == QLatin1String("metrics")) {
+        command = ControlServer::Metrics;
+    }
+    else if (name == QLatin1String("plugins")) {
+        command = ControlServer::PluginStates;
+    }
+    else if (name == QLatin1String("trace")) {
+        command = ControlServer::SetTracing;
+        if (arguments.count() > 1)
+            argument = arguments.at(1) == QLatin1String("on");
+    }
+    else {
+        err << "Unknown control command '" << name << "'\n";
+        return 1;
+    }
+
+    QVariant result;
+    QString errorString;
+    if (!ControlServer::request(serverName, command, argument, &result,
+                &errorString)) {
+        err << "Control request failed: " << errorString << '\n';
+        return 2;
+    }
+
+    switch (command) {
+    case ControlServer::Metrics: {
+        const QVariantMap metrics = result.toMap();
+        QVariantMap::const_iterator it = metrics.constBegin();
+        for (; it != metrics.constEnd(); ++it)
+            out << it.key() << ": " << it.value().toString() << '\n';
+        break;
+    }
+    case ControlServer::PluginStates:
+        foreach (const QVariant &value, result.toList()) {
+            const QVariantMap plugin = value.toMap();
+            out << plugin.value("name").toString()
+                << ' ' << plugin.value("version").toString()
+                << ' ' << plugin.value("state").toString()
+                << (plugin.value("enabled").toBool() ? "" : " disabled")
+                << (plugin.value("indirectlyDisabled").toBool()
+                        ? " indirectly-disabled" : "")
+                << " load=" << plugin.value("loadTime").toLongLong() << "ms"
+                << " init=" << plugin.value("initializationTime").toLongLong()
+                << "ms mem=" << plugin.value("memoryDelta").toLongLong() / 1024
+                << "KiB\n";
+            const QString error = plugin.value("error").toString();
+            if (!error.isEmpty())
+                out << "    " << error << '\n';
+        }
+        break;
+    case ControlServer::SetTracing:
+        out << "tracing was " << (result.toBool() ? "on" : "off") << '\n';
+        break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+QT_BEGIN_NAMESPACE
+class QLocalServer;
+class QLocalSocket;
+QT_END_NAMESPACE
+
+/*!
+    \brief Local endpoint for inspecting and controlling the running instance.
+
+    The server listens on a local socket next to the one used by
+    QtSingleApplication and answers small binary requests. Every request and
+    reply is a frame prefixed by its size (quint32). A request consists of a
+    command (quint8) and an argument (QVariant), a reply of a status (quint8)
+    and a result (QVariant), both serialized with QDataStream.
+ */
+class ControlServer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ControlServer)
+
+public:
+    enum Command {
+        //! Snapshot of PluginManager::metrics()
+        Metrics = 1,
+        //! State and timings of every plugin
+        PluginStates = 2,
+        //! Switches runtime tracing if the argument is a bool, queries otherwise
+        SetTracing = 3
+    };
+
+    enum Status {
+        Ok = 0,
+        UnknownCommand = 1,
+        BadRequest = 2
+    };
+
+    explicit ControlServer(const QString &serverName, QObject *parent = 0);
+    virtual ~ControlServer();
+
+    bool listen();
+    QString serverName() const;
+
+    static bool request(const QString &serverName, Command command,
+            const QVariant &argument, QVariant *result,
+            QString *errorString = 0, int timeout = 5000);
+
+private slots:
+    void acceptConnection();
+    void readRequest();
+    void dropConnection();
+
+private:
+    void processRequest(QLocalSocket *socket, const QByteArray &body);
+    QVariant execute(quint8 command, const QVariant &argument,
+            quint8 *status) const;
+
+private:
+    enum {
+        MaxRequestSize = 64 * 1024
+    };
+    QLocalServer *const m_server;
+    const QString m_serverName;
+    //           socket          expected body size, 0 while reading the header
+    QHash<QLocalSocket *, quint32> m_pendingSizes;
+};
+
+/*!
+    \brief Command line client of the ControlServer.
+ */
+class ControlClient
+{
+public:
+    static int run(const QString &serverName, const QStringList &arguments);
+};
+
+#endif // CONTROLSERVER_H
@@ -0,0 +1,1258 @@
+#include "dataserver.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <QtNetwork/QLocalSocket>
+
+#include <pluginloader/idatasource.h>
+#include <pluginloader/pluginmanager.h>
+
+#include <string.h>
+
+#if defined(Q_OS_UNIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#if defined(Q_OS_LINUX)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+using namespace PluginLoader;
+
+namespace {
+    const QDataStream::Version STREAM_VERSION = QDataStream::Qt_4_7;
+
+    enum {
+        MaxRequestSize = 64 * 1024,
+        MaxReplySize = 256 * 1024 * 1024,
+        //! A connection isn't read while more of its replies wait for
+        //! sending, a source producing more waits for the client
+        MaxPendingOutput = 4 * 1024 * 1024,
+        //! Time a client may take no data while a source waits for it
+        WriteTimeout = 5000,
+        MaxThreadCount = 4,
+        //! Fetches running at once, a fetch waiting for its client holds one
+        FetchThreadCount = 16,
+        ReadChunkSize = 64 * 1024,
+        MaxEvents = 64,
+        MaxWriteChunks = 16
+    };
+
+    QByteArray frameHeader(const QByteArray &header, quint32 bodySize)
+    {
+        QByteArray frame;
+        QDataStream out(&frame, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << bodySize;
+        frame.append(header);
+        return frame;
+    }
+
+    QByteArray buildFrame(quint8 kind, const QString &errorString = QString())
+    {
+        QByteArray body;
+        QDataStream out(&body, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << kind;
+        if (kind == DataServer::ErrorFrame)
+            out << errorString;
+        return frameHeader(body, body.size());
+    }
+
+    // The buffers of the batch are framed as they are, without copying
+    QList<QByteArray> batchFrames(const DataBatch &batch)
+    {
+        const DataSchema schema = batch.schema();
+        const QByteArray buffer = batch.buffer();
+        const QByteArray heap = batch.heap();
+
+        QByteArray header;
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << quint8(DataServer::BatchFrame) << quint8(batch.layout())
+            << qint32(batch.rowCount()) << quint32(schema.size());
+        foreach (const DataField &field, schema)
+            out << field.name << quint8(field.type);
+        out << quint32(buffer.size());
+
+        QByteArray heapHeader;
+        QDataStream heapOut(&heapHeader, QIODevice::WriteOnly);
+        heapOut.setVersion(STREAM_VERSION);
+        heapOut << quint32(heap.size());
+
+        QList<QByteArray> frames;
+        frames.append(frameHeader(header, header.size() + buffer.size()
+                    + heapHeader.size() + heap.size()));
+        if (!buffer.isEmpty())
+            frames.append(buffer);
+        frames.append(heapHeader);
+        if (!heap.isEmpty())
+            frames.append(heap);
+        return frames;
+    }
+
+    // Reads one frame of at most maxSize bytes from the blocking socket
+    bool readFrame(QLocalSocket *socket, QByteArray *frame, int maxSize,
+            int timeout, QString *errorString)
+    {
+        quint32 size = 0;
+        while (socket->bytesAvailable() < qint64(sizeof(quint32))) {
+            if (!socket->waitForReadyRead(timeout)) {
+                if (errorString != 0)
+                    *errorString = socket->errorString();
+                return false;
+            }
+        }
+        QDataStream in(socket);
+        in.setVersion(STREAM_VERSION);
+        in >> size;
+        if (size > quint32(maxSize)) {
+            if (errorString != 0)
+                *errorString = DataServer::tr("Reply too large");
+            return false;
+        }
+        while (socket->bytesAvailable() < qint64(size)) {
+            if (!socket->waitForReadyRead(timeout)) {
+                if (errorString != 0)
+                    *errorString = socket->errorString();
+                return false;
+            }
+        }
+        *frame = socket->read(size);
+        return true;
+    }
+}
+
+#if defined(Q_OS_UNIX)
+
+namespace {
+    bool setNonBlocking(int socket)
+    {
+        const int flags = ::fcntl(socket, F_GETFL);
+        return flags != -1
+            && ::fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1
+            && ::fcntl(socket, F_SETFD, FD_CLOEXEC) != -1;
+    }
+
+    struct PollEvent
+    {
+        int socket;
+        bool readable;
+        bool writable;
+        bool failed;
+    };
+
+    // Waits for events on many sockets, epoll where available
+    class SocketPoller
+    {
+    public:
+        SocketPoller();
+        ~SocketPoller();
+
+        bool isValid() const;
+        bool add(int socket, bool read, bool write);
+        bool modify(int socket, bool read, bool write);
+        void remove(int socket);
+        int wait(PollEvent *events, int maxEvents);
+
+    private:
+#if defined(Q_OS_LINUX)
+        int m_epoll;
+#else
+        int index(int socket) const;
+
+        QVector<pollfd> m_sockets;
+#endif
+    };
+
+#if defined(Q_OS_LINUX)
+    SocketPoller::SocketPoller()
+        : m_epoll(::epoll_create(MaxEvents))
+    {
+        if (m_epoll != -1)
+            ::fcntl(m_epoll, F_SETFD, FD_CLOEXEC);
+    }
+
+    SocketPoller::~SocketPoller()
+    {
+        if (m_epoll != -1)
+            ::close(m_epoll);
+    }
+
+    bool SocketPoller::isValid() const
+    {
+        return m_epoll != -1;
+    }
+
+    bool SocketPoller::add(int socket, bool read, bool write)
+    {
+        epoll_event event;
+        event.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+        event.data.fd = socket;
+        return ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, socket, &event) == 0;
+    }
+
+    bool SocketPoller::modify(int socket, bool read, bool write)
+    {
+        epoll_event event;
+        event.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+        event.data.fd = socket;
+        return ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, socket, &event) == 0;
+    }
+
+    void SocketPoller::remove(int socket)
+    {
+        epoll_event event;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, &event);
+    }
+
+    int SocketPoller::wait(PollEvent *events, int maxEvents)
+    {
+        epoll_event ready[MaxEvents];
+        const int count = ::epoll_wait(m_epoll, ready,
+                qMin(maxEvents, int(MaxEvents)), -1);
+        for (int i = 0; i < count; ++i) {
+            events[i].socket = ready[i].data.fd;
+            events[i].readable = ready[i].events & EPOLLIN;
+            events[i].writable = ready[i].events & EPOLLOUT;
+            events[i].failed = ready[i].events & (EPOLLERR | EPOLLHUP);
+        }
+        return count;
+    }
+#else
+    SocketPoller::SocketPoller()
+    {
+    }
+
+    SocketPoller::~SocketPoller()
+    {
+    }
+
+    bool SocketPoller::isValid() const
+    {
+        return true;
+    }
+
+    bool SocketPoller::add(int socket, bool read, bool write)
+    {
+        pollfd entry;
+        entry.fd = socket;
+        entry.events = (read ? POLLIN : 0) | (write ? POLLOUT : 0);
+        entry.revents = 0;
+        m_sockets.append(entry);
+        return true;
+    }
+
+    bool SocketPoller::modify(int socket, bool read, bool write)
+    {
+        const int i = index(socket);
+        if (i == -1)
+            return false;
+        m_sockets[i].events = (read ? POLLIN : 0) | (write ? POLLOUT : 0);
+        return true;
+    }
+
+    void SocketPoller::remove(int socket)
+    {
+        const int i = index(socket);
+        if (i != -1)
+            m_sockets.remove(i);
+    }
+
+    int SocketPoller::wait(PollEvent *events, int maxEvents)
+    {
+        if (::poll(m_sockets.data(), m_sockets.size(), -1) <= 0)
+            return -1;
+
+        int count = 0;
+        for (int i = 0; i < m_sockets.size() && count < maxEvents; ++i) {
+            const pollfd &entry = m_sockets.at(i);
+            if (entry.revents == 0)
+                continue;
+            events[count].socket = entry.fd;
+            events[count].readable = entry.revents & POLLIN;
+            events[count].writable = entry.revents & POLLOUT;
+            events[count].failed = entry.revents & (POLLERR | POLLHUP | POLLNVAL);
+            ++count;
+        }
+        return count;
+    }
+
+    int SocketPoller::index(int socket) const
+    {
+        for (int i = 0; i < m_sockets.size(); ++i) {
+            if (m_sockets.at(i).fd == socket)
+                return i;
+        }
+        return -1;
+    }
+#endif
+}
+
+/*! \cond */
+/*
+    Runs the connections assigned to it. The first reactor also accepts the
+    new connections and spreads them over all reactors. The requests are
+    fetched in the pool of the server, one at a time per connection, so a
+    source waiting for a slow client stalls no other connection.
+*/
+class DataReactor : public QThread
+{
+public:
+    DataReactor(DataServer *server, int listenSocket);
+    virtual ~DataReactor();
+
+    bool open();
+    void addConnection(int socket);
+    void stop();
+
+protected:
+    virtual void run();
+
+private:
+    // Output of the fetch of a request, produced by a FetchTask and sent by
+    // the reactor
+    struct Reply
+    {
+        Reply() : size(0), finished(false), canceled(false) {}
+
+        QMutex mutex;
+        //! Signaled when the reactor took output or canceled the reply
+        QWaitCondition taken;
+        QList<QByteArray> output;
+        //! Bytes in output
+        qint64 size;
+        bool finished;
+        bool canceled;
+    };
+
+    struct Connection
+    {
+        Connection(int socket) : socket(socket), inputOffset(0),
+            outputOffset(0), pendingOutput(0), reading(true),
+            writing(false), closed(false) {}
+
+        int socket;
+        QByteArray input;
+        //! Input already processed
+        int inputOffset;
+        QList<QByteArray> output;
+        //! Bytes of the first output chunk already sent
+        int outputOffset;
+        qint64 pendingOutput;
+        bool reading;
+        bool writing;
+        bool closed;
+        //! Fetch running for the connection, its requests wait meanwhile
+        QSharedPointer<Reply> reply;
+    };
+
+    // Runs IDataSource::fetch() in the pool of the server
+    class FetchTask : public QRunnable
+    {
+    public:
+        FetchTask(DataReactor *reactor, int socket, IDataSource *source,
+                const QByteArray &request, const QSharedPointer<Reply> &reply)
+            : m_reactor(reactor), m_socket(socket), m_source(source),
+            m_request(request), m_reply(reply) {}
+
+        virtual void run();
+        bool append(const QList<QByteArray> &frames, bool finished);
+
+    private:
+        DataReactor *const m_reactor;
+        const int m_socket;
+        IDataSource *const m_source;
+        const QByteArray m_request;
+        const QSharedPointer<Reply> m_reply;
+    };
+    friend class FetchTask;
+
+    class Sink : public IDataSink
+    {
+    public:
+        explicit Sink(FetchTask *task) : task(task) {}
+
+        virtual bool consume(const DataBatch &batch);
+
+    private:
+        FetchTask *const task;
+    };
+
+private:
+    void wake();
+    void notify(int socket);
+    void acceptConnections();
+    void adoptConnections();
+    void pullReplies();
+    void readConnection(Connection *connection);
+    void processRequests(Connection *connection);
+    void dispatch(Connection *connection, const QByteArray &body);
+    void queue(Connection *connection, const QByteArray &data);
+    bool pull(Connection *connection);
+    void write(Connection *connection);
+    void flush(Connection *connection);
+    void updateEvents(Connection *connection);
+    void closeConnection(Connection *connection);
+
+private:
+    DataServer *const m_server;
+    const int m_listenSocket;
+    SocketPoller m_poller;
+    int m_wakePipe[2];
+    QAtomicInt m_stopping;
+    QMutex m_mutex;
+    //! Sockets accepted for this reactor, guarded by m_mutex
+    QList<int> m_incoming;
+    //! Sockets with new output of their fetch, guarded by m_mutex
+    QList<int> m_ready;
+    QHash<int, Connection *> m_connections;
+};
+
+DataReactor::DataReactor(DataServer *server, int listenSocket)
+    : m_server(server),
+    m_listenSocket(listenSocket)
+{
+    m_wakePipe[0] = -1;
+    m_wakePipe[1] = -1;
+}
+
+DataReactor::~DataReactor()
+{
+    Q_ASSERT(!isRunning());
+    if (m_wakePipe[0] != -1) {
+        ::close(m_wakePipe[0]);
+        ::close(m_wakePipe[1]);
+    }
+}
+
+bool DataReactor::open()
+{
+    if (!m_poller.isValid() || ::pipe(m_wakePipe) != 0) {
+        qWarning("%s: %s", Q_FUNC_INFO, strerror(errno));
+        return false;
+    }
+    setNonBlocking(m_wakePipe[0]);
+    setNonBlocking(m_wakePipe[1]);
+
+    if (!m_poller.add(m_wakePipe[0], true, false))
+        return false;
+    if (m_listenSocket != -1 && !m_poller.add(m_listenSocket, true, false))
+        return false;
+    return true;
+}
+
+//! Hands \a socket over to the reactor, thread-safe.
+void DataReactor::addConnection(int socket)
+{
+    m_mutex.lock();
+    m_incoming.append(socket);
+    m_mutex.unlock();
+    wake();
+}
+
+//! Closes all connections and waits for the thread to finish.
+void DataReactor::stop()
+{
+    m_stopping = 1;
+    wake();
+    wait();
+}
+
+void DataReactor::run()
+{
+    PollEvent events[MaxEvents];
+
+    while (!m_stopping) {
+        const int count = m_poller.wait(events, MaxEvents);
+        if (count < 0 && errno != EINTR) {
+            qWarning("%s: %s", Q_FUNC_INFO, strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const PollEvent &event = events[i];
+            if (event.socket == m_wakePipe[0]) {
+                char buffer[64];
+                while (::read(m_wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+                adoptConnections();
+                pullReplies();
+                continue;
+            }
+            if (event.socket == m_listenSocket) {
+                acceptConnections();
+                continue;
+            }
+
+            Connection *const connection = m_connections.value(event.socket);
+            if (connection == 0)
+                continue;
+            if (event.failed)
+                connection->closed = true;
+            if (!connection->closed && event.writable)
+                flush(connection);
+            if (!connection->closed && event.readable)
+                readConnection(connection);
+            if (connection->closed)
+                closeConnection(connection);
+        }
+    }
+
+    foreach (Connection *connection, m_connections)
+        closeConnection(connection);
+    adoptConnections();
+}
+
+void DataReactor::wake()
+{
+    const char byte = 0;
+    // A full pipe wakes the reactor as well
+    while (::write(m_wakePipe[1], &byte, 1) == -1 && errno == EINTR) {}
+}
+
+// Tells the reactor about new output for \a socket, thread-safe
+void DataReactor::notify(int socket)
+{
+    m_mutex.lock();
+    m_ready.append(socket);
+    m_mutex.unlock();
+    wake();
+}
+
+void DataReactor::acceptConnections()
+{
+    forever {
+        const int socket = ::accept(m_listenSocket, 0, 0);
+        if (socket == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qWarning("%s: %s", Q_FUNC_INFO, strerror(errno));
+            return;
+        }
+        if (!setNonBlocking(socket)) {
+            ::close(socket);
+            continue;
+        }
+        m_server->nextReactor()->addConnection(socket);
+    }
+}
+
+void DataReactor::adoptConnections()
+{
+    m_mutex.lock();
+    const QList<int> incoming = m_incoming;
+    m_incoming.clear();
+    m_mutex.unlock();
+
+    foreach (int socket, incoming) {
+        if (m_stopping || !m_poller.add(socket, true, false)) {
+            ::close(socket);
+            continue;
+        }
+        m_connections.insert(socket, new Connection(socket));
+    }
+}
+
+void DataReactor::pullReplies()
+{
+    m_mutex.lock();
+    const QList<int> ready = m_ready;
+    m_ready.clear();
+    m_mutex.unlock();
+
+    foreach (int socket, ready) {
+        Connection *const connection = m_connections.value(socket);
+        if (connection == 0 || connection->reply.isNull())
+            continue;
+        flush(connection);
+        if (connection->closed)
+            closeConnection(connection);
+    }
+}
+
+void DataReactor::readConnection(Connection *connection)
+{
+    char buffer[ReadChunkSize];
+    while (connection->reading) {
+        const ssize_t size = ::read(connection->socket, buffer, sizeof(buffer));
+        if (size > 0) {
+            connection->input.append(buffer, size);
+            processRequests(connection);
+            continue;
+        }
+        if (size == -1 && errno == EINTR)
+            continue;
+        if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            connection->closed = true;
+        break;
+    }
+}
+
+// Answers the complete requests received so far, in order
+void DataReactor::processRequests(Connection *connection)
+{
+    while (!connection->closed && connection->reply.isNull()
+            && connection->pendingOutput < MaxPendingOutput) {
+        const int available = connection->input.size()
+            - connection->inputOffset;
+        if (available < int(sizeof(quint32)))
+            break;
+
+        const uchar *header = reinterpret_cast<const uchar *>(
+                connection->input.constData() + connection->inputOffset);
+        const quint32 size = (quint32(header[0]) << 24)
+            | (quint32(header[1]) << 16) | (quint32(header[2]) << 8)
+            | quint32(header[3]);
+        if (size == 0 || size > MaxRequestSize) {
+            qWarning("%s: Invalid request size %u, dropping client",
+                    Q_FUNC_INFO, size);
+            connection->closed = true;
+            return;
+        }
+        if (available - int(sizeof(quint32)) < int(size))
+            break;
+
+        dispatch(connection, QByteArray::fromRawData(
+                    connection->input.constData() + connection->inputOffset
+                    + sizeof(quint32), size));
+        connection->inputOffset += sizeof(quint32) + size;
+    }
+
+    if (connection->inputOffset > 0) {
+        connection->input.remove(0, connection->inputOffset);
+        connection->inputOffset = 0;
+    }
+    if (!connection->closed)
+        flush(connection);
+}
+
+void DataReactor::dispatch(Connection *connection, const QByteArray &body)
+{
+    QDataStream in(body);
+    in.setVersion(STREAM_VERSION);
+    QString sourceName;
+    QByteArray request;
+    in >> sourceName >> request;
+
+    if (in.status() != QDataStream::Ok) {
+        queue(connection, buildFrame(DataServer::ErrorFrame,
+                    DataServer::tr("Bad request")));
+        return;
+    }
+
+    IDataSource *const source = m_server->m_sources.value(sourceName);
+    if (source == 0) {
+        queue(connection, buildFrame(DataServer::ErrorFrame,
+                    DataServer::tr("Unknown data source '%1'")
+                    .arg(sourceName)));
+        return;
+    }
+
+    connection->reply = QSharedPointer<Reply>(new Reply);
+    m_server->m_fetchPool.start(new FetchTask(this, connection->socket,
+                source, request, connection->reply));
+}
+
+void DataReactor::FetchTask::run()
+{
+    Sink sink(this);
+    QString errorString;
+    const bool fetched = m_source->fetch(m_request, &sink, &errorString);
+    append(QList<QByteArray>() << (fetched
+                ? buildFrame(DataServer::EndFrame)
+                : buildFrame(DataServer::ErrorFrame, errorString)), true);
+}
+
+/*
+    Hands \a frames over to the reactor. Waits while MaxPendingOutput or
+    more are left to the reactor, cancels the reply if the client takes no
+    data for WriteTimeout.
+    \return false if the reply was canceled
+*/
+bool DataReactor::FetchTask::append(const QList<QByteArray> &frames,
+        bool finished)
+{
+    QMutexLocker locker(&m_reply->mutex);
+    if (m_reply->canceled)
+        return false;
+    foreach (const QByteArray &frame, frames) {
+        m_reply->output.append(frame);
+        m_reply->size += frame.size();
+    }
+    m_reply->finished = finished;
+    m_reactor->notify(m_socket);
+
+    while (!finished && !m_reply->canceled
+            && m_reply->size >= MaxPendingOutput) {
+        if (!m_reply->taken.wait(&m_reply->mutex, WriteTimeout)) {
+            qWarning("%s: Client takes no data, dropping it", Q_FUNC_INFO);
+            m_reply->canceled = true;
+            m_reactor->notify(m_socket);
+        }
+    }
+    return !m_reply->canceled;
+}
+
+bool DataReactor::Sink::consume(const DataBatch &batch)
+{
+    return task->append(batchFrames(batch), false);
+}
+
+void DataReactor::queue(Connection *connection, const QByteArray &data)
+{
+    connection->output.append(data);
+    connection->pendingOutput += data.size();
+}
+
+/*
+    Moves the output of the running fetch to the connection while less than
+    MaxPendingOutput is queued, the fetch is released once it finished.
+    \return true if any output was moved
+*/
+bool DataReactor::pull(Connection *connection)
+{
+    if (connection->reply.isNull())
+        return false;
+
+    Reply *const reply = connection->reply.data();
+    QMutexLocker locker(&reply->mutex);
+    // Only the task cancels a reply of an open connection
+    if (reply->canceled) {
+        connection->closed = true;
+        return false;
+    }
+
+    bool pulled = false;
+    while (!reply->output.isEmpty()
+            && connection->pendingOutput < MaxPendingOutput) {
+        const QByteArray frame = reply->output.takeFirst();
+        reply->size -= frame.size();
+        queue(connection, frame);
+        pulled = true;
+    }
+    if (pulled)
+        reply->taken.wakeAll();
+
+    const bool done = reply->finished && reply->output.isEmpty();
+    locker.unlock();
+    if (done)
+        connection->reply.clear();
+    return pulled;
+}
+
+// Sends as much of the queued output as the socket takes
+void DataReactor::write(Connection *connection)
+{
+    while (!connection->output.isEmpty()) {
+        iovec chunks[MaxWriteChunks];
+        int count = 0;
+        for (; count < connection->output.size() && count < MaxWriteChunks;
+                ++count) {
+            const QByteArray &chunk = connection->output.at(count);
+            const int offset = count == 0 ? connection->outputOffset : 0;
+            chunks[count].iov_base = const_cast<char *>(chunk.constData())
+                + offset;
+            chunks[count].iov_len = chunk.size() - offset;
+        }
+
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = chunks;
+        message.msg_iovlen = count;
+#if defined(MSG_NOSIGNAL)
+        ssize_t written = ::sendmsg(connection->socket, &message, MSG_NOSIGNAL);
+#else
+        ssize_t written = ::sendmsg(connection->socket, &message, 0);
+#endif
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                connection->closed = true;
+            break;
+        }
+
+        connection->pendingOutput -= written;
+        while (written > 0) {
+            const int left = connection->output.first().size()
+                - connection->outputOffset;
+            if (written < left) {
+                connection->outputOffset += written;
+                break;
+            }
+            written -= left;
+            connection->output.removeFirst();
+            connection->outputOffset = 0;
+        }
+    }
+}
+
+// Sends the queued output and adapts the events waited for to what's left
+void DataReactor::flush(Connection *connection)
+{
+    // The socket may take more than a connection queues at once
+    forever {
+        const bool pulled = pull(connection);
+        write(connection);
+        if (connection->closed)
+            return;
+        if (!pulled || !connection->output.isEmpty())
+            break;
+    }
+
+    const bool wasReading = connection->reading;
+    updateEvents(connection);
+    // Requests left unprocessed while the output was full
+    if (!wasReading && connection->reading)
+        processRequests(connection);
+}
+
+void DataReactor::updateEvents(Connection *connection)
+{
+    const bool reading = connection->reply.isNull()
+        && connection->pendingOutput < MaxPendingOutput;
+    const bool writing = !connection->output.isEmpty();
+    if (reading == connection->reading && writing == connection->writing)
+        return;
+
+    connection->reading = reading;
+    connection->writing = writing;
+    if (!m_poller.modify(connection->socket, reading, writing))
+        connection->closed = true;
+}
+
+void DataReactor::closeConnection(Connection *connection)
+{
+    if (!connection->reply.isNull()) {
+        QMutexLocker locker(&connection->reply->mutex);
+        connection->reply->canceled = true;
+        connection->reply->taken.wakeAll();
+    }
+    m_poller.remove(connection->socket);
+    ::close(connection->socket);
+    m_connections.remove(connection->socket);
+    delete connection;
+}
+/*! \endcond */
+
+#else // Q_OS_UNIX
+
+class DataReactor : public QThread
+{
+public:
+    void stop() {}
+};
+
+#endif // Q_OS_UNIX
+
+/*!
+    Constructs a data server listening on \a serverName once listen() is
+    called.
+ */
+DataServer::DataServer(const QString &serverName, QObject *parent)
+    : QObject(parent),
+    m_serverName(serverName),
+    m_listenSocket(-1),
+    m_nextReactor(0)
+{
+}
+
+DataServer::~DataServer()
+{
+    close();
+}
+
+/*!
+    Starts serving the data sources of the loaded plugins by \a threadCount
+    reactor threads, 0 chooses by the number of processor cores. Must be
+    called after the plugins were initialized.
+    \return true on success
+ */
+bool DataServer::listen(int threadCount)
+{
+    Q_ASSERT(!isListening());
+
+#if defined(Q_OS_UNIX)
+    m_sources.clear();
+    foreach (IDataSource *source, PluginManager::instance()->dataSources())
+        m_sources.insert(source->sourceName(), source);
+
+    // Same path as QLocalServer uses, so QLocalSocket clients find it
+    m_socketPath = QDir::isAbsolutePath(m_serverName) ? m_serverName
+        : QDir::cleanPath(QDir::tempPath()) + QLatin1Char('/') + m_serverName;
+    const QByteArray path = QFile::encodeName(m_socketPath);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= int(sizeof(address.sun_path))) {
+        qWarning("%s: Socket path '%s' too long", Q_FUNC_INFO,
+                path.constData());
+        return false;
+    }
+    memcpy(address.sun_path, path.constData(), path.size());
+
+    m_listenSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenSocket == -1) {
+        qWarning("%s: %s", Q_FUNC_INFO, strerror(errno));
+        return false;
+    }
+    // Socket file left behind by crashed instance, only the running instance
+    // calls this method so nobody else can listen on it
+    ::unlink(path.constData());
+    if (!setNonBlocking(m_listenSocket)
+            || ::bind(m_listenSocket, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0
+            || ::listen(m_listenSocket, SOMAXCONN) != 0) {
+        qWarning("%s: Listen on '%s' failed: %s", Q_FUNC_INFO,
+                path.constData(), strerror(errno));
+        close();
+        return false;
+    }
+
+    m_fetchPool.setMaxThreadCount(FetchThreadCount);
+    if (threadCount <= 0)
+        threadCount = qBound(1, QThread::idealThreadCount(), int(MaxThreadCount));
+    for (int i = 0; i < threadCount; ++i) {
+        DataReactor *reactor =
+            new DataReactor(this, i == 0 ? m_listenSocket : -1);
+        m_reactors.append(reactor);
+        if (!reactor->open()) {
+            close();
+            return false;
+        }
+    }
+    foreach (DataReactor *reactor, m_reactors)
+        reactor->start();
+    return true;
+#else
+    Q_UNUSED(threadCount);
+    qWarning("%s: Not supported on this platform", Q_FUNC_INFO);
+    return false;
+#endif
+}
+
+/*!
+    Stops the reactor threads and closes all connections. Has to be called
+    before the plugins are unloaded.
+ */
+void DataServer::close()
+{
+    foreach (DataReactor *reactor, m_reactors) {
+        if (reactor->isRunning())
+            reactor->stop();
+    }
+    // The canceled fetches still notify their reactors
+    m_fetchPool.waitForDone();
+    qDeleteAll(m_reactors);
+    m_reactors.clear();
+
+#if defined(Q_OS_UNIX)
+    if (m_listenSocket != -1) {
+        ::close(m_listenSocket);
+        ::unlink(QFile::encodeName(m_socketPath).constData());
+        m_listenSocket = -1;
+    }
+#endif
+    m_sources.clear();
+}
+
+bool DataServer::isListening() const
+{
+    return m_listenSocket != -1;
+}
+
+//! The name of the local socket the server listens on
+QString DataServer::serverName() const
+{
+    return m_serverName;
+}
+
+// Called by the accepting reactor only
+DataReactor *DataServer::nextReactor()
+{
+    m_nextReactor = (m_nextReactor + 1) % m_reactors.size();
+    return m_reactors.at(m_nextReactor);
+}
+
+/*!
+    Fetches the records answering \a request from the data source named
+    \a source of the server listening on \a serverName. Waits up to \a
+    timeout milliseconds for each step of the communication.
+    \param batches filled by the received batches
+    \param errorString if not null, filled by the reason of the failure
+    \return true if the request was answered completely
+ */
+bool DataServer::fetch(const QString &serverName, const QString &source,
+        const QByteArray &request, QList<DataBatch> *batches,
+        QString *errorString, int timeout)
+{
+    Q_ASSERT(batches != 0);
+
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(timeout)) {
+        if (errorString != 0)
+            *errorString = socket.errorString();
+        return false;
+    }
+
+    socket.write(buildRequest(source, request));
+    socket.flush();
+    forever {
+        QByteArray frame;
+        if (!readFrame(&socket, &frame, MaxReplySize, timeout, errorString))
+            return false;
+
+        FrameKind kind;
+        DataBatch batch;
+        if (!readReply(frame, &kind, &batch, errorString))
+            return false;
+        if (kind == EndFrame)
+            break;
+        batches->append(batch);
+    }
+    socket.disconnectFromServer();
+    return true;
+}
+
+//! \return the frame of the request for \a source
+QByteArray DataServer::buildRequest(const QString &source,
+        const QByteArray &request)
+{
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out.setVersion(STREAM_VERSION);
+    out << source << request;
+    return frameHeader(body, body.size());
+}
+
+/*!
+    Decodes the reply \a frame without its size prefix.
+    \param kind filled by the kind of the frame
+    \param batch filled by the received batch for a BatchFrame
+    \param errorString filled by the error message of an ErrorFrame or by
+    the reason of a malformed frame
+    \return false for an ErrorFrame or a malformed frame
+ */
+bool DataServer::readReply(const QByteArray &frame, FrameKind *kind,
+        DataBatch *batch, QString *errorString)
+{
+    QDataStream in(frame);
+    in.setVersion(STREAM_VERSION);
+
+    quint8 code;
+    in >> code;
+    *kind = FrameKind(code);
+
+    switch (*kind) {
+    case EndFrame:
+        return in.status() == QDataStream::Ok;
+
+    case ErrorFrame: {
+        QString message;
+        in >> message;
+        if (errorString != 0)
+            *errorString = message;
+        return false;
+    }
+
+    case BatchFrame: {
+        quint8 layout;
+        qint32 rowCount;
+        quint32 columnCount;
+        in >> layout >> rowCount >> columnCount;
+
+        DataSchema schema;
+        for (quint32 i = 0; i < columnCount && in.status() == QDataStream::Ok;
+                ++i) {
+            QString name;
+            quint8 type;
+            in >> name >> type;
+            if (type > DataField::Bytes)
+                break;
+            schema.append(DataField(name, DataField::Type(type)));
+        }
+
+        QByteArray buffer;
+        QByteArray heap;
+        in >> buffer >> heap;
+        if (in.status() == QDataStream::Ok
+                && schema.size() == int(columnCount)) {
+            *batch = DataBatch::fromBuffer(schema, rowCount,
+                    DataBatch::Layout(layout), buffer, heap);
+            if (!batch->isNull() || columnCount == 0)
+                return true;
+        }
+        break;
+    }
+    }
+
+    if (errorString != 0)
+        *errorString = tr("Malformed reply");
+    return false;
+}
+
+/*! \cond */
+namespace {
+    struct LoadResult
+    {
+        LoadResult() : requests(0), errors(0), batches(0), rows(0),
+            bytes(0) {}
+
+        int requests;
+        int errors;
+        qint64 batches;
+        qint64 rows;
+        qint64 bytes;
+        QString errorString;
+    };
+
+    // One client connection sending pipelined requests
+    class LoadWorker : public QThread
+    {
+    public:
+        LoadWorker(const QString &serverName, const QByteArray &request,
+                int requests, int depth)
+            : serverName(serverName), request(request), requests(requests),
+            depth(depth) {}
+
+        LoadResult result;
+
+    protected:
+        void run()
+        {
+            QLocalSocket socket;
+            socket.connectToServer(serverName);
+            if (!socket.waitForConnected(Timeout)) {
+                result.errorString = socket.errorString();
+                return;
+            }
+
+            int sent = 0;
+            while (sent < qMin(depth, requests)) {
+                socket.write(request);
+                ++sent;
+            }
+            socket.flush();
+
+            while (result.requests < requests) {
+                QByteArray frame;
+                if (!readFrame(&socket, &frame, MaxReplySize, Timeout,
+                            &result.errorString))
+                    return;
+                result.bytes += frame.size() + sizeof(quint32);
+
+                DataServer::FrameKind kind;
+                DataBatch batch;
+                QString errorString;
+                const bool ok = DataServer::readReply(frame, &kind, &batch,
+                        &errorString);
+                if (ok && kind == DataServer::BatchFrame) {
+                    ++result.batches;
+                    result.rows += batch.rowCount();
+                    continue;
+                }
+
+                if (!ok) {
+                    ++result.errors;
+                    result.errorString = errorString;
+                }
+                ++result.requests;
+                if (sent < requests) {
+                    socket.write(request);
+                    socket.flush();
+                    ++sent;
+                }
+            }
+            socket.disconnectFromServer();
+        }
+
+    private:
+        enum {
+            Timeout = 30000
+        };
+        const QString serverName;
+        const QByteArray request;
+        const int requests;
+        const int depth;
+    };
+}
+/*! \endcond */
+
+/*!
+    Loads the data server listening on \a serverName by concurrent clients
+    and prints the achieved throughput. The \a arguments are
+    \c {source [request] [connections] [requests] [depth]}, the number of
+    client connections (8 by default), requests per connection (1000) and
+    requests each connection keeps pipelined (16).
+    \return the process exit code
+ */
+int DataClient::runLoad(const QString &serverName, const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (arguments.isEmpty()) {
+        err << "Missing data source name\n";
+        return 1;
+    }
+
+    const QByteArray request = DataServer::buildRequest(arguments.at(0),
+            arguments.value(1).toUtf8());
+    const int connections = qMax(arguments.value(2, "8").toInt(), 1);
+    const int requests = qMax(arguments.value(3, "1000").toInt(), 1);
+    const int depth = qMax(arguments.value(4, "16").toInt(), 1);
+
+    QList<LoadWorker *> workers;
+    for (int i = 0; i < connections; ++i)
+        workers.append(new LoadWorker(serverName, request, requests, depth));
+
+    QElapsedTimer timer;
+    timer.start();
+    foreach (LoadWorker *worker, workers)
+        worker->start();
+
+    LoadResult total;
+    foreach (LoadWorker *worker, workers) {
+        worker->wait();
+        total.requests += worker->result.requests;
+        total.errors += worker->result.errors;
+        total.batches += worker->result.batches;
+        total.rows += worker->result.rows;
+        total.bytes += worker->result.bytes;
+        if (!worker->result.errorString.isEmpty())
+            total.errorString = worker->result.errorString;
+    }
+    const qint64 elapsed = qMax(timer.elapsed(), qint64(1));
+    qDeleteAll(workers);
+
+    out << connections << " connections, " << total.requests
+        << " requests in " << elapsed << " ms\n"
+        << total.requests * 1000 / elapsed << " requests/s, "
+        << total.rows * 1000 / elapsed << " rows/s, "
+        << total.bytes * 1000 / elapsed / 1024 << " KiB/s\n"
+        << total.batches << " batches, " << total.errors << " errors\n";
+    if (!total.errorString.isEmpty())
+        err << "Last error: " << total.errorString << '\n';
+
+    return total.requests == connections * requests && total.errors == 0
+        ? 0 : 2;
+}
@@ -0,0 +1,97 @@
+#ifndef DATASERVER_H
+#define DATASERVER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+
+#include <pluginloader/databatch.h>
+
+namespace PluginLoader {
+    class IDataSource;
+}
+
+class DataReactor;
+
+/*!
+    \brief Local endpoint serving the records of the IDataSource plugins.
+
+    Unlike the ControlServer, the data server is meant for many concurrent
+    clients. The connections are spread over a few reactor threads, each of
+    them waiting for socket events by epoll (poll on other Unix systems) and
+    sending the replies to its connections. The requests are fetched in a
+    thread pool; a source producing faster than its client reads waits for
+    the client, while the reactor goes on serving the other connections.
+    The GUI thread is not involved after listen().
+
+    Every request and reply is a frame prefixed by its size (quint32). A
+    request names the source and carries its request (QString and QByteArray
+    serialized with QDataStream). Requests may be pipelined, the replies come
+    in the order of the requests. A reply is any number of batch frames
+    followed by an end frame or an error frame.
+
+    Clients connect by QLocalSocket::connectToServer() with serverName().
+    Not available on Windows.
+ */
+class DataServer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(DataServer)
+
+public:
+    enum FrameKind {
+        //! Schema and buffers of one DataBatch
+        BatchFrame = 0,
+        //! The request was answered completely
+        EndFrame = 1,
+        //! The request failed, followed by the error message (QString)
+        ErrorFrame = 2
+    };
+
+    explicit DataServer(const QString &serverName, QObject *parent = 0);
+    virtual ~DataServer();
+
+    bool listen(int threadCount = 0);
+    void close();
+    bool isListening() const;
+    QString serverName() const;
+
+    static bool fetch(const QString &serverName, const QString &source,
+            const QByteArray &request, QList<PluginLoader::DataBatch> *batches,
+            QString *errorString = 0, int timeout = 5000);
+
+    static QByteArray buildRequest(const QString &source,
+            const QByteArray &request);
+    static bool readReply(const QByteArray &frame, FrameKind *kind,
+            PluginLoader::DataBatch *batch, QString *errorString);
+
+private:
+    friend class DataReactor;
+
+    DataReactor *nextReactor();
+
+private:
+    const QString m_serverName;
+    QString m_socketPath;
+    int m_listenSocket;
+    QList<DataReactor *> m_reactors;
+    int m_nextReactor;
+    //! Read only while the reactors run
+    QHash<QString, PluginLoader::IDataSource *> m_sources;
+    //! Runs IDataSource::fetch() for the reactors
+    QThreadPool m_fetchPool;
+};
+
+/*!
+    \brief Load generator for the DataServer.
+ */
+class DataClient
+{
+public:
+    static int runLoad(const QString &serverName, const QStringList &arguments);
+};
+
+#endif // DATASERVER_H
@@ -1,5 +1,9 @@
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFuture>
 #include <QtCore/QSettings>
+#include <QtCore/QtConcurrentRun>
 #include <QtGui/QApplication>
 #include <QtGui/QDesktopServices>
 #include <QtGui/QIcon>
@@ -9,6 +13,8 @@
 #include <QtGui/QPixmap>
 #include <QtGui/QMessageBox>
 
+#include <utils/future.h>
+#include <utils/iconthemeindex.h>
 #include <utils/stylesheetloader.h>
 #include <utils/splashscreen.h>
 
@@ -16,8 +22,14 @@
 #include <pluginloader/pluginmanager.h>
 #include <pluginloader/pluginspec.h>
 
+#include "controlserver.h"
+#include "dataserver.h"
 #include "qtsingleapplication/qtsingleapplication.h"
 
+#if defined(APP_BENCHMARKS)
+#include "benchmark.h"
+#endif
+
 bool checkRunningApplication()
 {
     QtSingleApplication *const app =
@@ -45,6 +57,32 @@ QString readArgumentValue(const QStringList &arguments, const QString &argument)
     }
     return "";
 }
+
+//! Prints the time of every startup stage if enabled by '-tracestartup'
+class StartupTrace
+{
+public:
+    explicit StartupTrace(bool enabled)
+        : m_enabled(enabled),
+        m_last(0)
+    {
+        m_timer.start();
+    }
+
+    void stage(const char *name)
+    {
+        if (!m_enabled)
+            return;
+        const qint64 now = m_timer.elapsed();
+        qDebug("startup: %-24s %6lld ms (+%lld ms)", name, now, now - m_last);
+        m_last = now;
+    }
+
+private:
+    const bool m_enabled;
+    QElapsedTimer m_timer;
+    qint64 m_last;
+};
 /*! \endcond */
 
 int main(int argc, char *argv[])
@@ -53,6 +91,7 @@ int main(int argc, char *argv[])
     for (int n = 0; n < argc; ++n) {
         arguments << argv[n];
     }
+    StartupTrace trace(arguments.contains("-tracestartup"));
     const QString dataLocation =
         QDesktopServices::storageLocation(QDesktopServices::DataLocation);
 
@@ -67,7 +106,46 @@ int main(int argc, char *argv[])
 
     QScopedPointer<QtSingleApplication> app(
             new QtSingleApplication(appId, argc, argv));
-    if (brand->singleInstance() != Brand::MultipleInstances)
+
+    // Control commands are sent to the running instance, e.g. "-control plugins"
+    const QString controlServerName =
+        app->serverName() + QLatin1String("-control");
+    const int controlIndex = arguments.indexOf("-control", 1);
+    if (controlIndex > -1)
+        return ControlClient::run(controlServerName,
+                arguments.mid(controlIndex + 1));
+
+    // Load test of the data server, e.g. "-dataload <source> <request>"
+    const QString dataServerName = app->serverName() + QLatin1String("-data");
+    const int dataLoadIndex = arguments.indexOf("-dataload", 1);
+    if (dataLoadIndex > -1)
+        return DataClient::runLoad(dataServerName,
+                arguments.mid(dataLoadIndex + 1));
+
+#if defined(APP_BENCHMARKS)
+    // Message throughput to the running instance, e.g. "-peerbench 10000"
+    const int peerBenchIndex = arguments.indexOf("-peerbench", 1);
+    if (peerBenchIndex > -1)
+        return Benchmark::runPeer(app.data(), arguments.mid(peerBenchIndex + 1));
+
+    // Paints and layouts of a ribbon, e.g. "-ribbonbench 64 100"
+    const int ribbonBenchIndex = arguments.indexOf("-ribbonbench", 1);
+    if (ribbonBenchIndex > -1)
+        return Benchmark::runRibbon(arguments.mid(ribbonBenchIndex + 1));
+
+    // Task scheduler against QThreadPool, e.g. "-schedbench 100000 64"
+    const int schedBenchIndex = arguments.indexOf("-schedbench", 1);
+    if (schedBenchIndex > -1)
+        return Benchmark::runScheduler(arguments.mid(schedBenchIndex + 1));
+
+    // Request handling with and without an arena, e.g. "-arenabench 100000 32"
+    const int arenaBenchIndex = arguments.indexOf("-arenabench", 1);
+    if (arenaBenchIndex > -1)
+        return Benchmark::runArena(arguments.mid(arenaBenchIndex + 1));
+#endif
+
+    QScopedPointer<ControlServer> controlServer;
+    if (brand->singleInstance() != Brand::MultipleInstances) {
         if (checkRunningApplication()) {
             QString appName = brand->applicationName();
             QMessageBox::information(0, "Oh Noes!",
@@ -80,6 +158,59 @@ int main(int argc, char *argv[])
             return -1;
         }
 
+        // Only the running instance owns the control socket
+        controlServer.reset(new ControlServer(controlServerName));
+        controlServer->listen();
+    }
+    trace.stage("single instance");
+
+    /*! To access data stored by application you should use default QSettings
+        contructor as it's shown in following example:
+        \code
+        QSettings settings;
+        QString text = settings.value("Text", "default text").toString();
+        \endcode
+     */
+    QCoreApplication::setApplicationName(brand->applicationName());
+    QCoreApplication::setOrganizationName(brand->applicationVendor());
+    QCoreApplication::setApplicationVersion(brand->applicationVersion());
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+
+    // Start the file system heavy stages now, they are joined once their
+    // results are needed
+
+    const QString themePath = QCoreApplication::applicationDirPath()
+        + "/../" + QString(UITOOLS_REL_THEMES_DIR);
+    QStringList themeSearchPaths = QIcon::themeSearchPaths();
+    themeSearchPaths.removeAll(themePath);
+    themeSearchPaths.removeAll(brand->themeSearchPath());
+    themeSearchPaths.insert(0, themePath);
+    themeSearchPaths.insert(1, brand->themeSearchPath());
+
+    // Try to get the theme name from command line argument first
+    QString themeName = readArgumentValue(arguments, "-theme");
+    // Default theme name is product branding
+    if (themeName.isEmpty())
+        themeName = brand->themeName();
+    // Reads the index of the theme instead of walking its directories
+    const QString iconIndexFile = QDesktopServices::storageLocation(
+            QDesktopServices::CacheLocation) + "/iconthemes/" + themeName
+        + ".index";
+    QFuture<Utils::IconThemeIndex> iconIndex = QtConcurrent::run(
+            &Utils::IconThemeIndex::load, iconIndexFile, themeSearchPaths,
+            themeName);
+
+    const QString styleSheetsPath = qApp->applicationDirPath()
+        + "/../" + QString(UITOOLS_REL_STYLESHEETS_DIR);
+    QFuture<QMap<QString, QString> > styleSheets = QtConcurrent::run(
+            &Utils::StyleSheetLoader::findStyleSheets,
+            QStringList(styleSheetsPath));
+
+    PluginLoader::PluginManager *pm = PluginLoader::PluginManager::instance();
+    const QStringList pluginPaths = PluginLoader::PluginManager::getPluginPaths();
+    pm->prefetchPluginSpecs(pluginPaths);
+    trace.stage("background stages started");
+
     // Set default style to unify application look & feel on all platforms
     // NOTE: This is useful only for widgets that are not handled in style sheet
     // In ideal case everything is declared in CSS and following line is surplus
@@ -113,18 +244,7 @@ int main(int argc, char *argv[])
 
     splash->setStatus("Theme");
     splash->show();
-
-    /*! To access data stored by application you should use default QSettings
-        contructor as it's shown in following example:
-        \code
-        QSettings settings;
-        QString text = settings.value("Text", "default text").toString();
-        \endcode
-     */
-    QCoreApplication::setApplicationName(brand->applicationName());
-    QCoreApplication::setOrganizationName(brand->applicationVendor());
-    QCoreApplication::setApplicationVersion(brand->applicationVersion());
-    QSettings::setDefaultFormat(QSettings::IniFormat);
+    trace.stage("splash");
 
     // Create data location if not exists yet
     const QDir dataLocationDir(dataLocation);
@@ -144,23 +264,11 @@ int main(int argc, char *argv[])
 #endif
 
     // Set theme search path
-    const QString themePath = QCoreApplication::applicationDirPath()
-        + "/../" + QString(UITOOLS_REL_THEMES_DIR);
-    QStringList searchPaths = QIcon::themeSearchPaths();
-    searchPaths.removeAll(themePath);
-    searchPaths.removeAll(brand->themeSearchPath());
-    searchPaths.insert(0, themePath);
-    searchPaths.insert(1, brand->themeSearchPath());
-    QIcon::setThemeSearchPaths(searchPaths);
-
-    // Try to get the theme name from command line argument first
-    QString themeName = readArgumentValue(arguments, "-theme");
-    // Default theme name is product branding
-    if (themeName.isEmpty())
-        themeName = brand->themeName();
+    QIcon::setThemeSearchPaths(themeSearchPaths);
 
     QIcon::setThemeName(themeName);
-    if (!QIcon::hasThemeIcon(QLatin1String("icon_placeholder"))) {
+    const Utils::IconThemeIndex themeIndex = iconIndex.result();
+    if (!themeIndex.contains(QLatin1String("icon_placeholder"))) {
         qWarning("%s: Theme '%s' not found. You have to install a freedesktop "
                 "compatible icon set named '%s' into '%s' or any folder "
                 "returned by QIcon::themeSearchPaths().",
@@ -173,11 +281,14 @@ int main(int argc, char *argv[])
                 qPrintable(themeName));
     }
 
-    qApp->setWindowIcon(QIcon::fromTheme(brand->applicationIconName()));
+    const QString applicationIconName = brand->applicationIconName();
+    qApp->setWindowIcon(themeIndex.contains(applicationIconName)
+            ? themeIndex.icon(applicationIconName)
+            : QIcon::fromTheme(applicationIconName));
+    trace.stage("theme");
 
-    PluginLoader::PluginManager *pm = PluginLoader::PluginManager::instance();
-    QStringList pluginPaths = PluginLoader::PluginManager::getPluginPaths();
     pm->loadPlugins(pluginPaths);
+    trace.stage("plugins loaded");
 
     bool coreFound = false;
     foreach (PluginLoader::PluginSpec *pluginSpec, pm->pluginSpecs()) {
@@ -196,18 +307,23 @@ int main(int argc, char *argv[])
     Utils::StyleSheetLoader *const loader =
         Utils::StyleSheetLoader::instance();
     loader->setDefaultName(brand->styleSheetName());
-    const QString styleSheetsPath = qApp->applicationDirPath()
-        + "/../" + QString(UITOOLS_REL_STYLESHEETS_DIR);
-    loader->setPaths(QStringList(styleSheetsPath));
+    loader->setPaths(QStringList(styleSheetsPath), styleSheets.result());
 
     // Style sheet could be specified by command line option '-stylesheet'
     if (!loader->isStyleSheetSet()) {
         // Load last active style sheet (saved in settings) or default if set
-        loader->reload();
+        loader->activate();
     }
+    trace.stage("style sheet");
 
     splash->setStatus("Plugins");
-    if (!pm->initializePlugins(splash)) {
+    // Plugins implementing IAsyncPlugin initialize while the event loop
+    // runs, the rest of the initialization continues in this thread
+    const Utils::Future<bool> pluginsInitialized =
+        pm->initializePluginsAsync(splash);
+    while (!pluginsInitialized.isFinished())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    if (!pluginsInitialized.result()) {
         QString pluginWhichRequestedShutdown;
         if (pm->isShutdownRequested(&pluginWhichRequestedShutdown)) {
             qCritical("Plugin '%s' requested shutdown of application",
@@ -218,6 +334,16 @@ int main(int argc, char *argv[])
         }
     }
 
+    trace.stage("plugins initialized");
+
+    // Data sources of the plugins are served to local clients
+    QScopedPointer<DataServer> dataServer;
+    if (brand->singleInstance() != Brand::MultipleInstances
+            && !pm->dataSources().isEmpty()) {
+        dataServer.reset(new DataServer(dataServerName));
+        dataServer->listen();
+    }
+
     splash->setStatus("Ready");
     if (brand->singleInstance() != Brand::MultipleInstances) {
         //! \todo Replace hardcoded string with proper constant
@@ -237,9 +363,12 @@ int main(int argc, char *argv[])
 
     splash->close();
     delete splash;
+    trace.stage("ready");
 
     const int result = app->exec();
 
+    // Requests must not reach the plugins while they are unloaded
+    dataServer.reset();
     pm->unloadPlugins();
 
     return result;
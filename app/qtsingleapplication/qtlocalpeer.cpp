@@ -39,12 +39,16 @@
 
 
 #include "qtlocalpeer.h"
+#include "qtsharedring.h"
 #include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
 #include <QtCore/QTime>
+#include <QtCore/QTimer>
 
 #if defined(Q_OS_WIN)
 #include <QtCore/QLibrary>
 #include <QtCore/qt_windows.h>
+#include <io.h>
 typedef BOOL(WINAPI*PProcessIdToSessionId)(DWORD,DWORD*);
 static PProcessIdToSessionId pProcessIdToSessionId = 0;
 #endif
@@ -62,9 +66,26 @@ namespace QtLP_Private {
 }
 
 const char* QtLocalPeer::ack = "ack";
+// Maximum time to receive a whole message, however it is split up
+const int QtLocalPeer::receptionTimeout = 2000;
+// Larger messages are rejected before anything is buffered
+const quint32 QtLocalPeer::maxMessageSize = 16 * 1024 * 1024;
+// Sent instead of a message size to open a persistent channel; frames on the
+// channel start with a header made of payload size, frame type and request id
+const quint32 QtLocalPeer::channelMagic = 0xFFFFFF01;
+const int QtLocalPeer::frameHeaderSize = sizeof(quint32) + sizeof(quint8) + sizeof(quint32);
+// Size of the shared memory ring used for bulk data by sendData()
+const int QtLocalPeer::ringCapacity = 16 * 1024 * 1024;
+
+// Request ids wrap around, so they are compared by their distance
+static inline bool precedes(quint32 requestId, quint32 otherId)
+{
+    return qint32(requestId - otherId) < 0;
+}
 
 QtLocalPeer::QtLocalPeer(QObject* parent, const QString &appId)
-    : QObject(parent), id(appId)
+    : QObject(parent), id(appId), persistentConnection(false), channel(0),
+      lastRequestId(0), lastAcknowledgedId(0), ring(0)
 {
     QString prefix = id;
     if (id.isEmpty()) {
@@ -114,6 +135,7 @@ bool QtLocalPeer::isClient()
     if (!lockFile.lock(QtLP_Private::QtLockedFile::WriteLock, false))
         return true;
 
+    writePeerState(PeerStarting);
     bool res = server->listen(socketName);
 #if defined(Q_OS_UNIX) && (QT_VERSION >= QT_VERSION_CHECK(4,5,0))
     // ### Workaround
@@ -125,32 +147,125 @@ bool QtLocalPeer::isClient()
     if (!res)
         qWarning("QtSingleCoreApplication: listen on local socket failed, %s", qPrintable(server->errorString()));
     QObject::connect(server, SIGNAL(newConnection()), SLOT(receiveConnection()));
+    // Clients stop waiting for an instance that will never listen
+    writePeerState(res ? PeerReady : PeerFailed);
+
+    // Bulk data from other instances goes through shared memory if possible
+    ring = new QtSharedRing(socketName + QLatin1String("-ring"), this);
+    if (ring->create(ringCapacity)) {
+        QObject::connect(ring, SIGNAL(dataReceived(QByteArray)),
+                         SIGNAL(dataReceived(QByteArray)));
+    } else {
+        delete ring;
+        ring = 0;
+    }
     return false;
 }
 
 
-bool QtLocalPeer::sendMessage(const QString &message, int timeout)
+/*
+    Returns the state of the running instance as published in the lock
+    file, and its process id in \a pid if not null. Instances of older
+    versions do not publish anything, PeerUnknown is returned then. Only
+    meaningful once isClient() returned true.
+*/
+QtLocalPeer::PeerState QtLocalPeer::peerState(qint64 *pid)
 {
-    if (!isClient())
+    if (pid)
+        *pid = 0;
+    if (!lockFile.isOpen() || lockFile.isLocked())
+        return PeerUnknown;
+
+    lockFile.seek(0);
+    const QList<QByteArray> fields = lockFile.readLine(64).simplified().split(' ');
+    if (fields.count() != 2)
+        return PeerUnknown;
+
+    if (pid)
+        *pid = fields.at(0).toLongLong();
+    if (fields.at(1) == "ready")
+        return PeerReady;
+    if (fields.at(1) == "starting")
+        return PeerStarting;
+    if (fields.at(1) == "failed")
+        return PeerFailed;
+    return PeerUnknown;
+}
+
+
+void QtLocalPeer::writePeerState(PeerState state)
+{
+    // All states have the same length so that leaving the starting state
+    // overwrites the content in place, readers never see a truncated file
+    const char *const name = state == PeerReady ? " ready   \n"
+        : state == PeerFailed ? " failed  \n" : " starting\n";
+    const QByteArray content =
+        QByteArray::number(QCoreApplication::applicationPid()) + name;
+    if (state == PeerStarting)
+        lockFile.resize(0);
+    lockFile.seek(0);
+    lockFile.write(content);
+    lockFile.flush();
+}
+
+
+bool QtLocalPeer::connectToPeer(QLocalSocket* socket, int timeout)
+{
+    QTime timer;
+    timer.start();
+
+    // The lock file tells whether the running instance is listening already,
+    // wait only while it is starting up
+    PeerState state = peerState();
+    while (state == PeerStarting && timer.elapsed() < timeout) {
+        sleepMs(10);
+        state = peerState();
+    }
+
+    if (state == PeerReady) {
+        socket->connectToServer(socketName);
+        return socket->waitForConnected(qMax(timeout - timer.elapsed(), 1));
+    }
+    if (state == PeerStarting || state == PeerFailed)
         return false;
 
-    QLocalSocket socket;
+    // Nothing published (older instance), guess as before
     bool connOk = false;
     for(int i = 0; i < 2; i++) {
         // Try twice, in case the other instance is just starting up
-        socket.connectToServer(socketName);
-        connOk = socket.waitForConnected(timeout/2);
+        socket->connectToServer(socketName);
+        connOk = socket->waitForConnected(timeout/2);
         if (connOk || i)
             break;
-        int ms = 250;
+        sleepMs(250);
+    }
+    return connOk;
+}
+
+
+void QtLocalPeer::sleepMs(int ms)
+{
 #if defined(Q_OS_WIN)
-        Sleep(DWORD(ms));
+    Sleep(DWORD(ms));
 #else
-        struct timespec ts = { ms / 1000, (ms % 1000) * 1000 * 1000 };
-        nanosleep(&ts, NULL);
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000 * 1000 };
+    nanosleep(&ts, NULL);
 #endif
+}
+
+
+bool QtLocalPeer::sendMessage(const QString &message, int timeout)
+{
+    if (persistentConnection) {
+        const quint32 requestId = postMessage(message, timeout);
+        return requestId != 0 && waitForAcknowledgement(requestId, timeout);
     }
-    if (!connOk)
+
+    if (!isClient())
+        return false;
+
+    QLocalSocket socket;
+    if (!connectToPeer(&socket, timeout))
         return false;
 
     QByteArray uMsg(message.toUtf8());
@@ -166,34 +281,331 @@ bool QtLocalPeer::sendMessage(const QString &message, int timeout)
 }
 
 
+/*
+    Queues \a message on the persistent channel to the running instance
+    without waiting for it to be processed, so many messages can be in
+    flight at once. The channel is opened on first use, \a timeout limits
+    the time spent connecting. Returns the request id of the message, or 0
+    on failure. Use waitForAcknowledgement() or flush() when not running an
+    event loop, as the data is written only while the event loop runs or
+    while waiting.
+*/
+quint32 QtLocalPeer::postMessage(const QString &message, int timeout)
+{
+    return postFrame(MessageFrame, message.toUtf8(), timeout);
+}
+
+
+/*
+    Sends binary \a data to the running instance, which emits
+    dataReceived(). The data is copied into a shared memory ring if the
+    running instance provides one and the data fits into it, otherwise it
+    is sent over the persistent channel. Data sent this way is not ordered
+    with respect to messages. Returns true once the data is handed over to
+    the running instance.
+*/
+bool QtLocalPeer::sendData(const QByteArray &data, int timeout)
+{
+    if (!isClient())
+        return false;
+
+    if (!ring)
+        ring = new QtSharedRing(socketName + QLatin1String("-ring"), this);
+    if (ring->attach() && ring->write(data, timeout))
+        return true;
+
+    const quint32 requestId = postFrame(DataFrame, data, timeout);
+    return requestId != 0 && waitForAcknowledgement(requestId, timeout);
+}
+
+
+quint32 QtLocalPeer::postFrame(quint8 type, const QByteArray &payload, int timeout)
+{
+    if (!channel && (!isClient() || !openChannel(timeout)))
+        return 0;
+
+    if (++lastRequestId == 0)
+        ++lastRequestId;
+
+    QByteArray header;
+    QDataStream ds(&header, QIODevice::WriteOnly);
+    ds << quint32(payload.size()) << type << lastRequestId;
+
+    channel->write(header);
+    channel->write(payload);
+    channel->flush();
+    return lastRequestId;
+}
+
+
+/*
+    Waits until the running instance acknowledges the message \a requestId
+    returned by postMessage(). The running instance acknowledges messages
+    in batches, one acknowledgement covers every preceding message.
+*/
+bool QtLocalPeer::waitForAcknowledgement(quint32 requestId, int timeout)
+{
+    QTime timer;
+    timer.start();
+    while (channel && precedes(lastAcknowledgedId, requestId)) {
+        const int remaining = timeout - timer.elapsed();
+        if (remaining <= 0)
+            return false;
+        if (channel->bytesToWrite() > 0)
+            channel->waitForBytesWritten(remaining);
+        else if (!channel->waitForReadyRead(remaining))
+            return false;
+    }
+    return !precedes(lastAcknowledgedId, requestId);
+}
+
+
+/*
+    Waits until every message posted so far is acknowledged.
+*/
+bool QtLocalPeer::flush(int timeout)
+{
+    return waitForAcknowledgement(lastRequestId, timeout);
+}
+
+
+bool QtLocalPeer::openChannel(int timeout)
+{
+    QLocalSocket* socket = new QLocalSocket(this);
+    if (!connectToPeer(socket, timeout)) {
+        delete socket;
+        return false;
+    }
+
+    QDataStream ds(socket);
+    ds << channelMagic;
+
+    channel = socket;
+    lastAcknowledgedId = lastRequestId;
+    connect(channel, SIGNAL(readyRead()), SLOT(readAcknowledgements()));
+    connect(channel, SIGNAL(disconnected()), SLOT(channelClosed()));
+    return true;
+}
+
+
+void QtLocalPeer::readAcknowledgements()
+{
+    if (!channel || channel->bytesAvailable() < (int)sizeof(quint32))
+        return;
+
+    QDataStream ds(channel);
+    quint32 requestId = lastAcknowledgedId;
+    while (channel->bytesAvailable() >= (int)sizeof(quint32))
+        ds >> requestId;
+
+    lastAcknowledgedId = requestId;
+    emit messageAcknowledged(requestId);
+}
+
+
+void QtLocalPeer::channelClosed()
+{
+    if (!channel)
+        return;
+
+    // Unacknowledged messages are lost, next post opens a new channel
+    if (lastAcknowledgedId != lastRequestId)
+        qWarning("QtLocalPeer: Channel closed with unacknowledged messages");
+    channel->deleteLater();
+    channel = 0;
+}
+
+
 void QtLocalPeer::receiveConnection()
 {
-    QLocalSocket* socket = server->nextPendingConnection();
-    if (!socket)
+    // Messages are received asynchronously so that slow or stalled senders
+    // never block the event loop, each connection keeps its own state
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        Connection connection;
+        connection.timer = new QTimer(socket);
+        connection.timer->setSingleShot(true);
+        connection.timer->setInterval(receptionTimeout);
+        connections.insert(socket, connection);
+
+        connect(connection.timer, SIGNAL(timeout()), SLOT(receptionTimedOut()));
+        connect(socket, SIGNAL(readyRead()), SLOT(readMessage()));
+        connect(socket, SIGNAL(disconnected()), SLOT(connectionClosed()));
+
+        connection.timer->start();
+        if (socket->bytesAvailable() > 0)
+            readMessage(socket);
+    }
+}
+
+
+void QtLocalPeer::readMessage()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (socket)
+        readMessage(socket);
+}
+
+
+void QtLocalPeer::readMessage(QLocalSocket* socket)
+{
+    QHash<QLocalSocket*, Connection>::iterator it = connections.find(socket);
+    if (it == connections.end())
         return;
+    Connection &connection = it.value();
 
-    while (socket->bytesAvailable() < (int)sizeof(quint32))
-        socket->waitForReadyRead();
-    QDataStream ds(socket);
-    QByteArray uMsg;
-    quint32 remaining;
-    ds >> remaining;
-    uMsg.resize(remaining);
-    int got = 0;
-    char* uMsgBuf = uMsg.data();
-    do {
-        got = ds.readRawData(uMsgBuf, remaining);
-        remaining -= got;
-        uMsgBuf += got;
-    } while (remaining && got >= 0 && socket->waitForReadyRead(2000));
-    if (got < 0) {
-        qWarning("QtLocalPeer: Message reception failed %s", socket->errorString().toLatin1().constData());
-        delete socket;
+    if (connection.channel) {
+        readFrames(socket);
         return;
     }
-    QString message(QString::fromUtf8(uMsg));
+
+    if (!connection.headerRead) {
+        if (socket->bytesAvailable() < (int)sizeof(quint32))
+            return;
+        QDataStream ds(socket);
+        ds >> connection.remaining;
+        if (connection.remaining == channelMagic) {
+            // Persistent channel, idle channels do not time out
+            connection.channel = true;
+            connection.remaining = 0;
+            connection.timer->stop();
+            readFrames(socket);
+            return;
+        }
+        if (connection.remaining > maxMessageSize) {
+            qWarning("QtLocalPeer: Message of %u bytes exceeds the maximum size", connection.remaining);
+            connections.erase(it);
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+        connection.headerRead = true;
+        // Do not trust the announced size, grow the buffer as data arrives
+        connection.message.reserve(qMin(connection.remaining, quint32(64 * 1024)));
+    }
+
+    if (connection.remaining > 0) {
+        const QByteArray chunk = socket->read(connection.remaining);
+        connection.message.append(chunk);
+        connection.remaining -= chunk.size();
+    }
+
+    // Still incomplete, the timer started with the connection limits the
+    // time for the whole message
+    if (connection.remaining > 0)
+        return;
+
+    connection.timer->stop();
+    const QString message(QString::fromUtf8(connection.message));
+    connections.erase(it);
+
+    // The socket is closed once the acknowledgement is written and deleted
+    // when disconnected
     socket->write(ack, qstrlen(ack));
-    socket->waitForBytesWritten(1000);
-    delete socket;
+    socket->disconnectFromServer();
     emit messageReceived(message); //### (might take a long time to return)
 }
+
+
+void QtLocalPeer::readFrames(QLocalSocket* socket)
+{
+    QStringList messages;
+    QList<QByteArray> data;
+    quint32 lastId = 0;
+
+    {
+        QHash<QLocalSocket*, Connection>::iterator it = connections.find(socket);
+        if (it == connections.end())
+            return;
+        Connection &connection = it.value();
+
+        forever {
+            if (!connection.headerRead) {
+                if (socket->bytesAvailable() < frameHeaderSize)
+                    break;
+                QDataStream ds(socket);
+                ds >> connection.remaining >> connection.frameType >> connection.frameId;
+                if (connection.frameType != MessageFrame && connection.frameType != DataFrame) {
+                    qWarning("QtLocalPeer: Unknown frame type %d", int(connection.frameType));
+                    connections.erase(it);
+                    socket->abort();
+                    socket->deleteLater();
+                    return;
+                }
+                if (connection.remaining > maxMessageSize) {
+                    qWarning("QtLocalPeer: Frame of %u bytes exceeds the maximum size", connection.remaining);
+                    connections.erase(it);
+                    socket->abort();
+                    socket->deleteLater();
+                    return;
+                }
+                connection.headerRead = true;
+                connection.message.clear();
+                connection.message.reserve(qMin(connection.remaining, quint32(64 * 1024)));
+                // Limits the time for the whole frame
+                if (connection.remaining > 0)
+                    connection.timer->start();
+            }
+
+            if (connection.remaining > 0) {
+                const QByteArray chunk = socket->read(connection.remaining);
+                connection.message.append(chunk);
+                connection.remaining -= chunk.size();
+                if (connection.remaining > 0)
+                    break;
+            }
+
+            connection.timer->stop();
+            connection.headerRead = false;
+            if (connection.frameType == MessageFrame)
+                messages.append(QString::fromUtf8(connection.message));
+            else
+                data.append(connection.message);
+            lastId = connection.frameId;
+        }
+        if (!connection.headerRead)
+            connection.message.clear();
+    }
+
+    if (messages.isEmpty() && data.isEmpty())
+        return;
+
+    // One acknowledgement for the whole batch of processed frames
+    QDataStream ds(socket);
+    ds << lastId;
+
+    foreach (const QString &message, messages)
+        emit messageReceived(message);
+    foreach (const QByteArray &bytes, data)
+        emit dataReceived(bytes);
+}
+
+
+void QtLocalPeer::receptionTimedOut()
+{
+    QTimer* timer = qobject_cast<QTimer*>(sender());
+    QLocalSocket* socket = timer ? qobject_cast<QLocalSocket*>(timer->parent()) : 0;
+    if (!socket)
+        return;
+
+    qWarning("QtLocalPeer: Message reception timed out");
+    connections.remove(socket);
+    socket->abort();
+    socket->deleteLater();
+}
+
+
+void QtLocalPeer::connectionClosed()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket)
+        return;
+
+    QHash<QLocalSocket*, Connection>::iterator it = connections.find(socket);
+    if (it != connections.end()) {
+        // Closing an idle channel is the regular way to end it
+        if (!it->channel || it->headerRead)
+            qWarning("QtLocalPeer: Message reception failed %s", socket->errorString().toLatin1().constData());
+        connections.erase(it);
+    }
+    socket->deleteLater();
+}
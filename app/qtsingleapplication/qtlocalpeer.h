@@ -41,9 +41,16 @@
 #include <QtNetwork/QLocalServer>
 #include <QtNetwork/QLocalSocket>
 #include <QtCore/QDir>
+#include <QtCore/QHash>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 #include "qtlockedfile.h"
 
+class QtSharedRing;
+
 class QtLocalPeer : public QObject
 {
     Q_OBJECT
@@ -52,15 +59,34 @@ public:
     QtLocalPeer(QObject *parent = 0, const QString &appId = QString());
     bool isClient();
     bool sendMessage(const QString &message, int timeout);
+    void setPersistentConnection(bool persistent)
+        { persistentConnection = persistent; }
+    bool isPersistentConnection() const
+        { return persistentConnection; }
+    quint32 postMessage(const QString &message, int timeout);
+    bool waitForAcknowledgement(quint32 requestId, int timeout);
+    bool flush(int timeout);
+    bool sendData(const QByteArray &data, int timeout);
     QString applicationId() const
         { return id; }
+    QString serverName() const
+        { return socketName; }
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    void messageAcknowledged(quint32 requestId);
+    void dataReceived(const QByteArray &data);
 
 protected Q_SLOTS:
     void receiveConnection();
 
+private Q_SLOTS:
+    void readMessage();
+    void receptionTimedOut();
+    void connectionClosed();
+    void readAcknowledgements();
+    void channelClosed();
+
 protected:
     QString id;
     QString socketName;
@@ -68,5 +94,47 @@ protected:
     QtLP_Private::QtLockedFile lockFile;
 
 private:
+    enum PeerState { PeerUnknown, PeerStarting, PeerReady, PeerFailed };
+
+    // Reception state of one incoming connection
+    struct Connection
+    {
+        Connection() : timer(0), channel(false), headerRead(false),
+            remaining(0), frameType(0), frameId(0) {}
+        QTimer *timer;
+        bool channel;
+        bool headerRead;
+        quint32 remaining;
+        quint8 frameType;
+        quint32 frameId;
+        QByteArray message;
+    };
+
+    // Frames sent over the persistent channel
+    enum FrameType {
+        MessageFrame = 1,
+        DataFrame = 2
+    };
+
+    void readMessage(QLocalSocket *socket);
+    void readFrames(QLocalSocket *socket);
+    bool openChannel(int timeout);
+    bool connectToPeer(QLocalSocket *socket, int timeout);
+    PeerState peerState(qint64 *pid = 0);
+    void writePeerState(PeerState state);
+    static void sleepMs(int ms);
+    quint32 postFrame(quint8 type, const QByteArray &payload, int timeout);
+
+    QHash<QLocalSocket*, Connection> connections;
+    bool persistentConnection;
+    QLocalSocket* channel;
+    quint32 lastRequestId;
+    quint32 lastAcknowledgedId;
+    QtSharedRing* ring;
     static const char* ack;
+    static const int receptionTimeout;
+    static const quint32 maxMessageSize;
+    static const quint32 channelMagic;
+    static const int frameHeaderSize;
+    static const int ringCapacity;
 };
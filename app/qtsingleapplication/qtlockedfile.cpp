@@ -62,6 +62,17 @@
     The lock provided by an instance of \e QtLockedFile is released
     whenever the program terminates. This is true even when the
     program crashes and no destructors are called.
+
+    Besides the whole file, byte ranges of it may be locked with
+    lockRange(), so that several processes can work on different
+    regions of a shared file at the same time. Whole-file locks and
+    range locks must not be mixed on the same object.
+
+    By default locks belong to the process (\e fcntl() locks on Unix),
+    threads of the same process therefore do not exclude each other.
+    With the FileDescriptionScope, locks belong to the opened file
+    instead, and separate \e QtLockedFile objects exclude each other
+    even within one process.
 */
 
 /*! \enum QtLockedFile::LockMode
@@ -73,6 +84,18 @@
     \value NoLock Neither a read lock nor a write lock.
 */
 
+/*! \enum QtLockedFile::LockScope
+
+    This enum describes who owns the locks.
+
+    \value ProcessScope Locks are owned by the process. Objects
+    in the same process never block each other.
+    \value FileDescriptionScope Locks are owned by the opened file
+    (open file description locks on Linux). Objects opened separately
+    block each other, even when used from different threads of the
+    same process.
+*/
+
 /*!
     Constructs an unlocked \e QtLockedFile object. This constructor
     behaves in the same way as \e QFile::QFile().
@@ -87,6 +110,7 @@ QtLockedFile::QtLockedFile()
     rmutex = 0;
 #endif
     m_lock_mode = NoLock;
+    m_lock_scope = ProcessScope;
 }
 
 /*!
@@ -104,6 +128,7 @@ QtLockedFile::QtLockedFile(const QString &name)
     rmutex = 0;
 #endif
     m_lock_mode = NoLock;
+    m_lock_scope = ProcessScope;
 }
 
 /*!
@@ -151,8 +176,6 @@ QtLockedFile::LockMode QtLockedFile::lockMode() const
 }
 
 /*!
-    \fn bool QtLockedFile::lock(LockMode mode, bool block = true)
-
     Obtains a lock of type \a mode. The file must be opened before it
     can be locked.
 
@@ -168,7 +191,21 @@ QtLockedFile::LockMode QtLockedFile::lockMode() const
     This function returns \e true if, after it executes, the file is
     locked by this object, and \e false otherwise.
 
-    \sa unlock(), isLocked(), lockMode()
+    \sa tryLock(), unlock(), isLocked(), lockMode()
+*/
+bool QtLockedFile::lock(LockMode mode, bool block)
+{
+    return tryLock(mode, block ? -1 : 0);
+}
+
+/*!
+    \fn bool QtLockedFile::tryLock(LockMode mode, int timeout)
+
+    Obtains a lock of type \a mode like lock(), waiting at most \a
+    timeout milliseconds for it. A negative \a timeout waits forever,
+    0 does not wait at all.
+
+    \sa lock()
 */
 
 /*!
@@ -184,9 +221,144 @@ QtLockedFile::LockMode QtLockedFile::lockMode() const
     \sa lock(), isLocked(), lockMode()
 */
 
+/*!
+    Locks \a length bytes of the file starting at \a start in \a mode,
+    waiting at most \a timeout milliseconds (forever if negative). The
+    range does not need to exist in the file yet.
+
+    Locking a range that is already locked by this object with a
+    different mode changes the mode of the lock. On Unix this is atomic,
+    on Windows the range is released first.
+
+    Returns \e true if the range is locked by this object afterwards.
+
+    \sa unlockRange(), isRangeLocked()
+*/
+bool QtLockedFile::lockRange(LockMode mode, qint64 start, qint64 length, int timeout)
+{
+    if (!isOpen()) {
+        qWarning("QtLockedFile::lockRange(): file is not opened");
+        return false;
+    }
+    if (mode == NoLock)
+        return unlockRange(start, length);
+    if (start < 0 || length <= 0) {
+        qWarning("QtLockedFile::lockRange(): invalid range");
+        return false;
+    }
+    if (isLocked()) {
+        qWarning("QtLockedFile::lockRange(): the whole file is locked");
+        return false;
+    }
+
+    int idx = rangeIndex(start, length);
+    if (idx >= 0 && m_ranges.at(idx).mode == mode)
+        return true;
+#ifdef Q_OS_WIN
+    if (idx >= 0) {
+        if (!unlockRangeHelper(m_ranges.at(idx)))
+            return false;
+        m_ranges.removeAt(idx);
+        idx = -1;
+    }
+#endif
+
+    if (!lockRangeHelper(mode, start, length, timeout))
+        return false;
+
+    if (idx >= 0) {
+        m_ranges[idx].mode = mode;
+    }
+    else {
+        LockedRange range;
+        range.start = start;
+        range.length = length;
+        range.mode = mode;
+        m_ranges.append(range);
+    }
+    return true;
+}
+
+/*!
+    Releases the range of \a length bytes starting at \a start, which
+    must have been locked by lockRange() with the same arguments.
+
+    Returns \e true if the range is not locked by this object
+    afterwards.
+
+    \sa lockRange()
+*/
+bool QtLockedFile::unlockRange(qint64 start, qint64 length)
+{
+    if (!isOpen()) {
+        qWarning("QtLockedFile::unlockRange(): file is not opened");
+        return false;
+    }
+
+    const int idx = rangeIndex(start, length);
+    if (idx < 0)
+        return true;
+
+    if (!unlockRangeHelper(m_ranges.at(idx)))
+        return false;
+    m_ranges.removeAt(idx);
+    return true;
+}
+
+/*!
+    Returns \e true if this object holds a lock on exactly \a length
+    bytes starting at \a start.
+*/
+bool QtLockedFile::isRangeLocked(qint64 start, qint64 length) const
+{
+    return rangeIndex(start, length) >= 0;
+}
+
+/*!
+    \fn bool QtLockedFile::setLockScope(LockScope scope)
+
+    Sets the owner of the locks obtained later to \a scope. The scope
+    can only be changed while nothing is locked by this object.
+
+    Returns \e false if \a scope is not supported by the platform,
+    the ProcessScope is kept then.
+
+    On Windows the scope is accepted but has no effect: whole-file
+    locks are always taken through the named mutexes, and range
+    locks always belong to the file handle.
+
+    \sa lockScope()
+*/
+
+/*!
+    Returns the owner of the locks obtained by this object.
+
+    \sa setLockScope()
+*/
+QtLockedFile::LockScope QtLockedFile::lockScope() const
+{
+    return m_lock_scope;
+}
+
+int QtLockedFile::rangeIndex(qint64 start, qint64 length) const
+{
+    for (int i = 0; i < m_ranges.size(); i++) {
+        if (m_ranges.at(i).start == start && m_ranges.at(i).length == length)
+            return i;
+    }
+    return -1;
+}
+
+void QtLockedFile::unlockRanges()
+{
+    foreach (const LockedRange &range, m_ranges)
+        unlockRangeHelper(range);
+    m_ranges.clear();
+}
+
 /*!
     \fn QtLockedFile::~QtLockedFile()
 
-    Destroys the \e QtLockedFile object. If any locks were held, they
-    are released.
+    Destroys the \e QtLockedFile object. If any locks, including
+    range locks, were held, they are released.
 */
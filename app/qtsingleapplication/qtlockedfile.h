@@ -41,6 +41,7 @@
 #define QTLOCKEDFILE_H
 
 #include <QtCore/QFile>
+#include <QtCore/QList>
 #ifdef Q_OS_WIN
 #include <QtCore/QVector>
 #endif
@@ -67,6 +68,7 @@ class QT_QTLOCKEDFILE_EXPORT QtLockedFile : public QFile
 {
 public:
     enum LockMode { NoLock = 0, ReadLock, WriteLock };
+    enum LockScope { ProcessScope = 0, FileDescriptionScope };
 
     QtLockedFile();
     QtLockedFile(const QString &name);
@@ -75,11 +77,31 @@ public:
     bool open(OpenMode mode);
 
     bool lock(LockMode mode, bool block = true);
+    bool tryLock(LockMode mode, int timeout);
     bool unlock();
     bool isLocked() const;
     LockMode lockMode() const;
 
+    bool lockRange(LockMode mode, qint64 start, qint64 length, int timeout = -1);
+    bool unlockRange(qint64 start, qint64 length);
+    bool isRangeLocked(qint64 start, qint64 length) const;
+
+    bool setLockScope(LockScope scope);
+    LockScope lockScope() const;
+
 private:
+    struct LockedRange
+    {
+        qint64 start;
+        qint64 length;
+        LockMode mode;
+    };
+
+    bool lockRangeHelper(LockMode mode, qint64 start, qint64 length, int timeout);
+    bool unlockRangeHelper(const LockedRange &range);
+    void unlockRanges();
+    int rangeIndex(qint64 start, qint64 length) const;
+
 #ifdef Q_OS_WIN
     Qt::HANDLE wmutex;
     Qt::HANDLE rmutex;
@@ -87,10 +109,12 @@ private:
     QString mutexname;
 
     Qt::HANDLE getMutexHandle(int idx, bool doCreate);
-    bool waitMutex(Qt::HANDLE mutex, bool doBlock);
+    bool waitMutex(Qt::HANDLE mutex, int timeout);
 
 #endif
     LockMode m_lock_mode;
+    LockScope m_lock_scope;
+    QList<LockedRange> m_ranges;
 };
 }
 #endif
@@ -41,10 +41,76 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+
+#include <QtCore/QTime>
 
 #include "qtlockedfile.h"
 
-bool QtLockedFile::lock(LockMode mode, bool block)
+// Open file description locks, Linux 3.15 and later
+#if defined(F_OFD_SETLK) && defined(F_OFD_SETLKW)
+#  define QTLF_HAVE_OFD_LOCKS
+#endif
+
+/*
+    Applies a fcntl() lock of \a type on the given range of \a fd, with the
+    owner given by \a scope. Returns 0 on success, the errno value otherwise.
+*/
+static int setFcntlLock(int fd, QtLockedFile::LockScope scope, short type,
+                        qint64 start, qint64 length, bool block)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_whence = SEEK_SET;
+    fl.l_start = start;
+    fl.l_len = length;
+    fl.l_type = type;
+
+    int cmd = block ? F_SETLKW : F_SETLK;
+#ifdef QTLF_HAVE_OFD_LOCKS
+    if (scope == QtLockedFile::FileDescriptionScope)
+        cmd = block ? F_OFD_SETLKW : F_OFD_SETLK;
+#else
+    Q_UNUSED(scope);
+#endif
+
+    int ret;
+    do {
+        ret = fcntl(fd, cmd, &fl);
+    } while (ret == -1 && errno == EINTR && block);
+    return ret == -1 ? errno : 0;
+}
+
+/*
+    As setFcntlLock(), but waits at most \a timeout milliseconds for a
+    conflicting lock to go away (forever if negative). fcntl() has no timed
+    wait, so the lock is polled with an increasing delay.
+*/
+static int waitFcntlLock(int fd, QtLockedFile::LockScope scope, short type,
+                         qint64 start, qint64 length, int timeout)
+{
+    if (timeout < 0)
+        return setFcntlLock(fd, scope, type, start, length, true);
+
+    QTime timer;
+    timer.start();
+    int delay = 1;
+    forever {
+        const int error = setFcntlLock(fd, scope, type, start, length, false);
+        if (error != EAGAIN && error != EACCES)
+            return error;
+
+        const int remaining = timeout - timer.elapsed();
+        if (remaining <= 0)
+            return error;
+        const int ms = qMin(delay, remaining);
+        struct timespec ts = { ms / 1000, (ms % 1000) * 1000 * 1000 };
+        nanosleep(&ts, NULL);
+        delay = qMin(delay * 2, 32);
+    }
+}
+
+bool QtLockedFile::tryLock(LockMode mode, int timeout)
 {
     if (!isOpen()) {
         qWarning("QtLockedFile::lock(): file is not opened");
@@ -57,20 +123,19 @@ bool QtLockedFile::lock(LockMode mode, bool block)
     if (mode == m_lock_mode)
         return true;
 
+    if (!m_ranges.isEmpty()) {
+        qWarning("QtLockedFile::lock(): ranges of the file are locked");
+        return false;
+    }
+
     if (m_lock_mode != NoLock)
         unlock();
 
-    struct flock fl;
-    fl.l_whence = SEEK_SET;
-    fl.l_start = 0;
-    fl.l_len = 0;
-    fl.l_type = (mode == ReadLock) ? F_RDLCK : F_WRLCK;
-    int cmd = block ? F_SETLKW : F_SETLK;
-    int ret = fcntl(handle(), cmd, &fl);
-    
-    if (ret == -1) {
-        if (errno != EINTR && errno != EAGAIN)
-            qWarning("QtLockedFile::lock(): fcntl: %s", strerror(errno));
+    int error = waitFcntlLock(handle(), m_lock_scope,
+                              (mode == ReadLock) ? F_RDLCK : F_WRLCK, 0, 0, timeout);
+    if (error != 0) {
+        if (error != EINTR && error != EAGAIN && error != EACCES)
+            qWarning("QtLockedFile::lock(): fcntl: %s", strerror(error));
         return false;
     }
 
@@ -90,15 +155,9 @@ bool QtLockedFile::unlock()
     if (!isLocked())
         return true;
 
-    struct flock fl;
-    fl.l_whence = SEEK_SET;
-    fl.l_start = 0;
-    fl.l_len = 0;
-    fl.l_type = F_UNLCK;
-    int ret = fcntl(handle(), F_SETLKW, &fl);
-    
-    if (ret == -1) {
-        qWarning("QtLockedFile::lock(): fcntl: %s", strerror(errno));
+    int error = setFcntlLock(handle(), m_lock_scope, F_UNLCK, 0, 0, true);
+    if (error != 0) {
+        qWarning("QtLockedFile::lock(): fcntl: %s", strerror(error));
         return false;
     }
     
@@ -106,9 +165,46 @@ bool QtLockedFile::unlock()
     return true;
 }
 
+bool QtLockedFile::lockRangeHelper(LockMode mode, qint64 start, qint64 length, int timeout)
+{
+    int error = waitFcntlLock(handle(), m_lock_scope,
+                              (mode == ReadLock) ? F_RDLCK : F_WRLCK, start, length, timeout);
+    if (error != 0) {
+        if (error != EINTR && error != EAGAIN && error != EACCES)
+            qWarning("QtLockedFile::lockRange(): fcntl: %s", strerror(error));
+        return false;
+    }
+    return true;
+}
+
+bool QtLockedFile::unlockRangeHelper(const LockedRange &range)
+{
+    int error = setFcntlLock(handle(), m_lock_scope, F_UNLCK, range.start, range.length, true);
+    if (error != 0) {
+        qWarning("QtLockedFile::unlockRange(): fcntl: %s", strerror(error));
+        return false;
+    }
+    return true;
+}
+
+bool QtLockedFile::setLockScope(LockScope scope)
+{
+    if (isLocked() || !m_ranges.isEmpty()) {
+        qWarning("QtLockedFile::setLockScope(): file is locked");
+        return false;
+    }
+#ifndef QTLF_HAVE_OFD_LOCKS
+    if (scope == FileDescriptionScope)
+        return false;
+#endif
+    m_lock_scope = scope;
+    return true;
+}
+
 QtLockedFile::~QtLockedFile()
 {
-    if (isOpen())
+    if (isOpen()) {
+        unlockRanges();
         unlock();
+    }
 }
-
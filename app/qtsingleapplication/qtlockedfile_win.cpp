@@ -39,7 +39,9 @@
 
 #include "qtlockedfile.h"
 #include <qt_windows.h>
+#include <io.h>
 #include <QtCore/QFileInfo>
+#include <QtCore/QTime>
 
 #define MUTEX_PREFIX "QtLockedFile mutex "
 // Maximum number of concurrent read locks. Must not be greater than MAXIMUM_WAIT_OBJECTS
@@ -77,10 +79,10 @@ Qt::HANDLE QtLockedFile::getMutexHandle(int idx, bool doCreate)
     return mutex;
 }
 
-bool QtLockedFile::waitMutex(Qt::HANDLE mutex, bool doBlock)
+bool QtLockedFile::waitMutex(Qt::HANDLE mutex, int timeout)
 {
     Q_ASSERT(mutex);
-    DWORD res = WaitForSingleObject(mutex, doBlock ? INFINITE : 0);
+    DWORD res = WaitForSingleObject(mutex, timeout < 0 ? INFINITE : DWORD(timeout));
     switch (res) {
     case WAIT_OBJECT_0:
     case WAIT_ABANDONED:
@@ -96,7 +98,7 @@ bool QtLockedFile::waitMutex(Qt::HANDLE mutex, bool doBlock)
 
 
 
-bool QtLockedFile::lock(LockMode mode, bool block)
+bool QtLockedFile::tryLock(LockMode mode, int timeout)
 {
     if (!isOpen()) {
         qWarning("QtLockedFile::lock(): file is not opened");
@@ -109,20 +111,27 @@ bool QtLockedFile::lock(LockMode mode, bool block)
     if (mode == m_lock_mode)
         return true;
 
+    if (!m_ranges.isEmpty()) {
+        qWarning("QtLockedFile::lock(): ranges of the file are locked");
+        return false;
+    }
+
     if (m_lock_mode != NoLock)
         unlock();
 
     if (!wmutex && !(wmutex = getMutexHandle(-1, true)))
         return false;
 
-    if (!waitMutex(wmutex, block))
+    QTime timer;
+    timer.start();
+    if (!waitMutex(wmutex, timeout))
         return false;
 
     if (mode == ReadLock) {
         int idx = 0;
         for (; idx < MAX_READERS; idx++) {
             rmutex = getMutexHandle(idx, false);
-            if (!rmutex || waitMutex(rmutex, false))
+            if (!rmutex || waitMutex(rmutex, 0))
                 break;
             CloseHandle(rmutex);
         }
@@ -134,7 +143,7 @@ bool QtLockedFile::lock(LockMode mode, bool block)
         }
         else if (!rmutex) {
             rmutex = getMutexHandle(idx, true);
-            if (!rmutex || !waitMutex(rmutex, false))
+            if (!rmutex || !waitMutex(rmutex, 0))
                 ok = false;
         }
         if (!ok && rmutex) {
@@ -153,8 +162,10 @@ bool QtLockedFile::lock(LockMode mode, bool block)
                 rmutexes.append(mutex);
         }
         if (rmutexes.size()) {
+            const DWORD remaining = timeout < 0
+                ? INFINITE : DWORD(qMax(timeout - timer.elapsed(), 0));
             DWORD res = WaitForMultipleObjects(rmutexes.size(), rmutexes.constData(),
-                                               TRUE, block ? INFINITE : 0);
+                                               TRUE, remaining);
             if (res != WAIT_OBJECT_0 && res != WAIT_ABANDONED) {
                 if (res != WAIT_TIMEOUT)
                     qErrnoWarning("QtLockedFile::lock(): WaitForMultipleObjects failed");
@@ -197,10 +208,71 @@ bool QtLockedFile::unlock()
     return true;
 }
 
+/*
+    Range locks are LockFileEx() locks, which belong to the file handle.
+    Unlike the whole-file locks they are mandatory: locked ranges cannot be
+    read or written through other handles.
+*/
+bool QtLockedFile::lockRangeHelper(LockMode mode, qint64 start, qint64 length, int timeout)
+{
+    HANDLE fh = HANDLE(_get_osfhandle(handle()));
+    DWORD flags = (mode == WriteLock) ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+    if (timeout >= 0)
+        flags |= LOCKFILE_FAIL_IMMEDIATELY;
+
+    QTime timer;
+    timer.start();
+    int delay = 1;
+    forever {
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = DWORD(start & 0xffffffff);
+        ov.OffsetHigh = DWORD(start >> 32);
+        if (LockFileEx(fh, flags, 0, DWORD(length & 0xffffffff), DWORD(length >> 32), &ov))
+            return true;
+
+        if (GetLastError() != ERROR_LOCK_VIOLATION) {
+            qErrnoWarning("QtLockedFile::lockRange(): LockFileEx failed");
+            return false;
+        }
+        const int remaining = timeout - timer.elapsed();
+        if (remaining <= 0)
+            return false;
+        Sleep(DWORD(qMin(delay, remaining)));
+        delay = qMin(delay * 2, 32);
+    }
+}
+
+bool QtLockedFile::unlockRangeHelper(const LockedRange &range)
+{
+    HANDLE fh = HANDLE(_get_osfhandle(handle()));
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = DWORD(range.start & 0xffffffff);
+    ov.OffsetHigh = DWORD(range.start >> 32);
+    if (!UnlockFileEx(fh, 0, DWORD(range.length & 0xffffffff), DWORD(range.length >> 32), &ov)) {
+        qErrnoWarning("QtLockedFile::unlockRange(): UnlockFileEx failed");
+        return false;
+    }
+    return true;
+}
+
+bool QtLockedFile::setLockScope(LockScope scope)
+{
+    if (isLocked() || !m_ranges.isEmpty()) {
+        qWarning("QtLockedFile::setLockScope(): file is locked");
+        return false;
+    }
+    m_lock_scope = scope;
+    return true;
+}
+
 QtLockedFile::~QtLockedFile()
 {
-    if (isOpen())
+    if (isOpen()) {
+        unlockRanges();
         unlock();
+    }
     if (wmutex)
         CloseHandle(wmutex);
 }
@@ -0,0 +1,301 @@
+#include "qtsharedring.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QSystemSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+
+#include <string.h>
+
+#if defined(Q_OS_WIN)
+#include <QtCore/qt_windows.h>
+#else
+#include <time.h>
+#endif
+
+// Placed at the beginning of the shared memory, followed by the ring data.
+// Positions grow monotonically and are taken modulo capacity, so the used
+// space is always head - tail.
+struct QtSharedRing::Header
+{
+    quint32 magic;
+    quint32 capacity;
+    quint32 head;
+    quint32 tail;
+    quint32 readerAlive;
+};
+
+namespace {
+    const quint32 RingMagic = 0x51524e47; // "QRNG"
+
+    // Records are a quint32 size followed by the data padded to 4 bytes
+    inline quint32 recordSize(quint32 dataSize)
+    {
+        return sizeof(quint32) + ((dataSize + 3) & ~quint32(3));
+    }
+
+    // Capacity is a power of two so that positions stay continuous when they
+    // overflow
+    inline int ringCapacity(int size)
+    {
+        int capacity = 4;
+        while (capacity <= size / 2)
+            capacity *= 2;
+        return capacity;
+    }
+
+    void sleepMs(int ms)
+    {
+#if defined(Q_OS_WIN)
+        Sleep(DWORD(ms));
+#else
+        struct timespec ts = { ms / 1000, (ms % 1000) * 1000 * 1000 };
+        nanosleep(&ts, NULL);
+#endif
+    }
+}
+
+class QtSharedRing::Reader : public QThread
+{
+public:
+    Reader(QtSharedRing *ring) : ring(ring) {}
+
+    void stop()
+    {
+        stopping = 1;
+        ring->dataAvailable->release();
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        forever {
+            ring->dataAvailable->acquire();
+            if (stopping)
+                break;
+            // One wake up may cover several records, later wake ups may
+            // find the ring empty
+            foreach (const QByteArray &data, ring->readAll())
+                emit ring->dataReceived(data);
+        }
+    }
+
+private:
+    QtSharedRing *const ring;
+    QAtomicInt stopping;
+};
+
+
+QtSharedRing::QtSharedRing(const QString &key, QObject *parent)
+    : QObject(parent), memory(key), dataAvailable(0), reader(0)
+{
+}
+
+
+QtSharedRing::~QtSharedRing()
+{
+    if (reader) {
+        if (memory.lock()) {
+            header()->readerAlive = 0;
+            memory.unlock();
+        }
+        reader->stop();
+        delete reader;
+    }
+    delete dataAvailable;
+}
+
+
+/*
+    Creates the ring of \a capacity bytes and starts consuming messages.
+    Used by the running instance only. A segment left behind by a crashed
+    instance is reused.
+*/
+bool QtSharedRing::create(int capacity)
+{
+    Q_ASSERT(!reader);
+    capacity = ringCapacity(capacity);
+
+    if (!memory.create(sizeof(Header) + capacity)) {
+        if (memory.error() != QSharedMemory::AlreadyExists || !memory.attach()) {
+            qWarning("QtSharedRing: Unable to create shared memory: %s",
+                     qPrintable(memory.errorString()));
+            return false;
+        }
+        capacity = ringCapacity(memory.size() - int(sizeof(Header)));
+    }
+
+    dataAvailable = new QSystemSemaphore(memory.key() + QLatin1String("-data"),
+                                         0, QSystemSemaphore::Create);
+    if (dataAvailable->error() != QSystemSemaphore::NoError) {
+        qWarning("QtSharedRing: Unable to create semaphore: %s",
+                 qPrintable(dataAvailable->errorString()));
+        memory.detach();
+        return false;
+    }
+
+    memory.lock();
+    Header *h = header();
+    h->magic = RingMagic;
+    h->capacity = capacity;
+    h->head = 0;
+    h->tail = 0;
+    h->readerAlive = 1;
+    memory.unlock();
+
+    reader = new Reader(this);
+    reader->start();
+    return true;
+}
+
+
+/*
+    Attaches to the ring created by the running instance.
+*/
+bool QtSharedRing::attach()
+{
+    if (isAttached())
+        return true;
+
+    if (!memory.attach())
+        return false;
+
+    if (memory.size() < int(sizeof(Header)) || header()->magic != RingMagic) {
+        memory.detach();
+        return false;
+    }
+
+    delete dataAvailable;
+    dataAvailable = new QSystemSemaphore(memory.key() + QLatin1String("-data"),
+                                         0, QSystemSemaphore::Open);
+    if (dataAvailable->error() != QSystemSemaphore::NoError) {
+        memory.detach();
+        return false;
+    }
+    return true;
+}
+
+
+bool QtSharedRing::isAttached() const
+{
+    return memory.isAttached();
+}
+
+
+int QtSharedRing::capacity() const
+{
+    return isAttached() ? int(header()->capacity) : 0;
+}
+
+
+/*
+    Copies \a data into the ring, waiting up to \a timeout milliseconds for
+    free space. Returns false if the data does not fit into the ring or no
+    reader consumes it, the caller is expected to fall back to another
+    transport then.
+*/
+bool QtSharedRing::write(const QByteArray &data, int timeout)
+{
+    if (!isAttached())
+        return false;
+
+    const quint32 size = data.size();
+    const quint32 needed = recordSize(size);
+    if (needed > header()->capacity)
+        return false;
+
+    QTime timer;
+    timer.start();
+    forever {
+        if (!memory.lock())
+            return false;
+
+        Header *h = header();
+        if (!h->readerAlive) {
+            memory.unlock();
+            return false;
+        }
+        if (h->capacity - (h->head - h->tail) >= needed) {
+            copyIn(h->head, &size, sizeof(size));
+            copyIn(h->head + sizeof(quint32), data.constData(), size);
+            h->head += needed;
+            memory.unlock();
+            dataAvailable->release();
+            return true;
+        }
+        memory.unlock();
+
+        if (timer.elapsed() >= timeout)
+            return false;
+        sleepMs(1);
+    }
+}
+
+
+QtSharedRing::Header *QtSharedRing::header() const
+{
+    return static_cast<Header *>(const_cast<void *>(memory.constData()));
+}
+
+
+void QtSharedRing::copyIn(quint32 position, const void *data, quint32 size)
+{
+    Header *h = header();
+    char *ring = reinterpret_cast<char *>(h + 1);
+    const quint32 offset = position % h->capacity;
+    const quint32 first = qMin(size, h->capacity - offset);
+    memcpy(ring + offset, data, first);
+    memcpy(ring, static_cast<const char *>(data) + first, size - first);
+}
+
+
+void QtSharedRing::copyOut(quint32 position, void *data, quint32 size) const
+{
+    const Header *h = header();
+    const char *ring = reinterpret_cast<const char *>(h + 1);
+    const quint32 offset = position % h->capacity;
+    const quint32 first = qMin(size, h->capacity - offset);
+    memcpy(data, ring + offset, first);
+    memcpy(static_cast<char *>(data) + first, ring, size - first);
+}
+
+
+QList<QByteArray> QtSharedRing::readAll()
+{
+    QList<QByteArray> records;
+    if (!memory.lock())
+        return records;
+
+    // Any local process may write to the ring, sizes read from it are
+    // checked to stay within the used space and the mapping
+    Header *h = header();
+    const quint32 mapped = quint32(memory.size()) - sizeof(Header);
+    if (h->capacity == 0 || h->capacity > mapped
+            || h->head - h->tail > h->capacity) {
+        qWarning("QtSharedRing: Ring header is corrupt");
+        h->tail = h->head;
+        memory.unlock();
+        return records;
+    }
+
+    while (h->tail != h->head) {
+        const quint32 used = h->head - h->tail;
+        quint32 size = 0;
+        if (used >= sizeof(size))
+            copyOut(h->tail, &size, sizeof(size));
+        if (used < sizeof(size) || size > h->capacity
+                || recordSize(size) > used) {
+            qWarning("QtSharedRing: Dropping corrupt record");
+            h->tail = h->head;
+            break;
+        }
+        QByteArray data;
+        data.resize(size);
+        copyOut(h->tail + sizeof(quint32), data.data(), size);
+        h->tail += recordSize(size);
+        records.append(data);
+    }
+    memory.unlock();
+    return records;
+}
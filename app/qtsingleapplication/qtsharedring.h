@@ -0,0 +1,52 @@
+#ifndef QTSHAREDRING_H
+#define QTSHAREDRING_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QObject>
+#include <QtCore/QSharedMemory>
+
+QT_BEGIN_NAMESPACE
+class QSystemSemaphore;
+QT_END_NAMESPACE
+
+/*
+    Message ring buffer placed in shared memory. The running instance
+    creates the ring and consumes messages on a reader thread, other
+    instances attach to it and write messages with a single copy. Writers
+    are serialized by the shared memory lock, the reader is woken up by a
+    system semaphore.
+*/
+class QtSharedRing : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QtSharedRing(const QString &key, QObject *parent = 0);
+    ~QtSharedRing();
+
+    bool create(int capacity);
+    bool attach();
+    bool isAttached() const;
+    int capacity() const;
+
+    bool write(const QByteArray &data, int timeout);
+
+Q_SIGNALS:
+    void dataReceived(const QByteArray &data);
+
+private:
+    class Reader;
+    friend class Reader;
+    struct Header;
+
+    Header *header() const;
+    void copyIn(quint32 position, const void *data, quint32 size);
+    void copyOut(quint32 position, void *data, quint32 size) const;
+    QList<QByteArray> readAll();
+
+    QSharedMemory memory;
+    QSystemSemaphore *dataAvailable;
+    Reader *reader;
+};
+
+#endif // QTSHAREDRING_H
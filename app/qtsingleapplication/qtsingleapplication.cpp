@@ -137,6 +137,7 @@ void QtSingleApplication::sysInit(const QString &appId)
     actWin = 0;
     peer = new QtLocalPeer(this, appId);
     connect(peer, SIGNAL(messageReceived(const QString&)), SIGNAL(messageReceived(const QString&)));
+    connect(peer, SIGNAL(dataReceived(const QByteArray&)), SIGNAL(dataReceived(const QByteArray&)));
 }
 
 
@@ -259,6 +260,78 @@ bool QtSingleApplication::sendMessage(const QString &message, int timeout)
 }
 
 
+/*!
+    Queues the text \a message for the currently running instance and
+    returns immediately, without waiting for the message to be processed.
+    Messages are sent over one persistent connection, so this is the
+    preferred way to forward many messages. \a timeout limits the time
+    spent opening the connection.
+
+    Returns the request id of the message or 0 on failure.
+
+    \sa flushMessages(), setPersistentConnection()
+*/
+quint32 QtSingleApplication::postMessage(const QString &message, int timeout)
+{
+    return peer->postMessage(message, timeout);
+}
+
+
+/*!
+    Waits up to \a timeout milliseconds until every message queued by
+    postMessage() is processed by the running instance.
+
+    Returns true if all messages were acknowledged.
+
+    \sa postMessage()
+*/
+bool QtSingleApplication::flushMessages(int timeout)
+{
+    return peer->flush(timeout);
+}
+
+
+/*!
+    Sends binary \a data (e.g. a dataset) to the currently running
+    instance, which emits the dataReceived() signal. Data is placed into a
+    shared memory ring when possible, so large transfers avoid copying
+    through the local socket; otherwise the persistent connection is used.
+
+    Returns true if the data has been handed over to the running instance
+    within \a timeout milliseconds.
+
+    \sa dataReceived()
+*/
+bool QtSingleApplication::sendData(const QByteArray &data, int timeout)
+{
+    return peer->sendData(data, timeout);
+}
+
+
+/*!
+    If \a persistent is true, sendMessage() reuses one connection to the
+    running instance for all messages instead of connecting for every
+    message. The default is false.
+
+    \sa postMessage()
+*/
+void QtSingleApplication::setPersistentConnection(bool persistent)
+{
+    peer->setPersistentConnection(persistent);
+}
+
+
+/*!
+    Returns true if messages are sent over one persistent connection.
+
+    \sa setPersistentConnection()
+*/
+bool QtSingleApplication::isPersistentConnection() const
+{
+    return peer->isPersistentConnection();
+}
+
+
 /*!
     Returns the application identifier. Two processes with the same
     identifier will be regarded as instances of the same application.
@@ -269,6 +342,17 @@ QString QtSingleApplication::id() const
 }
 
 
+/*!
+    Returns the name of the local socket the running instance listens on.
+    It is derived from the application identifier and can be used to
+    name sibling sockets serving other purposes.
+*/
+QString QtSingleApplication::serverName() const
+{
+    return peer->serverName();
+}
+
+
 /*!
   Sets the activation window of this application to \a aw. The
   activation window is the widget that will be activated by
@@ -337,6 +421,16 @@ void QtSingleApplication::activateWindow()
 */
 
 
+/*!
+    \fn void QtSingleApplication::dataReceived(const QByteArray& data)
+
+    This signal is emitted when the current instance receives binary \a
+    data from another instance of this application.
+
+    \sa sendData()
+*/
+
+
 /*!
     \fn void QtSingleApplication::initialize(bool dummy = true)
 
@@ -74,6 +74,10 @@ public:
 
     bool isRunning();
     QString id() const;
+    QString serverName() const;
+
+    void setPersistentConnection(bool persistent);
+    bool isPersistentConnection() const;
 
     void setActivationWindow(QWidget* aw, bool activateOnMessage = true);
     QWidget* activationWindow() const;
@@ -84,11 +88,15 @@ public:
 
 public Q_SLOTS:
     bool sendMessage(const QString &message, int timeout = 5000);
+    quint32 postMessage(const QString &message, int timeout = 5000);
+    bool flushMessages(int timeout = 5000);
+    bool sendData(const QByteArray &data, int timeout = 5000);
     void activateWindow();
 
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    void dataReceived(const QByteArray &data);
 
 
 private:
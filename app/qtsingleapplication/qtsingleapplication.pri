@@ -3,5 +3,8 @@
 HEADERS +=  $$PWD/qtlocalpeer.h
 SOURCES +=  $$PWD/qtlocalpeer.cpp
 
+HEADERS +=  $$PWD/qtsharedring.h
+SOURCES +=  $$PWD/qtsharedring.cpp
+
 HEADERS +=  $$PWD/qtsingleapplication.h
 SOURCES +=  $$PWD/qtsingleapplication.cpp
@@ -0,0 +1,335 @@
+#include "databatch.h"
+
+#include <limits.h>
+#include <string.h>
+
+using namespace PluginLoader;
+
+namespace {
+    // Buffer, columns and rows start at multiples of it
+    const int BufferAlignment = 8;
+
+    template <typename T>
+    inline T align(T value, T alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+/*!
+    \return the number of bytes a value of \a type takes in the buffer of a
+    DataBatch, Bytes values are stored as offset and length into the heap
+ */
+int DataField::width(Type type)
+{
+    switch (type) {
+    case Int32:
+        return sizeof(qint32);
+    case Int64:
+        return sizeof(qint64);
+    case Double:
+        return sizeof(double);
+    case Bytes:
+        return 2 * sizeof(quint32);
+    }
+    return 0;
+}
+
+namespace PluginLoader {
+
+class DataBatchData : public QSharedData
+{
+public:
+    DataBatchData() : layout(DataBatch::ColumnLayout), rowCount(0),
+        rowStride(0) {}
+
+    qint64 setup(const DataSchema &schema, int rowCount,
+            DataBatch::Layout layout);
+
+    DataSchema schema;
+    DataBatch::Layout layout;
+    int rowCount;
+    //! Offset of the field within a record for RowLayout, offset of the
+    //! column within the buffer for ColumnLayout
+    QVector<int> offsets;
+    int rowStride;
+    QByteArray buffer;
+    QByteArray heap;
+};
+
+/*
+    Computes the placement of the values, returns the size of the buffer or
+    -1 if it would be larger than a QByteArray can be. The size is computed
+    in 64 bits, as the row count may come from another process.
+*/
+qint64 DataBatchData::setup(const DataSchema &schema, int rowCount,
+        DataBatch::Layout layout)
+{
+    Q_ASSERT(rowCount >= 0);
+
+    this->schema = schema;
+    this->layout = layout;
+    this->rowCount = rowCount;
+    offsets.resize(schema.size());
+
+    qint64 size = 0;
+    if (layout == DataBatch::RowLayout) {
+        qint64 recordSize = 0;
+        for (int i = 0; i < schema.size() && recordSize <= INT_MAX; ++i) {
+            const qint64 width = DataField::width(schema.at(i).type);
+            recordSize = align(recordSize, width);
+            offsets[i] = int(recordSize);
+            recordSize += width;
+        }
+        recordSize = align(recordSize, qint64(BufferAlignment));
+        if (recordSize > INT_MAX)
+            return -1;
+        rowStride = int(recordSize);
+        size = recordSize * rowCount;
+    } else {
+        for (int i = 0; i < schema.size() && size <= INT_MAX; ++i) {
+            size = align(size, qint64(BufferAlignment));
+            offsets[i] = int(size);
+            size += qint64(DataField::width(schema.at(i).type)) * rowCount;
+        }
+    }
+    return size > INT_MAX ? -1 : size;
+}
+
+} // namespace PluginLoader
+
+/*!
+    Constructs a null batch.
+ */
+DataBatch::DataBatch()
+    : d(new DataBatchData)
+{
+}
+
+/*!
+    Constructs a batch of \a rowCount records of \a schema, all values zero.
+    The buffer of all records is allocated at once.
+ */
+DataBatch::DataBatch(const DataSchema &schema, int rowCount, Layout layout)
+    : d(new DataBatchData)
+{
+    const qint64 size = d->setup(schema, rowCount, layout);
+    if (size < 0) {
+        qWarning("%s: %d records don't fit into one batch", Q_FUNC_INFO,
+                rowCount);
+        d = new DataBatchData;
+        return;
+    }
+    d->buffer = QByteArray(int(size), '\0');
+}
+
+DataBatch::DataBatch(const DataBatch &other)
+    : d(other.d)
+{
+}
+
+DataBatch::~DataBatch()
+{
+}
+
+DataBatch &DataBatch::operator=(const DataBatch &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Constructs a batch over \a buffer and \a heap received from another
+    process, both are shared, not copied.
+    \return the batch or a null batch if \a layout or a type of \a schema
+    is unknown, or the size of \a buffer doesn't match \a schema and \a
+    rowCount
+ */
+DataBatch DataBatch::fromBuffer(const DataSchema &schema, int rowCount,
+        Layout layout, const QByteArray &buffer, const QByteArray &heap)
+{
+    if (rowCount < 0 || (layout != RowLayout && layout != ColumnLayout))
+        return DataBatch();
+    foreach (const DataField &field, schema) {
+        if (DataField::width(field.type) == 0)
+            return DataBatch();
+    }
+
+    DataBatch batch;
+    const qint64 size = batch.d->setup(schema, rowCount, layout);
+    if (size < 0 || size != buffer.size())
+        return DataBatch();
+
+    batch.d->buffer = buffer;
+    batch.d->heap = heap;
+    return batch;
+}
+
+bool DataBatch::isNull() const
+{
+    return d->schema.isEmpty();
+}
+
+DataSchema DataBatch::schema() const
+{
+    return d->schema;
+}
+
+DataBatch::Layout DataBatch::layout() const
+{
+    return d->layout;
+}
+
+int DataBatch::rowCount() const
+{
+    return d->rowCount;
+}
+
+int DataBatch::columnCount() const
+{
+    return d->schema.size();
+}
+
+//! \return the buffer of all records, the layout is given by layout()
+const char *DataBatch::constData() const
+{
+    return d->buffer.constData();
+}
+
+//! \return the size of the buffer in bytes, without the heap
+int DataBatch::size() const
+{
+    return d->buffer.size();
+}
+
+//! \return the buffer of all records, shared with the batch
+QByteArray DataBatch::buffer() const
+{
+    return d->buffer;
+}
+
+//! \return the value at \a row and \a column in the buffer
+const char *DataBatch::value(int row, int column) const
+{
+    return d->buffer.constData() + offset(row, column);
+}
+
+/*!
+    \return the first value of \a column, the next values follow each
+    columnStride() bytes
+ */
+const char *DataBatch::columnData(int column) const
+{
+    return value(0, column);
+}
+
+//! \return the distance in bytes between two values of \a column
+int DataBatch::columnStride(int column) const
+{
+    return d->layout == RowLayout
+        ? d->rowStride : DataField::width(d->schema.at(column).type);
+}
+
+//! \return the storage of the Bytes values, shared with the batch
+QByteArray DataBatch::heap() const
+{
+    return d->heap;
+}
+
+qint32 DataBatch::int32Value(int row, int column) const
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Int32);
+    qint32 result;
+    memcpy(&result, value(row, column), sizeof(result));
+    return result;
+}
+
+qint64 DataBatch::int64Value(int row, int column) const
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Int64);
+    qint64 result;
+    memcpy(&result, value(row, column), sizeof(result));
+    return result;
+}
+
+double DataBatch::doubleValue(int row, int column) const
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Double);
+    double result;
+    memcpy(&result, value(row, column), sizeof(result));
+    return result;
+}
+
+/*!
+    \return the Bytes value at \a row and \a column without copying it, the
+    result is valid as long as the batch or one of its copies exists
+ */
+QByteArray DataBatch::bytesValue(int row, int column) const
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Bytes);
+    quint32 location[2];
+    memcpy(location, value(row, column), sizeof(location));
+    // Batches received from other processes are not trusted
+    if (location[0] > quint32(d->heap.size())
+            || location[1] > quint32(d->heap.size()) - location[0])
+        return QByteArray();
+    return QByteArray::fromRawData(d->heap.constData() + location[0],
+            location[1]);
+}
+
+void DataBatch::setInt32Value(int row, int column, qint32 value)
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Int32);
+    memcpy(valueForWrite(row, column), &value, sizeof(value));
+}
+
+void DataBatch::setInt64Value(int row, int column, qint64 value)
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Int64);
+    memcpy(valueForWrite(row, column), &value, sizeof(value));
+}
+
+void DataBatch::setDoubleValue(int row, int column, double value)
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Double);
+    memcpy(valueForWrite(row, column), &value, sizeof(value));
+}
+
+/*!
+    Appends \a value to the heap of the batch. Values set before stay in the
+    heap, so each record should be set once.
+    \sa reserveHeap()
+ */
+void DataBatch::setBytesValue(int row, int column, const QByteArray &value)
+{
+    Q_ASSERT(d->schema.at(column).type == DataField::Bytes);
+    char *target = valueForWrite(row, column);
+    const quint32 location[2] = { quint32(d->heap.size()),
+        quint32(value.size()) };
+    d->heap.append(value);
+    memcpy(target, location, sizeof(location));
+}
+
+//! Preallocates \a size bytes for the Bytes values.
+void DataBatch::reserveHeap(int size)
+{
+    d->heap.reserve(size);
+}
+
+int DataBatch::offset(int row, int column) const
+{
+    Q_ASSERT(row >= 0 && row < d->rowCount);
+    Q_ASSERT(column >= 0 && column < d->schema.size());
+
+    if (d->layout == RowLayout)
+        return row * d->rowStride + d->offsets.at(column);
+    return d->offsets.at(column)
+        + row * DataField::width(d->schema.at(column).type);
+}
+
+char *DataBatch::valueForWrite(int row, int column)
+{
+    const int valueOffset = offset(row, column);
+    // Detaches the batch when it's shared
+    return d->buffer.data() + valueOffset;
+}
@@ -0,0 +1,101 @@
+#ifndef PLUGINLOADER_DATABATCH_H
+#define PLUGINLOADER_DATABATCH_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedDataPointer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "pluginloader_global.h"
+
+namespace PluginLoader {
+
+//! Description of one field of the records in a DataBatch.
+struct PLUGINLOADER_EXPORT DataField
+{
+    enum Type {
+        Int32,
+        Int64,
+        Double,
+        //! Variable length value, stored in the heap of the batch
+        Bytes
+    };
+
+    DataField() : type(Int32) {}
+    DataField(const QString &name, Type type) : name(name), type(type) {}
+
+    static int width(Type type);
+
+    QString name;
+    Type type;
+};
+
+typedef QVector<DataField> DataSchema;
+
+class DataBatchData;
+
+/*!
+    \brief Records of a fixed schema in one contiguous, shared buffer.
+
+    Copies of a batch share the buffer, so handing a batch from a data source
+    to any number of sinks neither allocates nor copies per record. Writing to
+    a batch that is shared detaches it first, thus producers fill a batch
+    completely before they deliver it.
+ */
+class PLUGINLOADER_EXPORT DataBatch
+{
+public:
+    enum Layout {
+        //! Fields of a record are adjacent
+        RowLayout,
+        //! Values of a field are adjacent
+        ColumnLayout
+    };
+
+    DataBatch();
+    DataBatch(const DataSchema &schema, int rowCount,
+            Layout layout = ColumnLayout);
+    DataBatch(const DataBatch &other);
+    ~DataBatch();
+    DataBatch &operator=(const DataBatch &other);
+
+    static DataBatch fromBuffer(const DataSchema &schema, int rowCount,
+            Layout layout, const QByteArray &buffer, const QByteArray &heap);
+
+    bool isNull() const;
+    DataSchema schema() const;
+    Layout layout() const;
+    int rowCount() const;
+    int columnCount() const;
+
+    const char *constData() const;
+    int size() const;
+    QByteArray buffer() const;
+    const char *value(int row, int column) const;
+    const char *columnData(int column) const;
+    int columnStride(int column) const;
+    QByteArray heap() const;
+
+    qint32 int32Value(int row, int column) const;
+    qint64 int64Value(int row, int column) const;
+    double doubleValue(int row, int column) const;
+    QByteArray bytesValue(int row, int column) const;
+
+    void setInt32Value(int row, int column, qint32 value);
+    void setInt64Value(int row, int column, qint64 value);
+    void setDoubleValue(int row, int column, double value);
+    void setBytesValue(int row, int column, const QByteArray &value);
+
+    void reserveHeap(int size);
+
+private:
+    int offset(int row, int column) const;
+    char *valueForWrite(int row, int column);
+
+private:
+    QSharedDataPointer<DataBatchData> d;
+};
+
+} // namespace PluginLoader
+
+#endif // PLUGINLOADER_DATABATCH_H
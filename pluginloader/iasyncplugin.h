@@ -0,0 +1,42 @@
+#ifndef PLUGINLOADER_IASYNCPLUGIN_H
+#define PLUGINLOADER_IASYNCPLUGIN_H
+
+#include <QtCore/QtPlugin>
+
+#include <utils/future.h>
+
+#include "pluginloader_global.h"
+
+namespace PluginLoader {
+
+/*!
+    \brief The API of plugins initializing in the background.
+
+    A plugin with slow initialization, e.g. reading large files or waiting
+    for the network, implements IAsyncPlugin next to IPlugin and lists both
+    in Q_INTERFACES(). PluginManager::initializePluginsAsync() then calls
+    initializeAsync() instead of IPlugin::initialize(), and keeps the event
+    loop running until the returned future finishes. The plugins depending
+    on it are initialized after that.
+ */
+class PLUGINLOADER_EXPORT IAsyncPlugin
+{
+public:
+    virtual ~IAsyncPlugin() {}
+
+    /*!
+        Starts the initialization, usually by running the work on
+        Utils::Executor::workerPool() or Utils::Executor::ioPool(). It's
+        called in the GUI thread and must return without waiting.
+        \return the future telling whether the plugin was successfully
+        initialized, its error string is reported when it failed
+     */
+    virtual Utils::Future<bool> initializeAsync() = 0;
+};
+
+} // namespace PluginLoader
+
+Q_DECLARE_INTERFACE(PluginLoader::IAsyncPlugin,
+        "cn.oscoder.QDataServer.IAsyncPlugin/1.0");
+
+#endif // PLUGINLOADER_IASYNCPLUGIN_H
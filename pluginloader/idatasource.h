@@ -0,0 +1,70 @@
+#ifndef PLUGINLOADER_IDATASOURCE_H
+#define PLUGINLOADER_IDATASOURCE_H
+
+#include <QtCore/QtPlugin>
+
+#include "databatch.h"
+#include "pluginloader_global.h"
+
+namespace PluginLoader {
+
+/*!
+    \brief Receiver of the records produced by an IDataSource.
+
+    The batches are delivered by reference to a shared buffer, a sink that
+    needs the records after consume() returned keeps a copy of the batch,
+    which costs no copy of the records.
+ */
+class PLUGINLOADER_EXPORT IDataSink
+{
+public:
+    virtual ~IDataSink() {}
+
+    /*!
+        Called for each batch of records in the order they were produced.
+        \return false to stop the delivery, the source then finishes fetch()
+        without sending further batches
+     */
+    virtual bool consume(const DataBatch &batch) = 0;
+};
+
+/*!
+    \brief The API of plugins serving data.
+
+    A plugin serving data implements IDataSource next to IPlugin and lists
+    both in Q_INTERFACES(). The running sources are available through
+    PluginManager::dataSources(). Records are delivered in batches, so the
+    cost of a call is shared by many records.
+ */
+class PLUGINLOADER_EXPORT IDataSource
+{
+public:
+    virtual ~IDataSource() {}
+
+    /*!
+        \return the name clients use to address the source, unique among the
+        loaded plugins
+     */
+    virtual QString sourceName() const = 0;
+    /*!
+        \return the schema of the records fetch() delivers for \a request
+     */
+    virtual DataSchema schema(const QByteArray &request) const = 0;
+    /*!
+        Produces the records answering \a request and passes them to \a sink
+        before returning. The method is called from several threads at
+        once, thus implementations must be thread-safe.
+        \param errorString possible error message
+        \return true if the request was answered completely or the sink
+        stopped the delivery
+     */
+    virtual bool fetch(const QByteArray &request, IDataSink *sink,
+            QString *errorString = 0) = 0;
+};
+
+} // namespace PluginLoader
+
+Q_DECLARE_INTERFACE(PluginLoader::IDataSource,
+        "cn.oscoder.QDataServer.IDataSource/1.0");
+
+#endif // PLUGINLOADER_IDATASOURCE_H
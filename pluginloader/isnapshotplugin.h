@@ -0,0 +1,71 @@
+#ifndef PLUGINLOADER_ISNAPSHOTPLUGIN_H
+#define PLUGINLOADER_ISNAPSHOTPLUGIN_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QtPlugin>
+
+#include "pluginloader_global.h"
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+namespace PluginLoader {
+
+/*!
+    \brief The API of plugins restarting from a snapshot of their state.
+
+    A plugin whose initialization rebuilds large in-memory structures
+    implements ISnapshotPlugin next to IPlugin and lists both in
+    Q_INTERFACES(). The PluginManager calls saveSnapshot() right before
+    IPlugin::shutdown() and stores the snapshot in
+    PluginManager::snapshotDirectory(). On the next start it calls
+    restoreSnapshot() right before IPlugin::initialize() if the snapshot was
+    written by the same snapshotVersion() from the same snapshotInputs(),
+    so initialize() can skip the rebuild. A snapshot is dropped when it
+    doesn't match, its restore fails or the plugin fails to initialize.
+ */
+class PLUGINLOADER_EXPORT ISnapshotPlugin
+{
+public:
+    virtual ~ISnapshotPlugin() {}
+
+    /*!
+        \return the version of the snapshot layout, to be increased whenever
+        the layout changes
+     */
+    virtual int snapshotVersion() const = 0;
+    /*!
+        \return a fingerprint of the data the state is built from, e.g. the
+        names, sizes and modification times of the input files. Called
+        before initialize(), thus it must not depend on the state.
+     */
+    virtual QByteArray snapshotInputs() const = 0;
+    /*!
+        Writes the state to \a device. Data meant to be used in place after
+        a restore should be aligned, the snapshot starts at a 64 byte
+        boundary of the file.
+        \param errorString possible error message
+        \return true if the snapshot is complete
+     */
+    virtual bool saveSnapshot(QIODevice *device,
+            QString *errorString = 0) = 0;
+    /*!
+        Restores the state from the \a size bytes at \a data, which is the
+        snapshot file mapped into memory read-only. The mapping stays valid
+        until the plugin is unloaded, so the state may point into it instead
+        of copying it.
+        \param errorString possible error message
+        \return true if the state was restored, otherwise initialize() has
+        to build it
+     */
+    virtual bool restoreSnapshot(const uchar *data, qint64 size,
+            QString *errorString = 0) = 0;
+};
+
+} // namespace PluginLoader
+
+Q_DECLARE_INTERFACE(PluginLoader::ISnapshotPlugin,
+        "cn.oscoder.QDataServer.ISnapshotPlugin/1.0");
+
+#endif // PLUGINLOADER_ISNAPSHOTPLUGIN_H
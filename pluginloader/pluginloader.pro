@@ -1,19 +1,30 @@
 HEADERS += \
+    databatch.h \
+    iasyncplugin.h \
+    idatasource.h \
     iplugin.h \
+    isnapshotplugin.h \
     plugindialog.h \
     pluginloader_global.h \
     pluginmanager.h \
     pluginmanager_p.h \
+    pluginmodel.h \
     pluginspec.h \
     pluginspec_p.h \
+    plugintimeline.h \
     pluginview.h \
-    pluginview_p.h
+    pluginview_p.h \
+    snapshotstore.h
 
 SOURCES += \
+    databatch.cpp \
     plugindialog.cpp \
     pluginmanager.cpp \
+    pluginmodel.cpp \
     pluginspec.cpp \
-    pluginview.cpp
+    plugintimeline.cpp \
+    pluginview.cpp \
+    snapshotstore.cpp
 
 FORMS += \
     pluginview.ui
@@ -2,12 +2,19 @@
 #include "pluginmanager_p.h"
 
 #include <QtCore/QDir>
+#include <QtCore/QPluginLoader>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QSettings>
+#include <QtCore/QtConcurrentRun>
 #include <QtGui/QApplication>
 
+#include <utils/filehelper.h>
 #include <utils/iprogressmonitor.h>
+#include <utils/taskscheduler.h>
 
+#include "idatasource.h"
 #include "iplugin.h"
 #include "pluginspec.h"
 
@@ -17,6 +24,50 @@ enum {
     debugPluginManager = 0
 };
 
+namespace {
+    // Weight of the last run in the stored durations (in percent)
+    const int HISTORY_WEIGHT = 25;
+    // A duration is reported as regression when it exceeds its history
+    // by this factor and by at least REGRESSION_MIN_DELAY milliseconds
+    const int REGRESSION_FACTOR = 3;
+    const int REGRESSION_MIN_DELAY = 50;
+    // Expected initialization time of a plugin without history, used when
+    // no other plugin has history either
+    const int DEFAULT_INITIALIZATION_TIME = 10;
+
+    // Maps the library of a plugin into memory, so that creating the plugin
+    // on the GUI thread only resolves the instance. Measures the load, which
+    // is part of the loading time of the plugin.
+    class LibraryLoadTask : public Utils::Task
+    {
+    public:
+        LibraryLoadTask(QPluginLoader *loader, qint64 *elapsed)
+            : m_loader(loader), m_elapsed(elapsed) {}
+        void run()
+        {
+            QElapsedTimer timer;
+            timer.start();
+            m_loader->load();
+            *m_elapsed = timer.elapsed();
+        }
+
+    private:
+        QPluginLoader *const m_loader;
+        qint64 *const m_elapsed;
+    };
+
+    // Continuation of all library loads
+    class LibraryJoinTask : public Utils::Task
+    {
+    public:
+        LibraryJoinTask(QSemaphore *finished) : m_finished(finished) {}
+        void run() { m_finished->release(); }
+
+    private:
+        QSemaphore *const m_finished;
+    };
+}
+
 PluginManager::PluginManager()
     : d_ptr(new PluginManagerPrivate(this))
 {
@@ -55,11 +106,28 @@ QStringList PluginManager::getPluginPaths()
     return QStringList() << searchPath;
 }
 
+/*!
+    Starts searching the given \a paths for plugin description files and
+    reading them in another thread. A following loadPlugins() with the same
+    \a paths waits for the result instead of searching again, so the search
+    overlaps with whatever the application does in the meantime.
+    \param paths the list of paths where to search for plugins
+ */
+void PluginManager::prefetchPluginSpecs(const QStringList &paths)
+{
+    Q_D(PluginManager);
+    d->prefetchPluginSpecs(paths);
+}
+
 /*!
     Searches all the given \a paths for valid application's plugins. Once the
     dependencies among plugins are resolved the plugins are loaded in found
-    order.
+    order. The libraries are loaded by the threads of
+    Utils::TaskScheduler::globalInstance(), so static initializers of plugins
+    run there; static QObjects of a plugin belong to such a thread. The
+    plugins themselves are created in the calling thread.
     \param paths the list of paths where to search for plugins
+    \sa prefetchPluginSpecs()
  */
 void PluginManager::loadPlugins(const QStringList &paths)
 {
@@ -78,7 +146,25 @@ QList<IPlugin *> PluginManager::plugins() const
 }
 
 /*!
-    Tries to initialize all loaded plugins.
+    Returns the loaded plugins implementing IDataSource.
+    \sa IDataSource::sourceName()
+ */
+QList<IDataSource *> PluginManager::dataSources() const
+{
+    Q_D(const PluginManager);
+    QList<IDataSource *> sources;
+    foreach (IPlugin *plugin, d->plugins()) {
+        QObject *object = dynamic_cast<QObject *>(plugin);
+        if (IDataSource *source = qobject_cast<IDataSource *>(object))
+            sources.append(source);
+    }
+    return sources;
+}
+
+/*!
+    Tries to initialize all loaded plugins. The progress reported to \a
+    monitor is weighted by the initialization times measured in previous runs
+    of the application.
     \return true if all loaded plugins were successfully initialized
     \sa IPlugin::initialize()
  */
@@ -88,6 +174,25 @@ bool PluginManager::initializePlugins(Utils::IProgressMonitor *monitor)
     return d->initializePlugins(monitor);
 }
 
+/*!
+    Initializes the loaded plugins like initializePlugins(), but plugins
+    implementing IAsyncPlugin are initialized without blocking the event
+    loop. The plugins are still initialized in the order of their
+    dependencies, the rest continues in the GUI thread once a plugin
+    initializing asynchronously finished. Thus the event loop must run and
+    \a monitor must exist until the returned future finished. Canceling the
+    future stops the initialization after the running plugin.
+    \return the future telling whether all loaded plugins were successfully
+    initialized
+    \sa IAsyncPlugin::initializeAsync()
+ */
+Utils::Future<bool> PluginManager::initializePluginsAsync(
+        Utils::IProgressMonitor *monitor)
+{
+    Q_D(PluginManager);
+    return d->initializePluginsAsync(monitor);
+}
+
 /*!
     In case some plugin initialization failed and the reason is too critical,
     plugin may request application shutdown.
@@ -118,6 +223,35 @@ void PluginManager::unloadPlugins()
     return d->unloadPlugins(queue);
 }
 
+/*!
+    Sets the \a directory keeping the snapshots of the plugins implementing
+    ISnapshotPlugin. By default they are kept in the cache location of the
+    application, the \c Snapshots.Directory setting overrides it.
+ */
+void PluginManager::setSnapshotDirectory(const QString &directory)
+{
+    Q_D(PluginManager);
+    d->m_snapshots.setDirectory(directory);
+}
+
+QString PluginManager::snapshotDirectory() const
+{
+    Q_D(const PluginManager);
+    return d->m_snapshots.directory();
+}
+
+/*!
+    Removes the snapshots of all plugins, e.g. after their inputs changed in
+    a way the plugins can't detect. The next start builds the state of the
+    plugins again.
+    \sa ISnapshotPlugin
+ */
+void PluginManager::invalidateSnapshots()
+{
+    Q_D(PluginManager);
+    d->m_snapshots.invalidateAll();
+}
+
 /*!
     Returns the list of plugin specifications for successfully loaded plugins.
     The specification is taken from plugin's description file.
@@ -153,9 +287,42 @@ bool PluginManager::isPluginLoaded(const QString &pluginName) const
     return false;
 }
 
+/*!
+    Takes a snapshot of the plugin manager's metrics. The map contains the
+    uptime of the plugin manager, the number of plugins in each state and the
+    total time spent loading and initializing plugins (all times are in
+    milliseconds). \c plugins.startupRegressions counts the plugins whose
+    loading or initialization was much slower than in previous runs, see
+    startupRegressionDetected(). The counters of resultCache() are included
+    with the \c cache. prefix.
+    \return the metrics snapshot
+ */
+QVariantMap PluginManager::metrics() const
+{
+    Q_D(const PluginManager);
+    return d->metrics();
+}
+
+/*!
+    Returns the cache plugins share for their results instead of keeping own
+    caches. Each plugin stores its entries in the namespace of its name. The
+    budget of the cache is read from the \c PluginManager/ResultCache.Budget
+    setting, the quotas of the plugins from \c ResultCache.Quotas mapping
+    plugin names to bytes.
+    \return the cache, thread-safe
+ */
+Utils::ResultCache *PluginManager::resultCache() const
+{
+    Q_D(const PluginManager);
+    return d->resultCache();
+}
+
 PluginManagerPrivate::PluginManagerPrivate(PluginManager *q)
-    : q_ptr(q)
+    : q_ptr(q),
+    m_prefetchPending(false),
+    m_startupRegressions(0)
 {
+    m_uptime.start();
 }
 
 PluginManagerPrivate::~PluginManagerPrivate()
@@ -170,6 +337,21 @@ PluginManagerPrivate::~PluginManagerPrivate()
     }
     qDeleteAll(m_pluginToSpec);
     m_pluginToSpec.clear();
+
+    if (m_prefetchPending)
+        qDeleteAll(m_prefetchedSpecs.result());
+}
+
+void PluginManagerPrivate::prefetchPluginSpecs(const QStringList &paths)
+{
+    if (m_prefetchPending) {
+        // Only the last prefetch is used
+        qDeleteAll(m_prefetchedSpecs.result());
+    }
+    m_prefetchPending = true;
+    m_prefetchedPaths = paths;
+    m_prefetchedSpecs = QtConcurrent::run(&PluginManagerPrivate::findPluginSpecs,
+            paths, QThread::currentThread());
 }
 
 void PluginManagerPrivate::loadPlugins(const QStringList &paths)
@@ -181,13 +363,51 @@ void PluginManagerPrivate::loadPlugins(const QStringList &paths)
     resolveDependencies();
     QList<PluginSpec *> pluginLoadQueue = loadQueue();
 
+    // The libraries are mapped in parallel, the plugins are still created
+    // on this thread in the order of their dependencies
+    QList<QPluginLoader *> preloaders;
+    // Written by the load tasks, read after they all finished
+    QHash<PluginSpec *, qint64> preloadTimes;
+    foreach (PluginSpec *pluginSpec, pluginLoadQueue)
+        preloadTimes.insert(pluginSpec, 0);
+    QSemaphore librariesLoaded;
+    Utils::TaskScheduler *const scheduler =
+        Utils::TaskScheduler::globalInstance();
+    LibraryJoinTask *const join = new LibraryJoinTask(&librariesLoaded);
+    QList<LibraryLoadTask *> loadTasks;
+    foreach (PluginSpec *pluginSpec, pluginLoadQueue) {
+        if (pluginSpec->state() != PluginSpec::Resolved)
+            continue;
+        QPluginLoader *const preloader = new QPluginLoader(
+                Utils::FileHelper::buildPluginName(pluginSpec->filePath(),
+                    pluginSpec->name()));
+        preloaders.append(preloader);
+        LibraryLoadTask *const task = new LibraryLoadTask(preloader,
+                &preloadTimes[pluginSpec]);
+        task->then(join);
+        loadTasks.append(task);
+    }
+    foreach (LibraryLoadTask *task, loadTasks)
+        scheduler->start(task);
+    scheduler->start(join);
+    librariesLoaded.acquire();
+
     foreach (PluginSpec *pluginSpec, pluginLoadQueue) {
         IPlugin *plugin = pluginSpec->loadPlugin();
+        // Same measure as before the libraries were preloaded
+        recordDuration(pluginSpec, LoadStep, preloadTimes.value(pluginSpec)
+                + pluginSpec->statistics().loadTime);
         if (plugin != 0) {
             m_pluginToSpec.remove(0, pluginSpec);
             m_pluginToSpec.insert(plugin, pluginSpec);
         }
     }
+
+    // The loaders of the plugins keep their libraries loaded
+    foreach (QPluginLoader *preloader, preloaders) {
+        preloader->unload();
+        delete preloader;
+    }
 }
 
 QList<IPlugin *> PluginManagerPrivate::plugins() const
@@ -201,42 +421,179 @@ QList<IPlugin *> PluginManagerPrivate::plugins() const
 bool PluginManagerPrivate::initializePlugins(Utils::IProgressMonitor *monitor)
 {
     Q_Q(PluginManager);
-    QList<PluginSpec *> pluginLoadQueue = loadQueue();
-    bool allInitialized = true;
-    pluginWhichRequestedShutdown.clear();
-    foreach (PluginSpec *pluginSpec, pluginLoadQueue) {
+    beginInitialization(monitor);
+
+    while (!m_initialization.queue.isEmpty()) {
+        PluginSpec *pluginSpec = m_initialization.queue.takeFirst();
         if (pluginSpec->state() == PluginSpec::Loaded) {
             monitor->setStatus(pluginSpec->name());
-            bool initialized = pluginSpec->initializePlugin();
-            if (!initialized) {
-                allInitialized = false;
-
-                // unload dependent plugins
-                QList<PluginSpec *> queue;
-                QList<PluginSpec *> circularity;
-                //shutdown requested, unload all plugins and terminate app
-                if (pluginSpec->plugin()->isShutdownRequested()) {
-                    pluginWhichRequestedShutdown = pluginSpec->name();
-                    return false;
-                }
-                else {
-                    pluginSpec->unloadQueue(queue, circularity);
-                    unloadPlugins(queue);
-                    // update 'IndirectlyDisabled' state of dependent plugins
-                    pluginSpec->resolveIndirectlyDisabled(true);
-                }
+            m_snapshots.restore(pluginSpec);
+            if (!pluginInitialized(pluginSpec, pluginSpec->initializePlugin()))
+                return false;
+        }
+    }
+    emit q->pluginsInitialized();
+    return m_initialization.allInitialized;
+}
+
+Utils::Future<bool> PluginManagerPrivate::initializePluginsAsync(
+        Utils::IProgressMonitor *monitor)
+{
+    if (m_initialization.current != 0) {
+        qWarning("%s: initialization is running already", Q_FUNC_INFO);
+        return Utils::Future<bool>();
+    }
+
+    beginInitialization(monitor);
+    m_initialization.promise = Utils::Promise<bool>();
+    const Utils::Future<bool> future = m_initialization.promise.future();
+    initializeNextPlugins();
+    return future;
+}
+
+// Prepares the queue and the progress of initializePlugins()
+void PluginManagerPrivate::beginInitialization(
+        Utils::IProgressMonitor *monitor)
+{
+    m_initialization.queue = loadQueue();
+    m_initialization.monitor = monitor;
+    m_initialization.allInitialized = true;
+    m_initialization.current = 0;
+    pluginWhichRequestedShutdown.clear();
+
+    // Plugins without history are expected to take the average time of
+    // the plugins with history
+    qint64 knownTime = 0;
+    int knownCount = 0;
+    foreach (PluginSpec *pluginSpec, m_initialization.queue) {
+        const qint64 time = expectedInitializationTime(pluginSpec, -1);
+        if (pluginSpec->state() == PluginSpec::Loaded && time >= 0) {
+            knownTime += time;
+            ++knownCount;
+        }
+    }
+    const qint64 defaultTime = knownCount > 0
+        ? knownTime / knownCount : DEFAULT_INITIALIZATION_TIME;
+
+    m_initialization.expectedTimes.clear();
+    qint64 remaining = 0;
+    foreach (PluginSpec *pluginSpec, m_initialization.queue) {
+        if (pluginSpec->state() == PluginSpec::Loaded) {
+            // Every plugin counts, even if it was instant so far
+            const qint64 time = qMax(
+                    expectedInitializationTime(pluginSpec, defaultTime),
+                    qint64(1));
+            m_initialization.expectedTimes.insert(pluginSpec, time);
+            remaining += time;
+        }
+    }
+    m_initialization.total = remaining;
+    m_initialization.remaining = remaining;
+    monitor->setProgress(0, int(remaining));
+    monitor->setRemainingTime(remaining);
+}
+
+/*
+    Records the initialization of the plugin and unloads the plugins
+    depending on it if it failed. Returns false if the plugin requested to
+    shut down the application.
+*/
+bool PluginManagerPrivate::pluginInitialized(PluginSpec *pluginSpec,
+        bool initialized)
+{
+    Utils::IProgressMonitor *const monitor = m_initialization.monitor;
+    recordDuration(pluginSpec, InitializationStep,
+            pluginSpec->statistics().initializationTime);
+    m_initialization.remaining -=
+        m_initialization.expectedTimes.take(pluginSpec);
+    if (!initialized) {
+        m_initialization.allInitialized = false;
+        // The snapshot may be what the plugin failed on
+        m_snapshots.invalidate(pluginSpec);
+
+        // unload dependent plugins
+        QList<PluginSpec *> queue;
+        QList<PluginSpec *> circularity;
+        //shutdown requested, unload all plugins and terminate app
+        if (pluginSpec->plugin()->isShutdownRequested()) {
+            pluginWhichRequestedShutdown = pluginSpec->name();
+            return false;
+        }
+        else {
+            pluginSpec->unloadQueue(queue, circularity);
+            unloadPlugins(queue);
+            // The unloaded plugins are not going to be initialized
+            foreach (PluginSpec *unloaded, queue) {
+                m_initialization.remaining -=
+                    m_initialization.expectedTimes.take(unloaded);
             }
+            // update 'IndirectlyDisabled' state of dependent plugins
+            pluginSpec->resolveIndirectlyDisabled(true);
+        }
+    }
+    monitor->setProgress(int(m_initialization.total
+                - m_initialization.remaining), int(m_initialization.total));
+    monitor->setRemainingTime(m_initialization.remaining);
+    return true;
+}
+
+/*
+    Initializes the plugins of the queue up to the next one initializing
+    asynchronously, the rest continues once it finished.
+*/
+void PluginManagerPrivate::initializeNextPlugins()
+{
+    Q_Q(PluginManager);
+    Utils::Promise<bool> &promise = m_initialization.promise;
+
+    while (!m_initialization.queue.isEmpty()) {
+        if (promise.isCanceled())
+            return;
+        PluginSpec *pluginSpec = m_initialization.queue.takeFirst();
+        if (pluginSpec->state() != PluginSpec::Loaded)
+            continue;
+
+        m_initialization.monitor->setStatus(pluginSpec->name());
+        m_snapshots.restore(pluginSpec);
+        const Utils::Future<bool> initialized =
+            pluginSpec->initializePluginAsync();
+        if (!initialized.isFinished()) {
+            m_initialization.current = pluginSpec;
+            initialized.then(this,
+                    &PluginManagerPrivate::asyncPluginInitialized,
+                    Utils::Executor::guiThread());
+            return;
+        }
+        if (!pluginInitialized(pluginSpec, initialized.result())) {
+            promise.setResult(false);
+            return;
         }
     }
     emit q->pluginsInitialized();
-    return allInitialized;
+    promise.setResult(m_initialization.allInitialized);
+}
+
+bool PluginManagerPrivate::asyncPluginInitialized(
+        const Utils::Future<bool> &initialized)
+{
+    PluginSpec *pluginSpec = m_initialization.current;
+    m_initialization.current = 0;
+    if (!pluginInitialized(pluginSpec, initialized.result())) {
+        m_initialization.promise.setResult(false);
+        return false;
+    }
+    initializeNextPlugins();
+    return true;
 }
 
 void PluginManagerPrivate::unloadPlugins(QList<PluginSpec *> unloadQueue)
 {
     foreach (PluginSpec *pluginSpec, unloadQueue) {
         m_pluginToSpec.remove(pluginSpec->plugin(), pluginSpec);
+        if (pluginSpec->state() == PluginSpec::Initialized)
+            m_snapshots.save(pluginSpec);
         pluginSpec->unloadPlugin();
+        m_snapshots.release(pluginSpec);
         m_pluginToSpec.insert(0, pluginSpec);
     }
 }
@@ -252,6 +609,97 @@ PluginSpec *PluginManagerPrivate::pluginSpec(IPlugin *plugin) const
     return m_pluginToSpec.value(plugin);
 }
 
+QVariantMap PluginManagerPrivate::metrics() const
+{
+    int loaded = 0;
+    int initialized = 0;
+    int failed = 0;
+    qint64 loadTime = 0;
+    qint64 initializationTime = 0;
+
+    foreach (PluginSpec *pluginSpec, m_pluginToSpec) {
+        if (pluginSpec->state() >= PluginSpec::Loaded)
+            ++loaded;
+        if (pluginSpec->state() == PluginSpec::Initialized)
+            ++initialized;
+        if (pluginSpec->hasError())
+            ++failed;
+
+        const PluginStatistics statistics = pluginSpec->statistics();
+        if (statistics.loadTime > 0)
+            loadTime += statistics.loadTime;
+        if (statistics.initializationTime > 0)
+            initializationTime += statistics.initializationTime;
+    }
+
+    QVariantMap metrics;
+    metrics.insert(QLatin1String("uptime"), m_uptime.elapsed());
+    metrics.insert(QLatin1String("plugins.total"), m_pluginToSpec.size());
+    metrics.insert(QLatin1String("plugins.loaded"), loaded);
+    metrics.insert(QLatin1String("plugins.initialized"), initialized);
+    metrics.insert(QLatin1String("plugins.failed"), failed);
+    metrics.insert(QLatin1String("plugins.loadTime"), loadTime);
+    metrics.insert(QLatin1String("plugins.initializationTime"),
+            initializationTime);
+    metrics.insert(QLatin1String("plugins.startupRegressions"),
+            m_startupRegressions);
+
+    const QVariantMap cacheMetrics = m_resultCache.metrics();
+    QVariantMap::const_iterator it = cacheMetrics.constBegin();
+    for (; it != cacheMetrics.constEnd(); ++it)
+        metrics.insert(it.key(), it.value());
+    return metrics;
+}
+
+Utils::ResultCache *PluginManagerPrivate::resultCache() const
+{
+    return &m_resultCache;
+}
+
+qint64 PluginManagerPrivate::expectedInitializationTime(
+        PluginSpec *pluginSpec, qint64 defaultTime) const
+{
+    const qint64 time =
+        m_startupHistory.value(pluginSpec->name()).initializationTime;
+    return time >= 0 ? time : defaultTime;
+}
+
+/*!
+    Compares \a duration of the \a step with the history of the plugin,
+    reports a strong deviation and adds the duration to the history.
+ */
+void PluginManagerPrivate::recordDuration(PluginSpec *pluginSpec,
+        StartupStep step, qint64 duration)
+{
+    Q_Q(PluginManager);
+
+    if (duration < 0)
+        return;
+
+    StartupHistory &history = m_startupHistory[pluginSpec->name()];
+    qint64 &expected = step == LoadStep
+        ? history.loadTime : history.initializationTime;
+
+    if (expected < 0) {
+        expected = duration;
+        return;
+    }
+
+    if (duration > expected * REGRESSION_FACTOR
+            && duration > expected + REGRESSION_MIN_DELAY) {
+        qWarning("%s: %s of plugin '%s' took %lld ms, %lld ms expected",
+                Q_FUNC_INFO,
+                step == LoadStep ? "Loading" : "Initialization",
+                qPrintable(pluginSpec->name()), duration, expected);
+        ++m_startupRegressions;
+        emit q->startupRegressionDetected(pluginSpec->name(), expected,
+                duration);
+    }
+
+    expected = (expected * (100 - HISTORY_WEIGHT)
+            + duration * HISTORY_WEIGHT) / 100;
+}
+
 void PluginManagerPrivate::restoreSettings()
 {
     QSettings settings;
@@ -260,6 +708,36 @@ void PluginManagerPrivate::restoreSettings()
     m_disabledPlugins = settings.value(
             QLatin1String("PluginSpec.DisabledPlugins")).toStringList();
 
+    // name -> [load time, initialization time]
+    const QVariantMap history = settings.value(
+            QLatin1String("PluginSpec.StartupHistory")).toMap();
+    QVariantMap::const_iterator it = history.constBegin();
+    for (; it != history.constEnd(); ++it) {
+        const QVariantList durations = it.value().toList();
+        if (durations.size() != 2)
+            continue;
+        StartupHistory entry;
+        entry.loadTime = durations.at(0).toLongLong();
+        entry.initializationTime = durations.at(1).toLongLong();
+        m_startupHistory.insert(it.key(), entry);
+    }
+
+    const qint64 cacheBudget = settings.value(
+            QLatin1String("ResultCache.Budget")).toLongLong();
+    if (cacheBudget > 0)
+        m_resultCache.setBudget(cacheBudget);
+    // name -> quota in bytes
+    const QVariantMap quotas = settings.value(
+            QLatin1String("ResultCache.Quotas")).toMap();
+    for (it = quotas.constBegin(); it != quotas.constEnd(); ++it)
+        m_resultCache.setQuota(Utils::UniqueId(it.key()),
+                it.value().toLongLong());
+
+    const QString snapshotDirectory = settings.value(
+            QLatin1String("Snapshots.Directory")).toString();
+    if (!snapshotDirectory.isEmpty())
+        m_snapshots.setDirectory(snapshotDirectory);
+
     settings.endGroup(); // PluginManager
     if (debugPluginManager) {
         qDebug("PluginManager: Settings restored");
@@ -284,6 +762,15 @@ void PluginManagerPrivate::saveSettings()
     settings.setValue(
             QLatin1String("PluginSpec.DisabledPlugins"), tempDisabledPlugins);
 
+    QVariantMap history;
+    QHash<QString, StartupHistory>::const_iterator it =
+        m_startupHistory.constBegin();
+    for (; it != m_startupHistory.constEnd(); ++it) {
+        history.insert(it.key(), QVariantList()
+                << it.value().loadTime << it.value().initializationTime);
+    }
+    settings.setValue(QLatin1String("PluginSpec.StartupHistory"), history);
+
     settings.endGroup(); // PluginManager
     if (debugPluginManager) {
         qDebug("PluginManager: Settings saved");
@@ -295,6 +782,34 @@ void PluginManagerPrivate::readPluginSpecs(const QStringList &paths)
     qDeleteAll(m_pluginToSpec);
     m_pluginToSpec.clear();
 
+    QList<PluginSpec *> pluginSpecs;
+    if (m_prefetchPending) {
+        pluginSpecs = m_prefetchedSpecs.result();
+        m_prefetchedSpecs = QFuture<QList<PluginSpec *> >();
+        m_prefetchPending = false;
+        if (paths != m_prefetchedPaths) {
+            qDeleteAll(pluginSpecs);
+            pluginSpecs = findPluginSpecs(paths, QThread::currentThread());
+        }
+    }
+    else {
+        pluginSpecs = findPluginSpecs(paths, QThread::currentThread());
+    }
+
+    foreach (PluginSpec *pluginSpec, pluginSpecs) {
+        m_pluginToSpec.insert(0, pluginSpec);
+    }
+}
+
+/*!
+    Searches \a paths recursively for plugin description files and reads
+    them. Touches no member, so it may run in any thread; the specs are moved
+    to \a targetThread.
+    \return the specs read successfully
+ */
+QList<PluginSpec *> PluginManagerPrivate::findPluginSpecs(
+        const QStringList &paths, QThread *targetThread)
+{
     QStringList specFileNames;
     QStringList searchPaths = paths;
 
@@ -315,12 +830,18 @@ void PluginManagerPrivate::readPluginSpecs(const QStringList &paths)
         }
     }
 
+    QList<PluginSpec *> pluginSpecs;
     foreach (const QString &specFileName, specFileNames) {
         PluginSpec *pluginSpec = new PluginSpec();
         if (pluginSpec->read(specFileName)) {
-            m_pluginToSpec.insert(0, pluginSpec);
+            pluginSpec->moveToThread(targetThread);
+            pluginSpecs.append(pluginSpec);
+        }
+        else {
+            delete pluginSpec;
         }
     }
+    return pluginSpecs;
 }
 
 void PluginManagerPrivate::resolveDependencies()
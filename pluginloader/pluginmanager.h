@@ -3,14 +3,19 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QStringList>
+#include <QtCore/QVariantMap>
+
+#include <utils/future.h>
 
 #include "pluginloader_global.h"
 
 namespace Utils {
     class IProgressMonitor;
+    class ResultCache;
 }
 namespace PluginLoader {
 
+class IDataSource;
 class IPlugin;
 class PluginSpec;
 
@@ -37,10 +42,14 @@ public:
     static PluginManager *instance();
     static QStringList getPluginPaths();
 
+    void prefetchPluginSpecs(const QStringList &paths);
     void loadPlugins(const QStringList &paths);
     QList<IPlugin *> plugins() const;
+    QList<IDataSource *> dataSources() const;
 
     bool initializePlugins(Utils::IProgressMonitor *monitor);
+    Utils::Future<bool> initializePluginsAsync(
+            Utils::IProgressMonitor *monitor);
     bool isShutdownRequested(QString *pluginName = 0);
 
     void unloadPlugins();
@@ -50,9 +59,24 @@ public:
 
     bool isPluginLoaded(const QString &pluginName) const;
 
+    QVariantMap metrics() const;
+    Utils::ResultCache *resultCache() const;
+
+    void setSnapshotDirectory(const QString &directory);
+    QString snapshotDirectory() const;
+    void invalidateSnapshots();
+
 signals:
     //! Emitted after all plugins were successfully initialized.
     void pluginsInitialized();
+    /*!
+        Emitted when loading or initializing the plugin \a pluginName took
+        much longer than in previous runs of the application.
+        \param expected the duration expected from history in milliseconds
+        \param actual the measured duration in milliseconds
+     */
+    void startupRegressionDetected(const QString &pluginName,
+            qint64 expected, qint64 actual);
 
 private:
     Q_DECLARE_PRIVATE(PluginManager)
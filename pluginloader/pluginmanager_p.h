@@ -2,10 +2,21 @@
 #define PLUGINMANAGER_P_H
 /*! \cond __pimpl */
 
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
 #include <QtCore/QMap>
 #include <QtCore/QStringList>
 
+#include <utils/future.h>
+#include <utils/resultcache.h>
+
 #include "pluginmanager.h"
+#include "snapshotstore.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
 
 namespace PluginLoader {
 
@@ -18,21 +29,67 @@ public:
     PluginManagerPrivate(PluginManager *q);
     virtual ~PluginManagerPrivate();
 
+    void prefetchPluginSpecs(const QStringList &paths);
     void loadPlugins(const QStringList &paths);
     QList<IPlugin *> plugins() const;
 
     bool initializePlugins(Utils::IProgressMonitor *splash);
+    Utils::Future<bool> initializePluginsAsync(
+            Utils::IProgressMonitor *monitor);
 
     void unloadPlugins(QList<PluginSpec *> unloadQueue);
 
     QList<PluginSpec *> pluginSpecs() const;
     PluginSpec *pluginSpec(IPlugin *plugin) const;
 
+    QVariantMap metrics() const;
+    Utils::ResultCache *resultCache() const;
+
     void restoreSettings();
     void saveSettings();
 
+private:
+    //! Durations of previous startups in milliseconds, -1 if never measured
+    struct StartupHistory
+    {
+        StartupHistory() : loadTime(-1), initializationTime(-1) {}
+        qint64 loadTime;
+        qint64 initializationTime;
+    };
+
+    enum StartupStep {
+        LoadStep,
+        InitializationStep
+    };
+
+    //! Progress of the running initialization of the plugins
+    struct Initialization
+    {
+        Initialization() : monitor(0), total(0), remaining(0),
+            allInitialized(true), current(0) {}
+        QList<PluginSpec *> queue;
+        QHash<PluginSpec *, qint64> expectedTimes;
+        Utils::IProgressMonitor *monitor;
+        qint64 total;
+        qint64 remaining;
+        bool allInitialized;
+        //! The plugin initialized asynchronously at the moment
+        PluginSpec *current;
+        Utils::Promise<bool> promise;
+    };
+
 private:
     void readPluginSpecs(const QStringList &paths);
+    static QList<PluginSpec *> findPluginSpecs(const QStringList &paths,
+            QThread *targetThread);
+    qint64 expectedInitializationTime(PluginSpec *pluginSpec,
+            qint64 defaultTime) const;
+    void recordDuration(PluginSpec *pluginSpec, StartupStep step,
+            qint64 duration);
+    void beginInitialization(Utils::IProgressMonitor *monitor);
+    bool pluginInitialized(PluginSpec *pluginSpec, bool initialized);
+    void initializeNextPlugins();
+    bool asyncPluginInitialized(const Utils::Future<bool> &initialized);
     void resolveDependencies();
     QList<PluginSpec *> loadQueue();
     QList<PluginSpec *> unloadQueue();
@@ -44,6 +101,17 @@ private:
     QMultiMap<IPlugin *, PluginSpec *> m_pluginToSpec;
     QStringList m_disabledPlugins;
     QString pluginWhichRequestedShutdown;
+    QElapsedTimer m_uptime;
+    QHash<QString, StartupHistory> m_startupHistory;
+    QFuture<QList<PluginSpec *> > m_prefetchedSpecs;
+    //! A default QFuture counts as started in Qt 4, thus tracked here
+    bool m_prefetchPending;
+    QStringList m_prefetchedPaths;
+    int m_startupRegressions;
+    Initialization m_initialization;
+    SnapshotStore m_snapshots;
+    //! Thread-safe, thus handed out by const methods as well
+    mutable Utils::ResultCache m_resultCache;
 };
 
 } // namespace PluginLoader
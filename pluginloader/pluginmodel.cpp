@@ -0,0 +1,428 @@
+#include "pluginmodel.h"
+
+#include <QtCore/QMap>
+#include <QtCore/QStringList>
+
+#include "pluginmanager.h"
+#include "pluginspec.h"
+
+using namespace PluginLoader;
+
+/*!
+    Constructs the model over the plugins currently known to the
+    PluginManager.
+    \param parent the parent object
+ */
+PluginModel::PluginModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    QMap<QString, Category *> categories;
+
+    foreach (PluginSpec *spec, PluginManager::instance()->pluginSpecs()) {
+        SpecState state;
+        state.category = 0;
+        state.enabled = spec->isEnabled();
+        state.indirectlyDisabled = spec->isIndirectlyDisabled();
+
+        const QString name = spec->category();
+        if (name.isEmpty()) {
+            TopLevelItem item = { 0, spec };
+            state.row = m_topLevelItems.size();
+            m_topLevelItems.append(item);
+        }
+        else {
+            Category *category = categories.value(name);
+            if (category == 0) {
+                category = new Category;
+                category->name = name;
+                category->row = m_topLevelItems.size();
+                category->enabledCount = 0;
+                categories.insert(name, category);
+                m_categories.append(category);
+
+                TopLevelItem item = { category, 0 };
+                m_topLevelItems.append(item);
+            }
+            state.category = category;
+            state.row = category->specs.size();
+            category->specs.append(spec);
+            if (state.enabled)
+                ++category->enabledCount;
+        }
+        m_states.insert(spec, state);
+
+        connect(spec, SIGNAL(statisticsChanged()),
+                this, SLOT(updateStatistics()));
+    }
+}
+
+PluginModel::~PluginModel()
+{
+    qDeleteAll(m_categories);
+}
+
+QModelIndex PluginModel::index(int row, int column,
+        const QModelIndex &parent) const
+{
+    if (row < 0 || column < 0 || column >= ColumnCount)
+        return QModelIndex();
+
+    if (!parent.isValid()) {
+        if (row >= m_topLevelItems.size())
+            return QModelIndex();
+        return createIndex(row, column);
+    }
+
+    // Children of categories point to their category
+    if (parent.internalPointer() != 0 || parent.column() != 0)
+        return QModelIndex();
+    Category *category = m_topLevelItems.at(parent.row()).category;
+    if (category == 0 || row >= category->specs.size())
+        return QModelIndex();
+    return createIndex(row, column, category);
+}
+
+QModelIndex PluginModel::parent(const QModelIndex &child) const
+{
+    const Category *category =
+        static_cast<const Category *>(child.internalPointer());
+    if (!child.isValid() || category == 0)
+        return QModelIndex();
+    return createIndex(category->row, 0);
+}
+
+int PluginModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return m_topLevelItems.size();
+    if (parent.internalPointer() != 0 || parent.column() != 0)
+        return 0;
+
+    const Category *category = m_topLevelItems.at(parent.row()).category;
+    return category != 0 ? category->specs.size() : 0;
+}
+
+int PluginModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return ColumnCount;
+}
+
+QVariant PluginModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    const Category *category =
+        static_cast<const Category *>(index.internalPointer());
+    if (category != 0)
+        return specData(category->specs.at(index.row()), index.column(), role);
+
+    const TopLevelItem &item = m_topLevelItems.at(index.row());
+    if (item.category != 0)
+        return categoryData(item.category, index.column(), role);
+    return specData(item.spec, index.column(), role);
+}
+
+bool PluginModel::setData(const QModelIndex &index, const QVariant &value,
+        int role)
+{
+    if (!index.isValid() || index.column() != EnabledColumn
+            || role != Qt::CheckStateRole)
+        return false;
+
+    const bool enabled = value.toInt() != Qt::Unchecked;
+
+    PluginSpec *spec = pluginSpec(index);
+    if (spec != 0) {
+        // User changed enabled flag for single plugin
+        setPluginEnabled(spec, enabled);
+    }
+    else {
+        // User changed enabled flag for whole category
+        const Category *category = m_topLevelItems.at(index.row()).category;
+        foreach (PluginSpec *categorySpec, category->specs)
+            setPluginEnabled(categorySpec, enabled);
+    }
+
+    refresh();
+    emit pluginSettingsChanged();
+    return true;
+}
+
+Qt::ItemFlags PluginModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+
+    PluginSpec *spec = pluginSpec(index);
+    if (spec != 0 && spec->isPersistent())
+        return Qt::ItemIsSelectable;
+
+    Qt::ItemFlags flags = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    if (index.column() == EnabledColumn)
+        flags |= Qt::ItemIsUserCheckable;
+    return flags;
+}
+
+QVariant PluginModel::headerData(int section, Qt::Orientation orientation,
+        int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case NameColumn:
+        return tr("Name", "Name of the plugin");
+    case EnabledColumn:
+        return tr("Enabled", "Checked if plugin is enabled");
+    case IndirectlyDisabledColumn:
+        return tr("Indirectly Disabled",
+                "Checked if this plugin depends on disabled plugin");
+    case VersionColumn:
+        return tr("Version", "Version of plugin");
+    case DescriptionColumn:
+        return tr("Description", "Description of plugin");
+    case DependencyColumn:
+        return tr("Dependency", "This plugin depends on following plugins");
+    case LoadTimeColumn:
+        return tr("Load", "Time spent loading the plugin library");
+    case InitializationTimeColumn:
+        return tr("Initialization", "Time spent initializing the plugin");
+    case ShutdownTimeColumn:
+        return tr("Shutdown", "Time spent shutting down the plugin");
+    case MemoryColumn:
+        return tr("Memory", "Memory allocated while loading the plugin");
+    case ThreadColumn:
+        return tr("Thread", "Thread that initialized the plugin");
+    }
+    return QVariant();
+}
+
+/*!
+    Returns the plugin shown at \a index, or 0 if \a index is a category.
+ */
+PluginSpec *PluginModel::pluginSpec(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+
+    const Category *category =
+        static_cast<const Category *>(index.internalPointer());
+    if (category != 0)
+        return category->specs.at(index.row());
+    return m_topLevelItems.at(index.row()).spec;
+}
+
+/*!
+    Compares the enabled states of all plugins with the states shown and
+    emits dataChanged() for the plugins, and their categories, that differ.
+ */
+void PluginModel::refresh()
+{
+    QList<Category *> changedCategories;
+
+    QHash<PluginSpec *, SpecState>::iterator it = m_states.begin();
+    for (; it != m_states.end(); ++it) {
+        PluginSpec *spec = it.key();
+        SpecState &state = it.value();
+
+        const bool enabled = spec->isEnabled();
+        const bool indirectlyDisabled = spec->isIndirectlyDisabled();
+        if (enabled == state.enabled
+                && indirectlyDisabled == state.indirectlyDisabled)
+            continue;
+
+        if (enabled != state.enabled && state.category != 0) {
+            state.category->enabledCount += enabled ? 1 : -1;
+            if (!changedCategories.contains(state.category))
+                changedCategories.append(state.category);
+        }
+        state.enabled = enabled;
+        state.indirectlyDisabled = indirectlyDisabled;
+
+        emit dataChanged(specIndex(spec, EnabledColumn),
+                specIndex(spec, IndirectlyDisabledColumn));
+    }
+
+    foreach (Category *category, changedCategories) {
+        const QModelIndex categoryIndex =
+            createIndex(category->row, EnabledColumn);
+        emit dataChanged(categoryIndex, categoryIndex);
+    }
+}
+
+QModelIndex PluginModel::specIndex(PluginSpec *spec, int column) const
+{
+    const SpecState &state = m_states[spec];
+    return createIndex(state.row, column, state.category);
+}
+
+void PluginModel::updateStatistics()
+{
+    PluginSpec *spec = qobject_cast<PluginSpec *>(sender());
+    if (spec == 0 || !m_states.contains(spec))
+        return;
+
+    // Loading may also have changed the icon and the tool tip
+    emit dataChanged(specIndex(spec, NameColumn),
+            specIndex(spec, NameColumn));
+    emit dataChanged(specIndex(spec, LoadTimeColumn),
+            specIndex(spec, ThreadColumn));
+}
+
+QVariant PluginModel::specData(PluginSpec *spec, int column, int role) const
+{
+    if (column >= LoadTimeColumn)
+        return statisticsData(spec, column, role);
+
+    switch (role) {
+    case SortRole:
+        if (column == EnabledColumn || column == IndirectlyDisabledColumn)
+            return specData(spec, column, Qt::CheckStateRole);
+        return specData(spec, column, Qt::DisplayRole);
+
+    case Qt::DisplayRole:
+        switch (column) {
+        case NameColumn:
+            return spec->name();
+        case VersionColumn:
+            return spec->version();
+        case DescriptionColumn:
+            return spec->description();
+        case DependencyColumn:
+            return dependencies(spec);
+        }
+        break;
+
+    case Qt::CheckStateRole:
+        if (column == EnabledColumn)
+            return m_states[spec].enabled ? Qt::Checked : Qt::Unchecked;
+        if (column == IndirectlyDisabledColumn) {
+            return m_states[spec].indirectlyDisabled
+                ? Qt::Checked : Qt::Unchecked;
+        }
+        break;
+
+    case Qt::DecorationRole:
+        if (column == NameColumn)
+            return stateIcon(spec);
+        break;
+
+    case Qt::ToolTipRole:
+        if (column == NameColumn) {
+            if (spec->hasError())
+                return tr("Plugin error:\n%1").arg(spec->errorString());
+            if (!spec->plugin())
+                return tr("Plugin not loaded.");
+        }
+        break;
+    }
+    return QVariant();
+}
+
+QVariant PluginModel::statisticsData(PluginSpec *spec, int column,
+        int role) const
+{
+    if (role != Qt::DisplayRole && role != SortRole
+            && role != Qt::TextAlignmentRole)
+        return QVariant();
+
+    const PluginStatistics statistics = spec->statistics();
+    if (column == ThreadColumn)
+        return role == Qt::TextAlignmentRole ? QVariant() : statistics.thread;
+    if (role == Qt::TextAlignmentRole)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+
+    qint64 value = -1;
+    switch (column) {
+    case LoadTimeColumn:
+        value = statistics.loadTime;
+        break;
+    case InitializationTimeColumn:
+        value = statistics.initializationTime;
+        break;
+    case ShutdownTimeColumn:
+        value = statistics.shutdownTime;
+        break;
+    case MemoryColumn:
+        if (role == SortRole)
+            return statistics.memoryDelta;
+        if (statistics.loadStarted < 0)
+            return QString();
+        return tr("%1 KiB").arg(statistics.memoryDelta / 1024);
+    }
+
+    if (role == SortRole)
+        return value;
+    return value < 0 ? QString() : tr("%1 ms").arg(value);
+}
+
+QVariant PluginModel::categoryData(const Category *category, int column,
+        int role) const
+{
+    switch (role) {
+    case SortRole:
+        return categoryData(category, column, column == EnabledColumn
+                ? Qt::CheckStateRole : Qt::DisplayRole);
+
+    case Qt::DisplayRole:
+        if (column == NameColumn)
+            return category->name;
+        break;
+
+    case Qt::CheckStateRole:
+        if (column == EnabledColumn) {
+            if (category->enabledCount == 0)
+                return Qt::Unchecked;
+            if (category->enabledCount == category->specs.size())
+                return Qt::Checked;
+            return Qt::PartiallyChecked;
+        }
+        break;
+
+    case Qt::ToolTipRole:
+        if (column == NameColumn)
+            return tr("Category: %1").arg(category->name);
+        break;
+    }
+    return QVariant();
+}
+
+QString PluginModel::dependencies(PluginSpec *spec) const
+{
+    QHash<PluginSpec *, QString>::const_iterator it =
+        m_dependencies.constFind(spec);
+    if (it != m_dependencies.constEnd())
+        return it.value();
+
+    QStringList names;
+    foreach (const PluginDependency &dependency, spec->dependencies())
+        names.append(dependency.name);
+    const QString joined = names.join(QLatin1String(", "));
+    m_dependencies.insert(spec, joined);
+    return joined;
+}
+
+void PluginModel::setPluginEnabled(PluginSpec *spec, bool enabled)
+{
+    spec->setEnabled(enabled);
+    foreach (PluginSpec *providesSpec, spec->providesForSpecs())
+        providesSpec->resolveIndirectlyDisabled(true);
+}
+
+QIcon PluginModel::stateIcon(PluginSpec *spec)
+{
+    static QIcon okIcon =
+        QIcon(QLatin1String(":/pluginloader/images/ok.png"));
+    static QIcon errorIcon =
+        QIcon(QLatin1String(":/pluginloader/images/error.png"));
+    static QIcon notLoadedIcon =
+        QIcon(QLatin1String(":/pluginloader/images/not-loaded.png"));
+
+    if (spec->hasError())
+        return errorIcon;
+    if (!spec->plugin())
+        return notLoadedIcon;
+    return okIcon;
+}
@@ -0,0 +1,121 @@
+#ifndef PLUGINLOADER_PLUGINMODEL_H
+#define PLUGINLOADER_PLUGINMODEL_H
+
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtGui/QIcon>
+
+namespace PluginLoader {
+
+class PluginSpec;
+
+/*!
+    \brief Item model over the plugins known to the PluginManager.
+
+    Plugins with a category are grouped below a category item, the others
+    are top level items. Cell contents are computed on request only, the
+    model itself keeps just the grouping and the last seen enabled states.
+    After a change of the enabled flags, refresh() compares the states and
+    emits dataChanged() for the plugins that actually changed. The statistics
+    columns follow PluginSpec::statisticsChanged().
+ */
+class PluginModel : public QAbstractItemModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PluginModel)
+
+public:
+    enum Column {
+        NameColumn,
+        EnabledColumn,
+        IndirectlyDisabledColumn,
+        VersionColumn,
+        DescriptionColumn,
+        DependencyColumn,
+        LoadTimeColumn,
+        InitializationTimeColumn,
+        ShutdownTimeColumn,
+        MemoryColumn,
+        ThreadColumn,
+        ColumnCount
+    };
+
+    enum Role {
+        //! Value to sort by, numeric for the statistics columns
+        SortRole = Qt::UserRole
+    };
+
+    explicit PluginModel(QObject *parent = 0);
+    virtual ~PluginModel();
+
+    virtual QModelIndex index(int row, int column,
+            const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex &child) const;
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index,
+            int role = Qt::DisplayRole) const;
+    virtual bool setData(const QModelIndex &index, const QVariant &value,
+            int role = Qt::EditRole);
+    virtual Qt::ItemFlags flags(const QModelIndex &index) const;
+    virtual QVariant headerData(int section, Qt::Orientation orientation,
+            int role = Qt::DisplayRole) const;
+
+    PluginSpec *pluginSpec(const QModelIndex &index) const;
+
+public slots:
+    void refresh();
+
+signals:
+    //! Emitted when the user changed the enabled flag of some plugins.
+    void pluginSettingsChanged();
+
+private slots:
+    void updateStatistics();
+
+private:
+    struct Category
+    {
+        QString name;
+        QList<PluginSpec *> specs;
+        int row;
+        int enabledCount;
+    };
+
+    struct SpecState
+    {
+        //! Category of the plugin, 0 for top level plugins
+        Category *category;
+        int row;
+        bool enabled;
+        bool indirectlyDisabled;
+    };
+
+    struct TopLevelItem
+    {
+        Category *category;
+        PluginSpec *spec;
+    };
+
+private:
+    QModelIndex specIndex(PluginSpec *spec, int column) const;
+    QVariant specData(PluginSpec *spec, int column, int role) const;
+    QVariant categoryData(const Category *category, int column,
+            int role) const;
+    QVariant statisticsData(PluginSpec *spec, int column, int role) const;
+    QString dependencies(PluginSpec *spec) const;
+    void setPluginEnabled(PluginSpec *spec, bool enabled);
+    static QIcon stateIcon(PluginSpec *spec);
+
+private:
+    QList<TopLevelItem> m_topLevelItems;
+    QList<Category *> m_categories;
+    QHash<PluginSpec *, SpecState> m_states;
+    //! Dependency lists, joined when displayed for the first time
+    mutable QHash<PluginSpec *, QString> m_dependencies;
+};
+
+} // namespace PluginLoader
+
+#endif // PLUGINLOADER_PLUGINMODEL_H
@@ -1,15 +1,21 @@
 #include "pluginspec.h"
 #include "pluginspec_p.h"
 
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QLibrary>
 #include <QtCore/QPluginLoader>
 #include <QtCore/QRegExp>
 #include <QtCore/QStack>
+#include <QtCore/QThread>
 
+#include <utils/debugger.h>
 #include <utils/filehelper.h>
+#include <utils/stringpool.h>
 
+#include "iasyncplugin.h"
 #include "iplugin.h"
 
 using namespace PluginLoader;
@@ -19,14 +25,12 @@ enum {
 };
 
 PluginSpec::PluginSpec()
-    : d_ptr(new PluginSpecPrivate(this))
+    : d_ptr(this)
 {
 }
 
 PluginSpec::~PluginSpec()
 {
-    Q_D(PluginSpec);
-    delete d;
 }
 
 /*!
@@ -101,7 +105,7 @@ bool PluginSpec::unloadQueue(QList<PluginSpec *> &queue, QList<PluginSpec *>
 QString PluginSpec::name() const
 {
     Q_D(const PluginSpec);
-    return d->name;
+    return d->name.toString();
 }
 
 /*!
@@ -117,13 +121,14 @@ QString PluginSpec::version() const
 
 /*!
     The plugin description.
-    This is valid after the PluginSpec::Read state is reached.
+    This is valid after the PluginSpec::Read state is reached. It is read
+    from the spec file when first asked for, as only the UI shows it.
     \sa PluginSpec::State
  */
 QString PluginSpec::description() const
 {
     Q_D(const PluginSpec);
-    return d->description;
+    return d->loadDescription();
 }
 
 /*!
@@ -289,6 +294,20 @@ bool PluginSpec::initializePlugin()
     return d->initializePlugin();
 }
 
+/*!
+    Initializes the plugin by IAsyncPlugin::initializeAsync() if it
+    implements IAsyncPlugin, otherwise by initializePlugin() before
+    returning. The state and statistics are updated in the GUI thread once
+    the initialization finished.
+    \return the future telling whether the plugin was initialized
+    successfully
+ */
+Utils::Future<bool> PluginSpec::initializePluginAsync()
+{
+    Q_D(PluginSpec);
+    return d->initializePluginAsync();
+}
+
 /*!
     The corresponding IPlugin instance, if the plugin library has already been
     successfully loaded, i.e. the PluginSpec::Loaded state is reached.
@@ -334,6 +353,18 @@ QString PluginSpec::errorString() const
     return d->errorString;
 }
 
+/*!
+    Timings and memory usage measured while loading, initializing and
+    shutting down the plugin.
+    \return the plugin statistics
+    \sa PluginStatistics
+ */
+PluginStatistics PluginSpec::statistics() const
+{
+    Q_D(const PluginSpec);
+    return d->statistics;
+}
+
 #if !defined(QT_NO_DEBUG_STREAM)
 QDebug operator<<(QDebug dbg, const PluginLoader::PluginSpec *pluginSpecPtr)
 {
@@ -364,6 +395,8 @@ PluginSpecPrivate::PluginSpecPrivate(PluginSpec *q)
     plugin(0),
     state(PluginSpec::Invalid),
     hasError(false),
+    initializationMemory(-1),
+    descriptionLoaded(false),
     q_ptr(q)
 {
 }
@@ -374,9 +407,10 @@ PluginSpecPrivate::~PluginSpecPrivate()
 
 bool PluginSpecPrivate::read(const QString &specFileName)
 {
-    name.clear();
+    name = Utils::UniqueId();
     version.clear();
     description.clear();
+    descriptionLoaded = false;
     category.clear();
     errorString.clear();
     dependencies.clear();
@@ -388,6 +422,7 @@ bool PluginSpecPrivate::read(const QString &specFileName)
     plugin = 0;
     state = PluginSpec::Invalid;
     hasError = false;
+    statistics = PluginStatistics();
 
     QFile file(specFileName);
     if (!file.exists()) {
@@ -400,7 +435,8 @@ bool PluginSpecPrivate::read(const QString &specFileName)
     }
 
     QFileInfo fileInfo(file);
-    filePath = fileInfo.absolutePath();
+    filePath = Utils::StringPool::globalInstance()->intern(
+            fileInfo.absolutePath());
     fileName = fileInfo.fileName();
 
     QXmlStreamReader reader(&file);
@@ -445,17 +481,22 @@ bool PluginSpecPrivate::resolveDependencies(const QList<PluginSpec *> &specs)
     foreach (const PluginDependency &dependency, dependencies) {
         PluginSpec *found = 0;
 
-        foreach (PluginSpec *spec, specs) {
-            if (spec->name() == dependency.name) {
-                found = spec;
-                spec->d_ptr->providesSpecs.append(q);
-                break;
+        // A name of no plugin read gets no id, it is missing anyway
+        if (Utils::UniqueId::hasUniqueId(dependency.name)) {
+            const Utils::UniqueId dependencyName =
+                Utils::UniqueId::fromName(dependency.name);
+            foreach (PluginSpec *spec, specs) {
+                if (spec->d_ptr->name == dependencyName) {
+                    found = spec;
+                    spec->d_ptr->providesSpecs.append(q);
+                    break;
+                }
             }
         }
         if (!found) {
             reportError(PluginSpec::tr(
                         "Plugin %1 - could not resolve dependency on %2.")
-                    .arg(name).arg(dependency.name));
+                    .arg(name.toString()).arg(dependency.name));
             continue;
         }
         else {
@@ -485,13 +526,13 @@ void PluginSpecPrivate::resolveIndirectlyDisabled(bool forceResolve)
         indirectlyDisabled = true;
         circularDependencyDetected = true;
 
-        QString pluginOrder = name;
+        QString pluginOrder = name.toString();
         QStack<PluginSpecPrivate *>::const_iterator i =
                 resolvedPluginsStack.constEnd();
         while (i != resolvedPluginsStack.constBegin()) {
             --i;
             PluginSpecPrivate *pluginSpec = *i;
-            pluginOrder.append(QString(" -> ")).append(pluginSpec->name);
+            pluginOrder.append(QString(" -> ")).append(pluginSpec->name.toString());
             if (pluginSpec == this)
                 break;
         }
@@ -560,7 +601,7 @@ bool PluginSpecPrivate::loadQueue(QList<PluginSpec *> &queue,
             pluginOrder.append(QString(" -> "))
                 .append(circularityCheckQueue.at(i)->name());
         }
-        pluginOrder.append(QString(" -> ")).append(name);
+        pluginOrder.append(QString(" -> ")).append(name.toString());
 
         reportError(PluginSpec::tr("Circular dependency detected: %1")
                 .arg(pluginOrder));
@@ -572,7 +613,7 @@ bool PluginSpecPrivate::loadQueue(QList<PluginSpec *> &queue,
         if (!pluginSpec->loadQueue(queue, circularityCheckQueue)) {
             reportError(PluginSpec::tr(
                     "Plugin %1 cannot be loaded because dependency %2 failed.")
-                    .arg(name).arg(pluginSpec->name()));
+                    .arg(name.toString()).arg(pluginSpec->name()));
             return false;
         }
     }
@@ -602,7 +643,7 @@ bool PluginSpecPrivate::unloadQueue(QList<PluginSpec *> &queue,
             pluginOrder.append(QString(" -> "))
                 .append(circularityCheckQueue.at(i)->name());
         }
-        pluginOrder.append(QString(" -> ")).append(name);
+        pluginOrder.append(QString(" -> ")).append(name.toString());
 
         reportError(PluginSpec::tr("Circular dependency detected: %1")
                 .arg(pluginOrder));
@@ -623,7 +664,8 @@ IPlugin *PluginSpecPrivate::loadPlugin()
 {
     Q_ASSERT(state == PluginSpec::Resolved);
 
-    const QString libName = Utils::FileHelper::buildPluginName(filePath, name);
+    const QString libName = Utils::FileHelper::buildPluginName(filePath,
+            name.toString());
     Q_ASSERT(QLibrary::isLibrary(libName));
     Q_ASSERT(QFile::exists(libName));
 
@@ -634,8 +676,18 @@ IPlugin *PluginSpecPrivate::loadPlugin()
         }
     }
 
+    Q_Q(PluginSpec);
+
+    const qint64 memoryBefore = Utils::Debugger::residentMemorySize();
+    QElapsedTimer timer;
+    timer.start();
+    statistics.loadStarted = timer.msecsSinceReference();
+
     QPluginLoader pluginLoader(libName);
     QObject *object = pluginLoader.instance();
+    statistics.loadTime = timer.elapsed();
+    addMemoryDelta(memoryBefore);
+    emit q->statisticsChanged();
     if (object != 0) {
         plugin = qobject_cast<IPlugin *>(object);
         if (plugin != 0) {
@@ -665,10 +717,18 @@ void PluginSpecPrivate::unloadPlugin()
     if (plugin == 0)
         return;
 
-    if (state >= PluginSpec::Initialized)
+    if (state >= PluginSpec::Initialized) {
+        Q_Q(PluginSpec);
+
+        QElapsedTimer timer;
+        timer.start();
         plugin->shutdown();
+        statistics.shutdownTime = timer.elapsed();
+        emit q->statisticsChanged();
+    }
 
-    const QString libName = Utils::FileHelper::buildPluginName(filePath, name);
+    const QString libName = Utils::FileHelper::buildPluginName(filePath,
+            name.toString());
     QPluginLoader pluginLoader(libName);
 
     // to be able to unload plugin QPluginLoader has to be initialized and connected with plugin,
@@ -696,13 +756,63 @@ bool PluginSpecPrivate::initializePlugin()
     Q_ASSERT(plugin != 0);
     Q_ASSERT(state == PluginSpec::Loaded);
 
+    beginInitialization();
     QString errorString;
-    if (!plugin->initialize(&errorString)) {
+    const bool initialized = plugin->initialize(&errorString);
+    return finishInitialization(initialized, errorString);
+}
+
+Utils::Future<bool> PluginSpecPrivate::initializePluginAsync()
+{
+    Q_ASSERT(plugin != 0);
+    Q_ASSERT(state == PluginSpec::Loaded);
+
+    QObject *object = dynamic_cast<QObject *>(plugin);
+    IAsyncPlugin *asyncPlugin = qobject_cast<IAsyncPlugin *>(object);
+    if (asyncPlugin == 0) {
+        Utils::Promise<bool> promise;
+        promise.setResult(initializePlugin());
+        return promise.future();
+    }
+
+    beginInitialization();
+    // Statistics and state belong to the GUI thread
+    return asyncPlugin->initializeAsync().then(this,
+            &PluginSpecPrivate::asyncInitializationFinished,
+            Utils::Executor::guiThread());
+}
+
+void PluginSpecPrivate::beginInitialization()
+{
+    QThread *const thread = QThread::currentThread();
+    if (!thread->objectName().isEmpty())
+        statistics.thread = thread->objectName();
+    else if (qApp != 0 && thread == qApp->thread())
+        statistics.thread = QLatin1String("main");
+    else
+        statistics.thread = QString::fromLatin1("0x%1")
+            .arg(quintptr(QThread::currentThreadId()), 0, 16);
+
+    initializationMemory = Utils::Debugger::residentMemorySize();
+    initializationTimer.start();
+    statistics.initializationStarted =
+        initializationTimer.msecsSinceReference();
+}
+
+bool PluginSpecPrivate::finishInitialization(bool initialized,
+        const QString &errorString)
+{
+    Q_Q(PluginSpec);
+
+    statistics.initializationTime = initializationTimer.elapsed();
+    addMemoryDelta(initializationMemory);
+    emit q->statisticsChanged();
+    if (!initialized) {
         qWarning("Initialization of \'%s\' plugin failed: %s",
                 qPrintable(name), qPrintable(errorString));
         reportError(PluginSpec::tr(
                 "Initialization of \'%1\' plugin failed: ")
-                .arg(name));
+                .arg(name.toString()));
         initializationFailed = true;
         return false;
     }
@@ -713,7 +823,7 @@ bool PluginSpecPrivate::initializePlugin()
                 qPrintable(name),
                 qPrintable(version),
                 qPrintable(category),
-                qPrintable(description));
+                qPrintable(loadDescription()));
     }
 
     initializationFailed = false;
@@ -721,6 +831,23 @@ bool PluginSpecPrivate::initializePlugin()
     return true;
 }
 
+bool PluginSpecPrivate::asyncInitializationFinished(
+        const Utils::Future<bool> &initialized)
+{
+    QString errorString = initialized.errorString();
+    if (initialized.isCanceled())
+        errorString = QLatin1String("initialization canceled");
+    return finishInitialization(initialized.isSucceeded()
+            && initialized.result(), errorString);
+}
+
+void PluginSpecPrivate::addMemoryDelta(qint64 memoryBefore)
+{
+    const qint64 memoryAfter = Utils::Debugger::residentMemorySize();
+    if (memoryBefore >= 0 && memoryAfter >= 0)
+        statistics.memoryDelta += memoryAfter - memoryBefore;
+}
+
 bool PluginSpecPrivate::isValidVersion(const QString &version)
 {
     return versionRegExp().exactMatch(version);
@@ -764,6 +891,29 @@ bool PluginSpecPrivate::reportError(const QString &err)
     return false;
 }
 
+QString PluginSpecPrivate::loadDescription() const
+{
+    if (descriptionLoaded || state == PluginSpec::Invalid)
+        return description;
+    descriptionLoaded = true;
+
+    QFile file(filePath + QLatin1Char('/') + fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(file.errorString()));
+        return description;
+    }
+
+    QXmlStreamReader reader(&file);
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement() && reader.name() == QLatin1String(DESCRIPTION)) {
+            description = reader.readElementText().trimmed();
+            break;
+        }
+    }
+    return description;
+}
+
 void PluginSpecPrivate::readPluginSpec(QXmlStreamReader &reader)
 {
     QString element = reader.name().toString();
@@ -772,12 +922,14 @@ void PluginSpecPrivate::readPluginSpec(QXmlStreamReader &reader)
                     "Expected element '%1' as top level element").arg(PLUGIN));
         return;
     }
-    name = reader.attributes().value(PLUGIN_NAME).toString();
-    if (name.isEmpty()) {
+    const QString pluginName =
+        reader.attributes().value(PLUGIN_NAME).toString();
+    if (pluginName.isEmpty()) {
         reportError(PluginSpec::tr("Expected attribut '%1' at element %2")
                     .arg(PLUGIN_NAME).arg(PLUGIN));
         return;
     }
+    name = Utils::UniqueId::fromName(pluginName);
     version = reader.attributes().value(PLUGIN_VERSION).toString();
     if (!isValidVersion(version)) {
         version.clear();
@@ -787,10 +939,14 @@ void PluginSpecPrivate::readPluginSpec(QXmlStreamReader &reader)
         switch (reader.tokenType()) {
         case QXmlStreamReader::StartElement:
             element = reader.name().toString();
-            if (element == DESCRIPTION)
-                description = reader.readElementText().trimmed();
-            else if (element == CATEGORY)
-                category = reader.readElementText().trimmed();
+            if (element == DESCRIPTION) {
+                // Read by loadDescription() when needed
+                reader.skipCurrentElement();
+            }
+            else if (element == CATEGORY) {
+                category = Utils::StringPool::globalInstance()->intern(
+                        reader.readElementText().trimmed());
+            }
             else if (element == DEPENDENCYLIST)
                 readDependencies(reader);
             break;
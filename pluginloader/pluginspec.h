@@ -4,6 +4,9 @@
 #include <QtCore/QMetaType>
 #include <QtCore/QObject>
 
+#include <utils/future.h>
+#include <utils/pimpl.h>
+
 #include "pluginloader_global.h"
 
 namespace PluginLoader {
@@ -19,6 +22,32 @@ struct PLUGINLOADER_EXPORT PluginDependency
     QString version;
 };
 
+//! Timings collected while the plugin goes through its loading process.
+struct PLUGINLOADER_EXPORT PluginStatistics
+{
+    PluginStatistics()
+        : loadStarted(-1), loadTime(-1),
+        initializationStarted(-1), initializationTime(-1),
+        shutdownTime(-1), memoryDelta(0) {}
+
+    //! Start of loading on the monotonic clock (see
+    //! QElapsedTimer::msecsSinceReference()), -1 if not loaded
+    qint64 loadStarted;
+    //! Time spent loading the plugin library in milliseconds, -1 if not loaded
+    qint64 loadTime;
+    //! Start of IPlugin::initialize() on the monotonic clock, -1 if not called
+    qint64 initializationStarted;
+    //! Time spent in IPlugin::initialize() in milliseconds, -1 if not called
+    qint64 initializationTime;
+    //! Time spent in IPlugin::shutdown() in milliseconds, -1 if not called
+    qint64 shutdownTime;
+    //! Growth of the process' resident memory in bytes while the plugin was
+    //! loaded and initialized
+    qint64 memoryDelta;
+    //! Thread IPlugin::initialize() was called in
+    QString thread;
+};
+
 class PluginSpecPrivate;
 
 /*!
@@ -100,6 +129,7 @@ public:
     IPlugin *loadPlugin();
     void unloadPlugin();
     bool initializePlugin();
+    Utils::Future<bool> initializePluginAsync();
     IPlugin *plugin() const;
 
     // State
@@ -107,9 +137,15 @@ public:
     bool hasError() const;
     QString errorString() const;
 
+    PluginStatistics statistics() const;
+
+signals:
+    //! Emitted when a loading step updated statistics().
+    void statisticsChanged();
+
 private:
     Q_DECLARE_PRIVATE(PluginSpec)
-    PluginSpecPrivate *d_ptr;
+    Utils::FastPimpl<PluginSpecPrivate, 512> d_ptr;
 };
 
 } // namespace PluginLoader
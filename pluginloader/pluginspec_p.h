@@ -4,8 +4,11 @@
 
 #include "pluginspec.h"
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QXmlStreamReader>
 
+#include <utils/uniqueid.h>
+
 namespace PluginLoader {
 
 class PluginSpecPrivate
@@ -25,10 +28,12 @@ public:
     IPlugin *loadPlugin();
     void unloadPlugin();
     bool initializePlugin();
+    Utils::Future<bool> initializePluginAsync();
+    QString loadDescription() const;
 
-    QString name;
+    Utils::UniqueId name;
     QString version;
-    QString description;
+    //! Interned, as most plugins share few categories
     QString category;
     QList<PluginDependency> dependencies;
     bool enabled;
@@ -37,6 +42,7 @@ public:
     bool initializationFailed;
     bool circularDependencyDetected;
 
+    //! Interned, as most plugins share few directories
     QString filePath;
     QString fileName;
 
@@ -48,11 +54,20 @@ public:
     bool hasError;
     QString errorString;
 
+    PluginStatistics statistics;
+    //! Measures the running initialization
+    QElapsedTimer initializationTimer;
+    qint64 initializationMemory;
+
     static bool isValidVersion(const QString &version);
     static int versionCompare(const QString &version1, const QString &version2);
 
 private:
     bool reportError(const QString &err);
+    void addMemoryDelta(qint64 memoryBefore);
+    void beginInitialization();
+    bool finishInitialization(bool initialized, const QString &errorString);
+    bool asyncInitializationFinished(const Utils::Future<bool> &initialized);
     void readPluginSpec(QXmlStreamReader &reader);
     void readDependencies(QXmlStreamReader &reader);
     void readDependencyEntry(QXmlStreamReader &reader);
@@ -60,6 +75,10 @@ private:
     static QRegExp &versionRegExp();
 
 private:
+    //! Read from the spec file when asked for
+    mutable QString description;
+    mutable bool descriptionLoaded;
+
     Q_DECLARE_PUBLIC(PluginSpec)
     PluginSpec *q_ptr;
 };
@@ -0,0 +1,147 @@
+#include "plugintimeline.h"
+
+#include <QtCore/QTimer>
+#include <QtCore/QtAlgorithms>
+#include <QtGui/QPainter>
+
+#include "pluginmanager.h"
+#include "pluginspec.h"
+
+using namespace PluginLoader;
+
+namespace {
+    const int ROW_HEIGHT = 16;
+    const int NAME_WIDTH = 150;
+    const int MARGIN = 4;
+
+    bool loadedEarlier(PluginSpec *spec1, PluginSpec *spec2)
+    {
+        return spec1->statistics().loadStarted
+            < spec2->statistics().loadStarted;
+    }
+}
+
+/*!
+    Constructs the timeline of the plugins known to the PluginManager.
+    \param parent the parent widget
+ */
+PluginTimeline::PluginTimeline(QWidget *parent)
+    : QWidget(parent),
+    m_currentSpec(0),
+    m_startTime(-1),
+    m_endTime(-1),
+    m_updatePending(false)
+{
+    foreach (PluginSpec *spec, PluginManager::instance()->pluginSpecs()) {
+        connect(spec, SIGNAL(statisticsChanged()),
+                this, SLOT(scheduleUpdateRows()));
+    }
+    updateRows();
+}
+
+PluginTimeline::~PluginTimeline()
+{
+}
+
+//! Highlights the row of \a spec, 0 removes the highlight.
+void PluginTimeline::setCurrentSpec(PluginSpec *spec)
+{
+    if (spec == m_currentSpec)
+        return;
+    m_currentSpec = spec;
+    update();
+}
+
+QSize PluginTimeline::sizeHint() const
+{
+    return QSize(NAME_WIDTH + 300,
+            m_specs.size() * ROW_HEIGHT + 2 * MARGIN);
+}
+
+/*!
+    Rebuilds the rows once control returns to the event loop, so that the
+    statistics reported by many plugins in a row cost a single rebuild.
+ */
+void PluginTimeline::scheduleUpdateRows()
+{
+    if (m_updatePending)
+        return;
+    m_updatePending = true;
+    QTimer::singleShot(0, this, SLOT(updateRows()));
+}
+
+void PluginTimeline::updateRows()
+{
+    m_updatePending = false;
+    m_specs.clear();
+    m_startTime = -1;
+    m_endTime = -1;
+
+    foreach (PluginSpec *spec, PluginManager::instance()->pluginSpecs()) {
+        const PluginStatistics statistics = spec->statistics();
+        if (statistics.loadStarted < 0)
+            continue;
+
+        m_specs.append(spec);
+        if (m_startTime < 0 || statistics.loadStarted < m_startTime)
+            m_startTime = statistics.loadStarted;
+        m_endTime = qMax(m_endTime,
+                statistics.loadStarted + qMax(statistics.loadTime, qint64(0)));
+        if (statistics.initializationStarted >= 0) {
+            m_endTime = qMax(m_endTime, statistics.initializationStarted
+                    + qMax(statistics.initializationTime, qint64(0)));
+        }
+    }
+    qSort(m_specs.begin(), m_specs.end(), loadedEarlier);
+
+    updateGeometry();
+    update();
+}
+
+void PluginTimeline::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    if (m_specs.isEmpty()) {
+        painter.drawText(rect(), Qt::AlignCenter, tr("No plugin loaded."));
+        return;
+    }
+
+    const int barsWidth = qMax(width() - NAME_WIDTH - 2 * MARGIN, 1);
+    // At least one millisecond so that instant startups are still drawn
+    const qint64 duration = qMax(m_endTime - m_startTime, qint64(1));
+    const QColor loadColor = palette().color(QPalette::Highlight);
+    const QColor initializationColor = loadColor.lighter(150);
+
+    int y = MARGIN;
+    foreach (PluginSpec *spec, m_specs) {
+        const PluginStatistics statistics = spec->statistics();
+
+        if (spec == m_currentSpec) {
+            painter.fillRect(0, y, width(), ROW_HEIGHT,
+                    palette().color(QPalette::AlternateBase));
+        }
+        painter.drawText(MARGIN, y, NAME_WIDTH - MARGIN, ROW_HEIGHT,
+                Qt::AlignLeft | Qt::AlignVCenter, spec->name());
+
+        const int x = MARGIN + NAME_WIDTH + int((statistics.loadStarted
+                    - m_startTime) * barsWidth / duration);
+        const int loadWidth = qMax(int(qMax(statistics.loadTime, qint64(0))
+                    * barsWidth / duration), 1);
+        painter.fillRect(x, y + 2, loadWidth, ROW_HEIGHT - 4, loadColor);
+
+        if (statistics.initializationStarted >= 0) {
+            const int initializationX = MARGIN + NAME_WIDTH
+                + int((statistics.initializationStarted - m_startTime)
+                        * barsWidth / duration);
+            const int initializationWidth = qMax(int(qMax(
+                            statistics.initializationTime, qint64(0))
+                        * barsWidth / duration), 1);
+            painter.fillRect(initializationX, y + 2, initializationWidth,
+                    ROW_HEIGHT - 4, initializationColor);
+        }
+
+        y += ROW_HEIGHT;
+    }
+}
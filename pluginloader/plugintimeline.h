@@ -0,0 +1,49 @@
+#ifndef PLUGINLOADER_PLUGINTIMELINE_H
+#define PLUGINLOADER_PLUGINTIMELINE_H
+
+#include <QtCore/QList>
+#include <QtGui/QWidget>
+
+namespace PluginLoader {
+
+class PluginSpec;
+
+/*!
+    \brief Draws when each plugin was loaded and initialized.
+
+    Every plugin that was loaded gets one row with a bar for the loading of
+    its library followed by a bar for IPlugin::initialize(), placed on a
+    common time axis starting with the first plugin loaded. The widget
+    repaints as the plugins report new statistics.
+ */
+class PluginTimeline : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PluginTimeline)
+
+public:
+    explicit PluginTimeline(QWidget *parent = 0);
+    virtual ~PluginTimeline();
+
+    void setCurrentSpec(PluginSpec *spec);
+
+    virtual QSize sizeHint() const;
+
+protected:
+    virtual void paintEvent(QPaintEvent *event);
+
+private slots:
+    void scheduleUpdateRows();
+    void updateRows();
+
+private:
+    QList<PluginSpec *> m_specs;
+    PluginSpec *m_currentSpec;
+    qint64 m_startTime;
+    qint64 m_endTime;
+    bool m_updatePending;
+};
+
+} // namespace PluginLoader
+
+#endif // PLUGINLOADER_PLUGINTIMELINE_H
@@ -5,7 +5,7 @@
 #include "pluginview.h"
 
 QT_BEGIN_NAMESPACE
-class QTreeWidgetItem;
+class QSortFilterProxyModel;
 QT_END_NAMESPACE
 
 namespace PluginLoader {
@@ -14,7 +14,8 @@ namespace Ui {
     class PluginView;
 } // namespace Ui
 
-class PluginSpec;
+class PluginModel;
+class PluginTimeline;
 
 class PluginViewPrivate : public QObject
 {
@@ -24,30 +25,17 @@ public:
     explicit PluginViewPrivate(PluginView *q);
     virtual ~PluginViewPrivate();
 
-private:
-    enum IconType {
-        IconOK = 1,
-        IconNotLoaded = 2,
-        IconError = 4
-    };
-
-private:
-    QIcon getIcon(IconType type);
-    void createTree();
-    void updateTree();
-    Qt::CheckState parsePluginSpecs(QTreeWidgetItem *parentItem,
-            QList<PluginSpec*> pluginSpecs);
-
 private slots:
-    void updatePluginSettings(QTreeWidgetItem *item, int column);
+    void updateDetails();
 
 private:
     Q_DECLARE_PUBLIC(PluginView)
     PluginView *q_ptr;
 
     Ui::PluginView *m_ui;
-    QList<QTreeWidgetItem*> m_items;
-    QHash<PluginSpec*, QTreeWidgetItem*> m_specToItem;
+    PluginModel *m_model;
+    QSortFilterProxyModel *m_proxyModel;
+    PluginTimeline *m_timeline;
 };
 
 } // namespace PluginLoader
@@ -0,0 +1,280 @@
+#include "snapshotstore.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtGui/QDesktopServices>
+
+#include <utils/filehelper.h>
+
+#include "iplugin.h"
+#include "isnapshotplugin.h"
+#include "pluginspec.h"
+
+using namespace PluginLoader;
+
+namespace {
+    const quint32 SNAPSHOT_MAGIC = 0x4e534451; // "QDSN"
+    const quint32 SNAPSHOT_FORMAT = 1;
+    const qint64 DATA_ALIGNMENT = 64;
+    const char * const SNAPSHOT_SUFFIX = ".snapshot";
+    //! Suffix of a snapshot until it replaces the previous one
+    const char * const NEW_SUFFIX = ".new";
+
+    struct SnapshotHeader
+    {
+        SnapshotHeader() : magic(SNAPSHOT_MAGIC), format(SNAPSHOT_FORMAT),
+            snapshotVersion(0), dataOffset(0), dataSize(0) {}
+
+        quint32 magic;
+        quint32 format;
+        //! Version of the plugin writing the snapshot
+        QString pluginVersion;
+        qint32 snapshotVersion;
+        QByteArray inputs;
+        qint64 dataOffset;
+        qint64 dataSize;
+    };
+
+    QByteArray headerData(const SnapshotHeader &header)
+    {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_7);
+        out << header.magic << header.format << header.pluginVersion
+            << header.snapshotVersion << header.inputs << header.dataOffset
+            << header.dataSize;
+        return data;
+    }
+
+    bool readHeader(QIODevice *device, SnapshotHeader *header)
+    {
+        QDataStream in(device);
+        in.setVersion(QDataStream::Qt_4_7);
+        in >> header->magic >> header->format;
+        if (in.status() != QDataStream::Ok || header->magic != SNAPSHOT_MAGIC
+                || header->format != SNAPSHOT_FORMAT)
+            return false;
+        in >> header->pluginVersion >> header->snapshotVersion
+            >> header->inputs >> header->dataOffset >> header->dataSize;
+        return in.status() == QDataStream::Ok;
+    }
+}
+
+SnapshotStore::SnapshotStore()
+{
+    QString location =
+        QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    if (location.isEmpty())
+        location = QDir::tempPath();
+    m_directory = location + QLatin1String("/snapshots");
+}
+
+SnapshotStore::~SnapshotStore()
+{
+    qDeleteAll(m_mapped);
+    foreach (const QString &target, m_pending)
+        replace(target);
+}
+
+void SnapshotStore::setDirectory(const QString &directory)
+{
+    m_directory = directory;
+}
+
+QString SnapshotStore::directory() const
+{
+    return m_directory;
+}
+
+/*!
+    Passes the snapshot of the plugin to ISnapshotPlugin::restoreSnapshot()
+    if it matches the plugin. A snapshot that doesn't match or can't be
+    restored is removed.
+    \return true if the plugin restored its state
+ */
+bool SnapshotStore::restore(PluginSpec *pluginSpec)
+{
+    ISnapshotPlugin *const plugin = snapshotPlugin(pluginSpec);
+    if (plugin == 0)
+        return false;
+
+    release(pluginSpec);
+    QFile *const file = new QFile(fileName(pluginSpec));
+    if (!file->exists() || !file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return false;
+    }
+
+    SnapshotHeader header;
+    const bool matches = readHeader(file, &header)
+        && header.pluginVersion == pluginSpec->version()
+        && header.snapshotVersion == plugin->snapshotVersion()
+        && header.inputs == plugin->snapshotInputs()
+        && header.dataOffset > 0 && header.dataSize > 0
+        && header.dataOffset + header.dataSize <= file->size();
+    uchar *const data = matches
+        ? file->map(header.dataOffset, header.dataSize) : 0;
+
+    QString errorString;
+    if (data == 0 || !plugin->restoreSnapshot(data, header.dataSize,
+                &errorString)) {
+        if (!errorString.isEmpty()) {
+            qWarning("%s: snapshot of %s not restored: %s", Q_FUNC_INFO,
+                    qPrintable(pluginSpec->name()), qPrintable(errorString));
+        }
+        if (data != 0)
+            file->unmap(data);
+        file->remove();
+        delete file;
+        return false;
+    }
+
+    m_mapped.insert(pluginSpec, file);
+    return true;
+}
+
+/*!
+    Writes the snapshot of the plugin by ISnapshotPlugin::saveSnapshot(),
+    replacing the previous one once it is complete. If the plugin restored
+    the previous one, it is replaced when it's released. If the replace
+    fails, both are removed, so the next start builds the state again.
+    \return true if the snapshot was written
+ */
+bool SnapshotStore::save(PluginSpec *pluginSpec)
+{
+    ISnapshotPlugin *const plugin = snapshotPlugin(pluginSpec);
+    if (plugin == 0)
+        return false;
+
+    if (!QDir().mkpath(m_directory)) {
+        qWarning("%s: cannot create %s", Q_FUNC_INFO,
+                qPrintable(m_directory));
+        return false;
+    }
+
+    const QString target = fileName(pluginSpec);
+    QFile file(target + QLatin1String(NEW_SUFFIX));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(file.errorString()));
+        return false;
+    }
+
+    // The header has a fixed size, it's written again with the data size
+    SnapshotHeader header;
+    header.pluginVersion = pluginSpec->version();
+    header.snapshotVersion = plugin->snapshotVersion();
+    header.inputs = plugin->snapshotInputs();
+    const qint64 headerSize = headerData(header).size();
+    header.dataOffset = (headerSize + DATA_ALIGNMENT - 1)
+        & ~(DATA_ALIGNMENT - 1);
+
+    QString errorString;
+    bool saved = file.write(headerData(header)) == headerSize
+        && file.write(QByteArray(int(header.dataOffset - headerSize), '\0'))
+            == header.dataOffset - headerSize
+        && plugin->saveSnapshot(&file, &errorString);
+    if (saved) {
+        header.dataSize = file.size() - header.dataOffset;
+        saved = header.dataSize > 0 && file.seek(0)
+            && file.write(headerData(header)) == headerSize
+            && file.flush();
+    }
+    file.close();
+
+    if (!saved) {
+        qWarning("%s: snapshot of %s not saved: %s", Q_FUNC_INFO,
+                qPrintable(pluginSpec->name()),
+                qPrintable(errorString.isEmpty()
+                    ? file.errorString() : errorString));
+        file.remove();
+        return false;
+    }
+
+    if (m_mapped.contains(pluginSpec)) {
+        m_pending.insert(pluginSpec, target);
+        return true;
+    }
+    return replace(target);
+}
+
+/*!
+    Unmaps the snapshot restored by the plugin, e.g. when it's unloaded, and
+    replaces it by the snapshot saved meanwhile.
+ */
+void SnapshotStore::release(PluginSpec *pluginSpec)
+{
+    delete m_mapped.take(pluginSpec);
+    const QString target = m_pending.take(pluginSpec);
+    if (!target.isEmpty())
+        replace(target);
+}
+
+/*!
+    Removes the snapshot of the plugin, the next start builds its state
+    again. A restored snapshot stays mapped until it's released, it is
+    removed then.
+ */
+void SnapshotStore::invalidate(PluginSpec *pluginSpec)
+{
+    const QString target = fileName(pluginSpec);
+    QFile::remove(target + QLatin1String(NEW_SUFFIX));
+    if (m_mapped.contains(pluginSpec))
+        m_pending.insert(pluginSpec, target);
+    else
+        QFile::remove(target);
+}
+
+//! Removes the snapshots of all plugins.
+void SnapshotStore::invalidateAll()
+{
+    foreach (PluginSpec *pluginSpec, m_mapped.keys())
+        invalidate(pluginSpec);
+
+    QDir directory(m_directory);
+    const QStringList files = directory.entryList(QStringList()
+            << QLatin1String("*") + QLatin1String(SNAPSHOT_SUFFIX),
+            QDir::Files);
+    foreach (const QString &file, files)
+        directory.remove(file);
+}
+
+QString SnapshotStore::fileName(PluginSpec *pluginSpec) const
+{
+    QString name = pluginSpec->name();
+    if (!Utils::FileHelper::isValidFileName(name))
+        name = QString::fromLatin1(name.toUtf8().toHex());
+    return m_directory + QLatin1Char('/') + name
+        + QLatin1String(SNAPSHOT_SUFFIX);
+}
+
+/*!
+    Moves the snapshot written next to \a target in its place. If that
+    fails, both are removed, as the previous one is outdated. Without a new
+    snapshot the previous one is just removed.
+    \return true if the snapshot was replaced
+ */
+bool SnapshotStore::replace(const QString &target)
+{
+    QFile previous(target);
+    QFile file(target + QLatin1String(NEW_SUFFIX));
+    if (!file.exists()) {
+        previous.remove();
+        return false;
+    }
+    if ((!previous.exists() || previous.remove()) && file.rename(target))
+        return true;
+
+    qWarning("%s: %s not replaced: %s", Q_FUNC_INFO, qPrintable(target),
+            qPrintable(previous.error() != QFile::NoError
+                ? previous.errorString() : file.errorString()));
+    file.remove();
+    previous.remove();
+    return false;
+}
+
+ISnapshotPlugin *SnapshotStore::snapshotPlugin(PluginSpec *pluginSpec)
+{
+    QObject *object = dynamic_cast<QObject *>(pluginSpec->plugin());
+    return qobject_cast<ISnapshotPlugin *>(object);
+}
@@ -0,0 +1,58 @@
+#ifndef PLUGINLOADER_SNAPSHOTSTORE_H
+#define PLUGINLOADER_SNAPSHOTSTORE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+QT_BEGIN_NAMESPACE
+class QFile;
+QT_END_NAMESPACE
+
+namespace PluginLoader {
+
+class ISnapshotPlugin;
+class PluginSpec;
+
+/*!
+    \brief Keeps the snapshots of the plugins implementing ISnapshotPlugin.
+
+    Each plugin has one snapshot file in directory(), named after the
+    plugin. The file starts with a header identifying the plugin version,
+    the snapshot version and the inputs it was made from, followed by the
+    data written by the plugin at a 64 byte boundary. Restored snapshots
+    stay mapped until release(). A mapped file can't be replaced on all
+    platforms, so a snapshot saved meanwhile replaces it on release().
+ */
+class SnapshotStore
+{
+    Q_DISABLE_COPY(SnapshotStore)
+
+public:
+    SnapshotStore();
+    ~SnapshotStore();
+
+    void setDirectory(const QString &directory);
+    QString directory() const;
+
+    bool restore(PluginSpec *pluginSpec);
+    bool save(PluginSpec *pluginSpec);
+    void release(PluginSpec *pluginSpec);
+    void invalidate(PluginSpec *pluginSpec);
+    void invalidateAll();
+
+private:
+    QString fileName(PluginSpec *pluginSpec) const;
+    static bool replace(const QString &target);
+    static ISnapshotPlugin *snapshotPlugin(PluginSpec *pluginSpec);
+
+private:
+    QString m_directory;
+    //! Files mapped for the restored plugins
+    QHash<PluginSpec *, QFile *> m_mapped;
+    //! Snapshots saved or invalidated while the previous one was mapped
+    QHash<PluginSpec *, QString> m_pending;
+};
+
+} // namespace PluginLoader
+
+#endif // PLUGINLOADER_SNAPSHOTSTORE_H
@@ -0,0 +1,152 @@
+#include "arena.h"
+
+#include <QtCore/QThreadStorage>
+
+using namespace Utils;
+
+namespace {
+    Q_GLOBAL_STATIC(QThreadStorage<Arena *>, threadArenas)
+
+    struct DestructorEntry
+    {
+        void *object;
+        void (*destroy)(void *);
+        DestructorEntry *next;
+    };
+}
+
+/*!
+    Constructs an arena starting with a chunk of \a chunkSize bytes, later
+    chunks double in size.
+ */
+Arena::Arena(int chunkSize)
+    : m_position(0),
+    m_end(0),
+    m_chunk(-1),
+    m_destructors(0),
+    m_nextChunkSize(size_t(qBound(64, chunkSize, int(MaxChunkSize)))),
+    m_bytesReserved(0),
+    m_chunkAllocations(0)
+{
+    allocateSlow(0, 1);
+}
+
+Arena::~Arena()
+{
+    reset();
+    foreach (const Chunk &chunk, m_chunks)
+        qFree(chunk.begin);
+}
+
+/*!
+    \return the arena of the calling thread, deleted when the thread
+    finishes
+ */
+Arena *Arena::current()
+{
+    QThreadStorage<Arena *> *arenas = threadArenas();
+    if (!arenas->hasLocalData())
+        arenas->setLocalData(new Arena);
+    return arenas->localData();
+}
+
+//! \return the position to rewind() to, marks are rewound newest first
+ArenaMark Arena::mark() const
+{
+    ArenaMark mark;
+    mark.m_chunk = m_chunk;
+    mark.m_position = m_position;
+    mark.m_destructors = m_destructors;
+    return mark;
+}
+
+/*!
+    Destructs the objects created after \a mark and makes their memory
+    available again. Regular chunks are kept for reuse, the chunks of large
+    allocations are freed.
+ */
+void Arena::rewind(const ArenaMark &mark)
+{
+    Q_ASSERT(mark.m_chunk >= 0 && mark.m_chunk <= m_chunk);
+
+    while (m_destructors != mark.m_destructors) {
+        DestructorEntry *const entry =
+            static_cast<DestructorEntry *>(m_destructors);
+        m_destructors = entry->next;
+        entry->destroy(entry->object);
+    }
+
+    for (int i = m_chunks.size() - 1; i > mark.m_chunk; --i) {
+        const Chunk &chunk = m_chunks.at(i);
+        if (chunk.end - chunk.begin > MaxChunkSize) {
+            m_bytesReserved -= chunk.end - chunk.begin;
+            qFree(chunk.begin);
+            m_chunks.remove(i);
+        }
+    }
+
+    m_chunk = mark.m_chunk;
+    m_position = mark.m_position;
+    m_end = m_chunks.at(m_chunk).end;
+}
+
+//! Drops everything allocated in the arena.
+void Arena::reset()
+{
+    ArenaMark start;
+    start.m_position = m_chunks.first().begin;
+    rewind(start);
+}
+
+//! \return the size of the chunks held by the arena
+qint64 Arena::bytesReserved() const
+{
+    return m_bytesReserved;
+}
+
+//! \return the number of chunks allocated from the heap so far
+int Arena::chunkAllocations() const
+{
+    return m_chunkAllocations;
+}
+
+// Continues in the next chunk, allocating it if needed
+void *Arena::allocateSlow(size_t size, size_t alignment)
+{
+    const size_t needed = size + alignment - 1;
+
+    // Chunks kept by rewind()
+    while (m_chunk + 1 < m_chunks.size()) {
+        const Chunk &chunk = m_chunks.at(++m_chunk);
+        m_position = chunk.begin;
+        m_end = chunk.end;
+        if (size_t(m_end - m_position) >= needed)
+            return allocate(size, alignment);
+    }
+
+    Chunk chunk;
+    const size_t chunkSize = qMax(m_nextChunkSize, needed);
+    chunk.begin = static_cast<char *>(qMalloc(chunkSize));
+    Q_CHECK_PTR(chunk.begin);
+    chunk.end = chunk.begin + chunkSize;
+    m_chunks.append(chunk);
+    m_chunk = m_chunks.size() - 1;
+    m_bytesReserved += chunkSize;
+    ++m_chunkAllocations;
+    if (chunkSize == m_nextChunkSize)
+        m_nextChunkSize = qMin(m_nextChunkSize * 2, size_t(MaxChunkSize));
+
+    m_position = chunk.begin;
+    m_end = chunk.end;
+    return allocate(size, alignment);
+}
+
+void Arena::addDestructor(void *object, void (*destroy)(void *))
+{
+    DestructorEntry *const entry = static_cast<DestructorEntry *>(
+            allocate(sizeof(DestructorEntry), Q_ALIGNOF(DestructorEntry)));
+    entry->object = object;
+    entry->destroy = destroy;
+    entry->next = static_cast<DestructorEntry *>(m_destructors);
+    m_destructors = entry;
+}
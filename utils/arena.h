@@ -0,0 +1,246 @@
+#ifndef UTILS_ARENA_H
+#define UTILS_ARENA_H
+
+#include <QtCore/QVector>
+
+#include <cstddef>
+#include <new>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class Arena;
+
+/*!
+    \brief Position in an Arena to return to by Arena::rewind().
+ */
+class ArenaMark
+{
+public:
+    ArenaMark() : m_chunk(0), m_position(0), m_destructors(0) {}
+
+private:
+    friend class Arena;
+
+    int m_chunk;
+    char *m_position;
+    void *m_destructors;
+};
+
+/*!
+    \brief Monotonic allocator for memory freed all at once.
+
+    The arena hands out memory by bumping a pointer through large chunks,
+    single allocations are never freed. Instead rewind() or reset() drop
+    everything allocated after a mark at once, keeping the chunks for the
+    next use. Thus a request allocating many small objects costs a few
+    mallocs of the first requests only.
+
+    Objects made by create() are destructed when their memory is dropped,
+    in reverse order. An arena must only be used by one thread, current()
+    gives each thread its own.
+    \sa ArenaScope, ArenaAllocator
+ */
+class UTILS_EXPORT Arena
+{
+    Q_DISABLE_COPY(Arena)
+
+public:
+    enum {
+        DefaultChunkSize = 4096,
+        //! Chunks grow up to this size, larger allocations get their own
+        MaxChunkSize = 1024 * 1024
+    };
+
+    explicit Arena(int chunkSize = DefaultChunkSize);
+    ~Arena();
+
+    static Arena *current();
+
+    inline void *allocate(size_t size, size_t alignment = sizeof(double));
+
+    template <typename T> T *create();
+    template <typename T, typename A1> T *create(const A1 &a1);
+    template <typename T, typename A1, typename A2>
+    T *create(const A1 &a1, const A2 &a2);
+    template <typename T, typename A1, typename A2, typename A3>
+    T *create(const A1 &a1, const A2 &a2, const A3 &a3);
+
+    ArenaMark mark() const;
+    void rewind(const ArenaMark &mark);
+    void reset();
+
+    qint64 bytesReserved() const;
+    int chunkAllocations() const;
+
+private:
+    struct Chunk
+    {
+        char *begin;
+        char *end;
+    };
+
+    void *allocateSlow(size_t size, size_t alignment);
+    void addDestructor(void *object, void (*destroy)(void *));
+    template <typename T> T *registered(T *object);
+    template <typename T> static void destroy(void *object);
+
+private:
+    char *m_position;
+    char *m_end;
+    int m_chunk;
+    QVector<Chunk> m_chunks;
+    //! Newest object to destruct, the list lives in the arena
+    void *m_destructors;
+    size_t m_nextChunkSize;
+    qint64 m_bytesReserved;
+    int m_chunkAllocations;
+};
+
+/*!
+    \brief Drops the memory allocated in an Arena during its lifetime.
+
+    \code
+    void Handler::handle(const Request &request)
+    {
+        Utils::ArenaScope scope;
+        Parser *parser = scope.arena()->create<Parser>(request);
+        ...
+    } // parser is destructed, its memory reused by the next request
+    \endcode
+ */
+class UTILS_EXPORT ArenaScope
+{
+    Q_DISABLE_COPY(ArenaScope)
+
+public:
+    explicit ArenaScope(Arena *arena = Arena::current())
+        : m_arena(arena), m_mark(arena->mark()) {}
+    ~ArenaScope() { m_arena->rewind(m_mark); }
+
+    Arena *arena() const { return m_arena; }
+
+private:
+    Arena *const m_arena;
+    const ArenaMark m_mark;
+};
+
+/*!
+    \brief Standard allocator taking the memory from an Arena.
+
+    Makes the standard containers allocate from an arena, e.g. \c
+    std::vector<int, Utils::ArenaAllocator<int> >. The memory of elements
+    removed or of grown buffers is only reused after the arena is rewound,
+    so reserve() the expected size. The container must be destructed before
+    the arena drops its memory.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    ArenaAllocator() : m_arena(Arena::current()) {}
+    explicit ArenaAllocator(Arena *arena) : m_arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    pointer allocate(size_type count, const void * = 0)
+    {
+        return static_cast<pointer>(
+                m_arena->allocate(count * sizeof(T), Q_ALIGNOF(T)));
+    }
+    void deallocate(pointer, size_type) {}
+
+    void construct(pointer p, const T &value) { new (p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+    size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+    Arena *arena() const { return m_arena; }
+
+private:
+    Arena *m_arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{ return a.arena() == b.arena(); }
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{ return a.arena() != b.arena(); }
+
+/*!
+    \return \a size bytes aligned to \a alignment, which is a power of two
+ */
+inline void *Arena::allocate(size_t size, size_t alignment)
+{
+    Q_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    const quintptr position = (quintptr(m_position) + alignment - 1)
+        & ~quintptr(alignment - 1);
+    if (position + size > quintptr(m_end))
+        return allocateSlow(size, alignment);
+    m_position = reinterpret_cast<char *>(position + size);
+    return reinterpret_cast<void *>(position);
+}
+
+template <typename T>
+void Arena::destroy(void *object)
+{
+    static_cast<T *>(object)->~T();
+}
+
+// Objects without destructor, e.g. of primitive types, need no entry
+template <typename T>
+T *Arena::registered(T *object)
+{
+    if (QTypeInfo<T>::isComplex)
+        addDestructor(object, &Arena::destroy<T>);
+    return object;
+}
+
+//! Constructs a T in the arena, it is destructed when the arena drops it.
+template <typename T>
+T *Arena::create()
+{
+    return registered(new (allocate(sizeof(T), Q_ALIGNOF(T))) T);
+}
+
+template <typename T, typename A1>
+T *Arena::create(const A1 &a1)
+{
+    return registered(new (allocate(sizeof(T), Q_ALIGNOF(T))) T(a1));
+}
+
+template <typename T, typename A1, typename A2>
+T *Arena::create(const A1 &a1, const A2 &a2)
+{
+    return registered(new (allocate(sizeof(T), Q_ALIGNOF(T))) T(a1, a2));
+}
+
+template <typename T, typename A1, typename A2, typename A3>
+T *Arena::create(const A1 &a1, const A2 &a2, const A3 &a3)
+{
+    return registered(new (allocate(sizeof(T), Q_ALIGNOF(T)))
+            T(a1, a2, a3));
+}
+
+} // namespace Utils
+
+#endif // UTILS_ARENA_H
@@ -367,6 +367,23 @@ QMap<UniqueId, Configuration::VersionCompareFunction>
     Configuration::Data::versionCompareFunctions =
         QMap<UniqueId, Configuration::VersionCompareFunction>();
 
+void *Configuration::Data::operator new(size_t size)
+{
+    Q_ASSERT(size == sizeof(Data));
+    if (ObjectPool<Data> *const pool = dataPool())
+        return pool->allocate();
+    // The pool is destructed already
+    return ::operator new(size);
+}
+
+void Configuration::Data::operator delete(void *data)
+{
+    // Once the pool is destructed its memory is freed, data made after
+    // that is left to the end of the process
+    if (ObjectPool<Data> *const pool = dataPool())
+        pool->release(data);
+}
+
 bool Configuration::Data::satisfiesVersion(Type relation, const Version
         &version) const
 {
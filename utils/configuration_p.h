@@ -7,12 +7,19 @@
 #include <QtCore/QMap>
 #include <QtCore/QSharedData>
 
+#include "objectpool.h"
+
 namespace Utils {
 
 class Configuration::Data : public QSharedData
 {
     friend class Configuration;
 
+public:
+    // Expressions are made and dropped in large numbers
+    static void *operator new(size_t size);
+    static void operator delete(void *data);
+
 private:
     Data(const Resource &resource);
     Data(const Configuration &left, Type type, const Configuration &right);
@@ -24,6 +31,10 @@ private:
 
 private:
     static QMap<UniqueId, VersionCompareFunction> versionCompareFunctions;
+    // Memory of the data of all configurations. Made on first use, so
+    // configurations made during static initialization find it alive. Data
+    // is private to Configuration, thus the accessor is a static member.
+    Q_GLOBAL_STATIC(ObjectPool<Data>, dataPool)
     const Type type;
     const Configuration left;
     const Configuration right;
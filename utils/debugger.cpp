@@ -8,6 +8,16 @@
 # include <cxxabi.h>
 #endif
 
+#if defined(Q_OS_WIN)
+# include <windows.h>
+# include <psapi.h>
+#elif defined(Q_OS_MAC)
+# include <mach/mach.h>
+#elif defined(Q_OS_LINUX)
+# include <unistd.h>
+#endif
+
+#include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QRegExp>
 
@@ -86,3 +96,35 @@ QString Debugger::backtrace()
     return ERR_RETVAL;
 #endif
 }
+
+/*!
+    Returns the resident memory size of the process in bytes, -1 if it
+    cannot be determined on this platform.
+ */
+qint64 Debugger::residentMemorySize()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return -1;
+    return counters.WorkingSetSize;
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return -1;
+    return info.resident_size;
+#elif defined(Q_OS_LINUX)
+    // Second field is the resident set size in pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readLine().split(' ');
+    if (fields.count() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
@@ -11,6 +11,7 @@ class UTILS_EXPORT Debugger
 {
 public:
     static QString backtrace();
+    static qint64 residentMemorySize();
 };
 
 } // namespace Utils
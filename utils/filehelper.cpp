@@ -4,12 +4,62 @@
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QStringBuilder>
+#include <QtCore/QStringList>
 #include <QtCore/QTextStream>
 #include <QtGui/QApplication>
 #include <QtGui/QMessageBox>
+#include <QtGui/QRegExpValidator>
 
 using namespace Utils;
 
+namespace {
+    // Compiled once, callers get cheap copies
+    Q_GLOBAL_STATIC_WITH_ARGS(QRegExp, fileNameRegExp,
+            (QLatin1String("((^[^\\|<>?:*/\\\\\"\\.\\s]+[^\\|<>?:*/\\\\\"]*"
+                    "[^\\|<>?:*/\\\\\"\\.\\s]{1}$)|(^[^\\|<>?:*/\\\\\"\\.\\s]+$))")))
+
+#ifdef Q_OS_WIN
+    Q_GLOBAL_STATIC_WITH_ARGS(QRegExp, locationRegExp,
+            (QLatin1String("^([a-zA-Z]:[\\\\])?[^?:*|\"/]*$")))
+#else
+    Q_GLOBAL_STATIC_WITH_ARGS(QRegExp, locationRegExp,
+            (QLatin1String("^[^?:*|\"\\\\]*$")))
+#endif
+
+    // Characters fileNameValidation() rejects anywhere in the name
+    inline bool isForbiddenFileNameChar(ushort c)
+    {
+        switch (c) {
+        case '|': case '<': case '>': case '?': case ':':
+        case '*': case '/': case '\\': case '"':
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Characters fileNameValidation() rejects at the start and end
+    inline bool isForbiddenFileNameBoundary(const QChar &c)
+    {
+        return c == QLatin1Char('.') || c.isSpace();
+    }
+
+    inline bool isForbiddenLocationChar(ushort c)
+    {
+        switch (c) {
+        case '?': case ':': case '*': case '|': case '"':
+#ifdef Q_OS_WIN
+        case '/':
+#else
+        case '\\':
+#endif
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
 /*!
     \class Utils::FileHelper
     \brief Helps with common operations on files and file names
@@ -223,18 +273,117 @@ QString FileHelper::buildPluginName(const QString &path, const QString &name)
 }
 
 //! Regexp to validate file name
+/*!
+    The expression is compiled once, prefer isValidFileName() for checking
+    many names and fileNameValidator() for line edits.
+ */
 QRegExp FileHelper::fileNameValidation()
 {
-    return QRegExp("((^[^\\|<>?:*/\\\\\"\\.\\s]+[^\\|<>?:*/\\\\\"]*"
-            "[^\\|<>?:*/\\\\\"\\.\\s]{1}$)|(^[^\\|<>?:*/\\\\\"\\.\\s]+$))");
+    return *fileNameRegExp();
 }
 
 //! Regexp to validate file path
+/*!
+    \sa isValidLocation(), locationValidator()
+ */
 QRegExp FileHelper::locationValidation()
 {
+    return *locationRegExp();
+}
+
+/*!
+    \brief Validator accepting the names matching fileNameValidation()
+
+    The validator is shared by all callers and owned by the application,
+    do not delete it. Call from the GUI thread only.
+ */
+const QValidator *FileHelper::fileNameValidator()
+{
+    static QRegExpValidator *validator = 0;
+    if (validator == 0)
+        validator = new QRegExpValidator(*fileNameRegExp(), qApp);
+    return validator;
+}
+
+/*!
+    \brief Validator accepting the paths matching locationValidation()
+
+    The validator is shared by all callers and owned by the application,
+    do not delete it. Call from the GUI thread only.
+ */
+const QValidator *FileHelper::locationValidator()
+{
+    static QRegExpValidator *validator = 0;
+    if (validator == 0)
+        validator = new QRegExpValidator(*locationRegExp(), qApp);
+    return validator;
+}
+
+/*!
+    \brief Checks \a fileName without a regular expression
+
+    Accepts exactly the names fileNameValidation() matches: not empty, none
+    of the characters |<>?:*\/\" and neither starting nor ending with a dot
+    or white space. Thread-safe.
+ */
+bool FileHelper::isValidFileName(const QString &fileName)
+{
+    const int length = fileName.length();
+    if (length == 0)
+        return false;
+
+    const QChar *data = fileName.constData();
+    if (isForbiddenFileNameBoundary(data[0])
+            || isForbiddenFileNameBoundary(data[length - 1]))
+        return false;
+
+    for (int i = 0; i < length; ++i) {
+        if (isForbiddenFileNameChar(data[i].unicode()))
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Checks \a location without a regular expression
+
+    Accepts exactly the paths locationValidation() matches. Thread-safe.
+ */
+bool FileHelper::isValidLocation(const QString &location)
+{
+    const QChar *data = location.constData();
+    const int length = location.length();
+    int i = 0;
+
 #ifdef Q_OS_WIN
-    return QRegExp("^([a-zA-Z]:[\\\\])?[^?:*|\"/]*$");
-#else
-    return QRegExp("^[^?:*|\"\\\\]*$");
+    // Optional drive, e.g. "C:\"
+    if (length >= 3 && data[1] == QLatin1Char(':')
+            && data[2] == QLatin1Char('\\')) {
+        const ushort drive = data[0].unicode();
+        if ((drive >= 'a' && drive <= 'z') || (drive >= 'A' && drive <= 'Z'))
+            i = 3;
+    }
 #endif
+
+    for (; i < length; ++i) {
+        if (isForbiddenLocationChar(data[i].unicode()))
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Returns the names from \a fileNames not passing isValidFileName()
+
+    Meant for checking whole directory listings at once, the result is
+    empty when all names are valid.
+ */
+QStringList FileHelper::invalidFileNames(const QStringList &fileNames)
+{
+    QStringList invalid;
+    foreach (const QString &fileName, fileNames) {
+        if (!isValidFileName(fileName))
+            invalid.append(fileName);
+    }
+    return invalid;
 }
@@ -7,6 +7,11 @@
 
 #include "utils_global.h"
 
+QT_BEGIN_NAMESPACE
+class QStringList;
+class QValidator;
+QT_END_NAMESPACE
+
 namespace Utils {
 
 class UTILS_EXPORT FileHelper
@@ -26,6 +31,11 @@ public:
     static QString buildPluginName(const QString &path, const QString &name);
     static QRegExp fileNameValidation();
     static QRegExp locationValidation();
+    static const QValidator *fileNameValidator();
+    static const QValidator *locationValidator();
+    static bool isValidFileName(const QString &fileName);
+    static bool isValidLocation(const QString &location);
+    static QStringList invalidFileNames(const QStringList &fileNames);
 };
 
 } // namespace Utils
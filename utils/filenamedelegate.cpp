@@ -9,7 +9,7 @@ using namespace Utils;
 /*!
  * \class Utils::FileNameDelegate
  * \brief File name validating item delegate
- * \sa FileHelper::fileNameValidation()
+ * \sa FileHelper::fileNameValidator()
  */
 
 //! Constructor
@@ -27,8 +27,7 @@ void FileNameDelegate::setEditorData(QWidget *editor, const QModelIndex &index)
     Q_ASSERT(index.isValid());
     Q_ASSERT(lineEdit);
 
-    lineEdit->setValidator(new QRegExpValidator(
-            FileHelper::fileNameValidation(), lineEdit));
+    lineEdit->setValidator(FileHelper::fileNameValidator());
 
     lineEdit->setText(index.data(Qt::DisplayRole).toString());
 }
@@ -0,0 +1,215 @@
+#include "future.h"
+#include "taskscheduler.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+using namespace Utils;
+
+namespace {
+
+// Event carrying a runnable to the GUI thread
+class RunnableEvent : public QEvent
+{
+public:
+    RunnableEvent(QRunnable *runnable)
+        : QEvent(eventType()), runnable(runnable) {}
+
+    static QEvent::Type eventType()
+    {
+        static const QEvent::Type type =
+            QEvent::Type(QEvent::registerEventType());
+        return type;
+    }
+
+    QRunnable *const runnable;
+};
+
+class GuiThreadExecutor : public QObject, public Executor
+{
+public:
+    GuiThreadExecutor()
+    {
+        if (QCoreApplication::instance() != 0)
+            moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    void execute(QRunnable *runnable)
+    {
+        QCoreApplication::postEvent(this, new RunnableEvent(runnable));
+    }
+
+protected:
+    void customEvent(QEvent *event)
+    {
+        if (event->type() != RunnableEvent::eventType())
+            return;
+        QRunnable *const runnable = static_cast<RunnableEvent *>(event)->runnable;
+        const bool autoDelete = runnable->autoDelete();
+        runnable->run();
+        if (autoDelete)
+            delete runnable;
+    }
+};
+
+class WorkerPoolExecutor : public Executor
+{
+public:
+    void execute(QRunnable *runnable)
+    {
+        TaskScheduler::globalInstance()->start(runnable);
+    }
+};
+
+class IoPoolExecutor : public Executor
+{
+public:
+    IoPoolExecutor()
+    {
+        // Blocking calls mostly wait, so more threads than cores pay off
+        m_pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), 1) * 4);
+    }
+
+    ~IoPoolExecutor()
+    {
+        m_pool.waitForDone();
+    }
+
+    void execute(QRunnable *runnable)
+    {
+        m_pool.start(runnable);
+    }
+
+private:
+    QThreadPool m_pool;
+};
+
+Q_GLOBAL_STATIC(GuiThreadExecutor, guiThreadExecutor)
+Q_GLOBAL_STATIC(WorkerPoolExecutor, workerPoolExecutor)
+Q_GLOBAL_STATIC(IoPoolExecutor, ioPoolExecutor)
+
+} // namespace
+
+/*!
+    \return the executor running continuations by the event loop of the GUI
+    thread, e.g. to update widgets with the result. Runs nothing while the
+    event loop isn't running.
+ */
+Executor *Executor::guiThread()
+{
+    return guiThreadExecutor();
+}
+
+/*!
+    \return the executor running continuations by the workers of
+    TaskScheduler::globalInstance(), for computations. The continuations must
+    not block.
+ */
+Executor *Executor::workerPool()
+{
+    return workerPoolExecutor();
+}
+
+/*!
+    \return the executor running continuations by a thread pool for blocking
+    calls, e.g. file and network I/O, so they don't stall the workers.
+ */
+Executor *Executor::ioPool()
+{
+    return ioPoolExecutor();
+}
+
+FutureStateBase::FutureStateBase()
+    : m_state(Running)
+{
+}
+
+FutureStateBase::~FutureStateBase()
+{
+    // Futures that never finish drop their continuations
+    foreach (const Continuation &continuation, m_continuations) {
+        if (continuation.runnable->autoDelete())
+            delete continuation.runnable;
+    }
+}
+
+FutureStateBase::State FutureStateBase::state() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_state;
+}
+
+QString FutureStateBase::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+void FutureStateBase::waitForFinished() const
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_state == Running)
+        m_finished.wait(&m_mutex);
+}
+
+/*!
+    Finishes the future by \a state, storing \a value when it succeeded.
+    \return false if it was finished before
+ */
+bool FutureStateBase::complete(State state, const QString &errorString,
+        const void *value)
+{
+    Q_ASSERT(state != Running);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_state != Running)
+        return false;
+    if (state == Succeeded)
+        storeValue(value);
+    m_state = state;
+    m_errorString = errorString;
+    const QList<Continuation> continuations = m_continuations;
+    m_continuations.clear();
+    m_finished.wakeAll();
+    locker.unlock();
+
+    foreach (const Continuation &continuation, continuations)
+        dispatch(continuation);
+    return true;
+}
+
+/*!
+    Runs \a continuation by \a executor once the future finished, at once if
+    it is finished already.
+ */
+void FutureStateBase::addContinuation(FutureContinuation *continuation,
+        Executor *executor)
+{
+    Continuation entry;
+    entry.runnable = continuation;
+    entry.executor = executor;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_state == Running) {
+        m_continuations.append(entry);
+        return;
+    }
+    locker.unlock();
+    dispatch(entry);
+}
+
+// Called while the state is alive, i.e. by a holder of a strong reference
+void FutureStateBase::dispatch(const Continuation &continuation)
+{
+    continuation.runnable->sourceFinished();
+    if (continuation.executor != 0) {
+        continuation.executor->execute(continuation.runnable);
+        return;
+    }
+    const bool autoDelete = continuation.runnable->autoDelete();
+    continuation.runnable->run();
+    if (autoDelete)
+        delete continuation.runnable;
+}
@@ -0,0 +1,389 @@
+#ifndef UTILS_FUTURE_H
+#define UTILS_FUTURE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+/*!
+    \brief Runs the continuations of futures.
+
+    The executors of the application are given by the static methods, a
+    continuation without executor runs on the thread finishing the future.
+ */
+class UTILS_EXPORT Executor
+{
+public:
+    virtual ~Executor() {}
+
+    //! Runs \a runnable, deletes it afterwards if its autoDelete() is set.
+    virtual void execute(QRunnable *runnable) = 0;
+
+    static Executor *guiThread();
+    static Executor *workerPool();
+    static Executor *ioPool();
+};
+
+/*! \cond __pimpl */
+// Runnable waiting for a future to finish
+class FutureContinuation : public QRunnable
+{
+public:
+    //! Called once the future finished, before the continuation is dispatched
+    virtual void sourceFinished() {}
+};
+
+class UTILS_EXPORT FutureStateBase
+{
+    Q_DISABLE_COPY(FutureStateBase)
+
+public:
+    enum State {
+        Running,
+        Succeeded,
+        Failed,
+        Canceled
+    };
+
+    FutureStateBase();
+    virtual ~FutureStateBase();
+
+    State state() const;
+    QString errorString() const;
+    void waitForFinished() const;
+
+    bool complete(State state, const QString &errorString = QString(),
+            const void *value = 0);
+    void addContinuation(FutureContinuation *continuation, Executor *executor);
+
+protected:
+    //! Called with the mutex locked when the future succeeds
+    virtual void storeValue(const void *value) = 0;
+
+protected:
+    mutable QMutex m_mutex;
+
+private:
+    struct Continuation
+    {
+        FutureContinuation *runnable;
+        Executor *executor;
+    };
+
+    static void dispatch(const Continuation &continuation);
+
+private:
+    mutable QWaitCondition m_finished;
+    State m_state;
+    QString m_errorString;
+    QList<Continuation> m_continuations;
+};
+
+template <typename T>
+class FutureState : public FutureStateBase
+{
+public:
+    FutureState() : m_value() {}
+
+    T value() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_value;
+    }
+
+protected:
+    void storeValue(const void *value)
+    {
+        m_value = *static_cast<const T *>(value);
+    }
+
+private:
+    T m_value;
+};
+/*! \endcond */
+
+template <typename T> class Promise;
+namespace Internal {
+template <typename T, typename R, typename Callable>
+class ContinuationRunnable;
+}
+
+/*!
+    \brief Result of an asynchronous operation, available later.
+
+    Futures are cheap to copy, all copies refer to the same result. The
+    continuations added by then() run once the future finished, whether it
+    succeeded, failed or was canceled, on the given Executor. Canceling a
+    future finishes it at once; the producer may notice by
+    Promise::isCanceled() and stop its work, its result is dropped.
+ */
+template <typename T>
+class Future
+{
+public:
+    //! Constructs a future that is canceled already.
+    Future() : d(new FutureState<T>) { d->complete(FutureStateBase::Canceled); }
+
+    bool isFinished() const { return d->state() != FutureStateBase::Running; }
+    bool isSucceeded() const { return d->state() == FutureStateBase::Succeeded; }
+    bool isCanceled() const { return d->state() == FutureStateBase::Canceled; }
+    bool hasError() const { return d->state() == FutureStateBase::Failed; }
+    QString errorString() const { return d->errorString(); }
+
+    //! Blocks until finished, never call it on the thread of the producer.
+    void waitForFinished() const { d->waitForFinished(); }
+
+    /*!
+        Waits for the future to finish.
+        \return the result, a default constructed value if the future didn't
+        succeed
+     */
+    T result() const
+    {
+        d->waitForFinished();
+        return d->value();
+    }
+
+    //! Finishes the future as canceled unless it's finished already.
+    void cancel() { d->complete(FutureStateBase::Canceled); }
+
+    template <typename R>
+    Future<R> then(R (*function)(const Future<T> &),
+            Executor *executor = 0) const;
+    template <typename R, typename C>
+    Future<R> then(C *object, R (C::*method)(const Future<T> &),
+            Executor *executor = 0) const;
+
+    static Future<QList<T> > whenAll(const QList<Future<T> > &futures);
+
+private:
+    friend class Promise<T>;
+    template <typename U> friend class Future;
+    template <typename U, typename R, typename Callable>
+    friend class Internal::ContinuationRunnable;
+
+    explicit Future(const QSharedPointer<FutureState<T> > &state) : d(state) {}
+
+    QSharedPointer<FutureState<T> > d;
+};
+
+/*!
+    \brief Producer side of a Future.
+
+    A promise should always be finished by setResult() or setError(),
+    otherwise waiting for its future never returns.
+ */
+template <typename T>
+class Promise
+{
+public:
+    Promise() : d(new FutureState<T>) {}
+
+    Future<T> future() const { return Future<T>(d); }
+
+    //! Finishes the future successfully, ignored if it's finished already.
+    void setResult(const T &value)
+    {
+        d->complete(FutureStateBase::Succeeded, QString(), &value);
+    }
+
+    //! Finishes the future with an error, ignored if it's finished already.
+    void setError(const QString &errorString)
+    {
+        d->complete(FutureStateBase::Failed, errorString);
+    }
+
+    void cancel() { d->complete(FutureStateBase::Canceled); }
+
+    //! \return true if the consumer lost interest, work can be stopped
+    bool isCanceled() const { return d->state() == FutureStateBase::Canceled; }
+
+private:
+    QSharedPointer<FutureState<T> > d;
+};
+
+/*! \cond __pimpl */
+namespace Internal {
+
+/*
+    Finishes the promise of a continuation by the value of the callable. The
+    source state owns the continuation, so it's referenced weakly until it
+    finished; a source that never finishes is freed with its continuations.
+*/
+template <typename T, typename R, typename Callable>
+class ContinuationRunnable : public FutureContinuation
+{
+public:
+    ContinuationRunnable(const QSharedPointer<FutureState<T> > &source,
+            const Promise<R> &promise, const Callable &callable)
+        : m_pendingSource(source), m_promise(promise), m_callable(callable) {}
+
+    void sourceFinished()
+    {
+        m_source = m_pendingSource.toStrongRef();
+    }
+
+    void run()
+    {
+        // Canceled before the source finished
+        if (m_promise.isCanceled())
+            return;
+        Q_ASSERT(!m_source.isNull());
+        m_promise.setResult(m_callable(Future<T>(m_source)));
+    }
+
+private:
+    QWeakPointer<FutureState<T> > m_pendingSource;
+    QSharedPointer<FutureState<T> > m_source;
+    Promise<R> m_promise;
+    Callable m_callable;
+};
+
+template <typename T, typename R>
+class FunctionCall
+{
+public:
+    FunctionCall(R (*function)(const Future<T> &)) : m_function(function) {}
+    R operator()(const Future<T> &future) const { return m_function(future); }
+
+private:
+    R (*m_function)(const Future<T> &);
+};
+
+template <typename T, typename R, typename C>
+class MethodCall
+{
+public:
+    MethodCall(C *object, R (C::*method)(const Future<T> &))
+        : m_object(object), m_method(method) {}
+    R operator()(const Future<T> &future) const
+    { return (m_object->*m_method)(future); }
+
+private:
+    C *m_object;
+    R (C::*m_method)(const Future<T> &);
+};
+
+// Collects the results once the last of the futures finished
+template <typename T>
+class WhenAllState
+{
+public:
+    WhenAllState(int count) : sources(count), remaining(count) {}
+
+    //! Set by the continuations as their futures finish
+    QVector<QSharedPointer<FutureState<T> > > sources;
+    QAtomicInt remaining;
+    Promise<QList<T> > promise;
+};
+
+// Like ContinuationRunnable, references its future weakly until it finished
+template <typename T>
+class WhenAllRunnable : public FutureContinuation
+{
+public:
+    WhenAllRunnable(const QSharedPointer<WhenAllState<T> > &state,
+            const QSharedPointer<FutureState<T> > &source, int index)
+        : m_state(state), m_source(source), m_index(index) {}
+
+    void sourceFinished()
+    {
+        m_state->sources[m_index] = m_source.toStrongRef();
+    }
+
+    void run()
+    {
+        if (m_state->remaining.deref())
+            return;
+
+        QList<T> results;
+        foreach (const QSharedPointer<FutureState<T> > &source,
+                m_state->sources) {
+            if (source->state() == FutureStateBase::Canceled) {
+                m_state->promise.cancel();
+                return;
+            }
+            if (source->state() == FutureStateBase::Failed) {
+                m_state->promise.setError(source->errorString());
+                return;
+            }
+            results.append(source->value());
+        }
+        m_state->promise.setResult(results);
+    }
+
+private:
+    QSharedPointer<WhenAllState<T> > m_state;
+    QWeakPointer<FutureState<T> > m_source;
+    const int m_index;
+};
+
+} // namespace Internal
+/*! \endcond */
+
+/*!
+    Calls \a function with this future once it finished, on \a executor.
+    \return the future of the value returned by \a function
+ */
+template <typename T>
+template <typename R>
+Future<R> Future<T>::then(R (*function)(const Future<T> &),
+        Executor *executor) const
+{
+    Promise<R> promise;
+    d->addContinuation(new Internal::ContinuationRunnable<T, R,
+            Internal::FunctionCall<T, R> >(d, promise,
+                Internal::FunctionCall<T, R>(function)), executor);
+    return promise.future();
+}
+
+/*!
+    Calls \a method of \a object with this future once it finished, on \a
+    executor. The object has to exist until then.
+    \return the future of the value returned by \a method
+ */
+template <typename T>
+template <typename R, typename C>
+Future<R> Future<T>::then(C *object, R (C::*method)(const Future<T> &),
+        Executor *executor) const
+{
+    Promise<R> promise;
+    d->addContinuation(new Internal::ContinuationRunnable<T, R,
+            Internal::MethodCall<T, R, C> >(d, promise,
+                Internal::MethodCall<T, R, C>(object, method)), executor);
+    return promise.future();
+}
+
+/*!
+    \return the future of the results of all \a futures, in their order. It
+    fails with the first error or is canceled if one of them is.
+ */
+template <typename T>
+Future<QList<T> > Future<T>::whenAll(const QList<Future<T> > &futures)
+{
+    QSharedPointer<Internal::WhenAllState<T> > state(
+            new Internal::WhenAllState<T>(futures.size()));
+    if (futures.isEmpty()) {
+        state->promise.setResult(QList<T>());
+        return state->promise.future();
+    }
+    for (int i = 0; i < futures.size(); ++i) {
+        const QSharedPointer<FutureState<T> > &source = futures.at(i).d;
+        source->addContinuation(
+                new Internal::WhenAllRunnable<T>(state, source, i), 0);
+    }
+    return state->promise.future();
+}
+
+} // namespace Utils
+
+#endif // UTILS_FUTURE_H
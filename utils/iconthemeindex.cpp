@@ -0,0 +1,285 @@
+#include "iconthemeindex.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QSettings>
+
+using namespace Utils;
+
+namespace {
+    const quint32 INDEX_MAGIC = 0x58444954; // "TIDX"
+    const quint32 INDEX_FORMAT = 1;
+
+    //! \return the modification time of \a path, -1 if it doesn't exist
+    qint64 modificationTime(const QString &path)
+    {
+        const QFileInfo info(path);
+        return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+    }
+}
+
+/*! \cond __pimpl */
+namespace Utils {
+
+class IconThemeIndexData : public QSharedData
+{
+public:
+    void stamp(const QString &path)
+    {
+        stamps.insert(path, modificationTime(path));
+    }
+
+    QString themeName;
+    QStringList searchPaths;
+    //! Directory or index.theme -> modification time when the index was built
+    QHash<QString, qint64> stamps;
+    //! Icon name -> files of all sizes, of the first theme having the icon
+    QHash<QString, QStringList> icons;
+};
+
+} // namespace Utils
+/*! \endcond */
+
+IconThemeIndex::IconThemeIndex()
+    : d(new IconThemeIndexData)
+{
+}
+
+IconThemeIndex::IconThemeIndex(const IconThemeIndex &other)
+    : d(other.d)
+{
+}
+
+IconThemeIndex &IconThemeIndex::operator=(const IconThemeIndex &other)
+{
+    d = other.d;
+    return *this;
+}
+
+IconThemeIndex::~IconThemeIndex()
+{
+}
+
+/*!
+    Indexes the icons of \a themeName and the themes it inherits, in the
+    order of \a searchPaths like QIcon::fromTheme() looks them up. Only reads
+    the file system, so it can run while the application is starting.
+ */
+IconThemeIndex IconThemeIndex::build(const QStringList &searchPaths,
+        const QString &themeName)
+{
+    IconThemeIndex index;
+    IconThemeIndexData *const d = index.d.data();
+    d->themeName = themeName;
+    d->searchPaths = searchPaths;
+
+    const QStringList nameFilters = QStringList()
+        << QLatin1String("*.png")
+        << QLatin1String("*.svg")
+        << QLatin1String("*.xpm");
+
+    QStringList themes(themeName);
+    QSet<QString> queued;
+    queued.insert(themeName);
+    for (int i = 0; i < themes.size(); ++i) {
+        // An icon of a theme hides the same icon of the themes it inherits
+        QHash<QString, QStringList> themeIcons;
+
+        foreach (const QString &searchPath, searchPaths) {
+            const QString themeDir = searchPath + QLatin1Char('/')
+                + themes.at(i);
+            // Installing the theme later changes the search path
+            d->stamp(searchPath);
+            d->stamp(themeDir);
+
+            const QString indexFile = themeDir + QLatin1String("/index.theme");
+            if (!QFileInfo(indexFile).exists())
+                continue;
+            // Editing its Inherits or Directories changes no directory
+            d->stamp(indexFile);
+            const QSettings indexTheme(indexFile, QSettings::IniFormat);
+
+            const QStringList inherits = indexTheme.value(
+                    QLatin1String("Icon Theme/Inherits")).toStringList();
+            foreach (const QString &inherited, inherits) {
+                if (!queued.contains(inherited)) {
+                    queued.insert(inherited);
+                    themes.append(inherited);
+                }
+            }
+
+            const QStringList directories = indexTheme.value(
+                    QLatin1String("Icon Theme/Directories")).toStringList();
+            foreach (const QString &directory, directories) {
+                const QString path = themeDir + QLatin1Char('/') + directory;
+                d->stamp(path);
+                const QFileInfoList files = QDir(path).entryInfoList(
+                        nameFilters, QDir::Files);
+                foreach (const QFileInfo &file, files) {
+                    themeIcons[file.completeBaseName()]
+                        .append(file.filePath());
+                }
+            }
+        }
+
+        QHash<QString, QStringList>::const_iterator it =
+            themeIcons.constBegin();
+        for (; it != themeIcons.constEnd(); ++it) {
+            if (!d->icons.contains(it.key()))
+                d->icons.insert(it.key(), it.value());
+        }
+    }
+    return index;
+}
+
+/*!
+    Reads the index of \a themeName from \a cacheFileName if it is still up
+    to date, otherwise builds it and writes it to \a cacheFileName for the
+    next start.
+ */
+IconThemeIndex IconThemeIndex::load(const QString &cacheFileName,
+        const QStringList &searchPaths, const QString &themeName)
+{
+    IconThemeIndex index;
+    if (index.read(cacheFileName) && index.d->themeName == themeName
+            && index.d->searchPaths == searchPaths && index.isUpToDate())
+        return index;
+
+    index = build(searchPaths, themeName);
+    QString errorString;
+    if (!index.write(cacheFileName, &errorString)) {
+        qWarning("%s: Icon theme index not saved: %s", Q_FUNC_INFO,
+                qPrintable(errorString));
+    }
+    return index;
+}
+
+/*!
+    Reads the index written by write() from \a fileName.
+    \param errorString possible error message
+    \return true if the index was read
+ */
+bool IconThemeIndex::read(const QString &fileName, QString *errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString != 0)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_7);
+    quint32 magic = 0;
+    quint32 format = 0;
+    in >> magic >> format;
+    if (magic != INDEX_MAGIC || format != INDEX_FORMAT) {
+        if (errorString != 0)
+            *errorString = QLatin1String("unknown file format");
+        return false;
+    }
+
+    QSharedDataPointer<IconThemeIndexData> data(new IconThemeIndexData);
+    in >> data->themeName >> data->searchPaths >> data->stamps
+        >> data->icons;
+    if (in.status() != QDataStream::Ok) {
+        if (errorString != 0)
+            *errorString = QLatin1String("file is truncated");
+        return false;
+    }
+
+    d = data;
+    return true;
+}
+
+/*!
+    Writes the index to \a fileName, creating its directory if needed.
+    \param errorString possible error message
+    \return true if the index was written
+ */
+bool IconThemeIndex::write(const QString &fileName, QString *errorString) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (errorString != 0)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_7);
+    out << INDEX_MAGIC << INDEX_FORMAT << d->themeName << d->searchPaths
+        << d->stamps << d->icons;
+    if (out.status() != QDataStream::Ok || !file.flush()) {
+        if (errorString != 0)
+            *errorString = file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \return false if any directory the index was built from was changed
+    since, e.g. icons were installed or removed
+ */
+bool IconThemeIndex::isUpToDate() const
+{
+    QHash<QString, qint64>::const_iterator it = d->stamps.constBegin();
+    for (; it != d->stamps.constEnd(); ++it) {
+        if (modificationTime(it.key()) != it.value())
+            return false;
+    }
+    return !d->stamps.isEmpty();
+}
+
+QString IconThemeIndex::themeName() const
+{
+    return d->themeName;
+}
+
+QStringList IconThemeIndex::searchPaths() const
+{
+    return d->searchPaths;
+}
+
+bool IconThemeIndex::isEmpty() const
+{
+    return d->icons.isEmpty();
+}
+
+//! \return the number of icon names
+int IconThemeIndex::count() const
+{
+    return d->icons.size();
+}
+
+bool IconThemeIndex::contains(const QString &iconName) const
+{
+    return d->icons.contains(iconName);
+}
+
+//! \return the files of all sizes of \a iconName
+QStringList IconThemeIndex::files(const QString &iconName) const
+{
+    return d->icons.value(iconName);
+}
+
+/*!
+    \return the icon \a iconName made of its files, a null icon if the theme
+    doesn't have it
+ */
+QIcon IconThemeIndex::icon(const QString &iconName) const
+{
+    QIcon icon;
+    foreach (const QString &file, d->icons.value(iconName))
+        icon.addFile(file);
+    return icon;
+}
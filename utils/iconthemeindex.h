@@ -0,0 +1,55 @@
+#ifndef UTILS_ICONTHEMEINDEX_H
+#define UTILS_ICONTHEMEINDEX_H
+
+#include <QtCore/QSharedDataPointer>
+#include <QtCore/QStringList>
+#include <QtGui/QIcon>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class IconThemeIndexData;
+
+/*!
+    \brief Maps the icon names of a freedesktop icon theme to their files.
+
+    Building the index walks the directories of the theme and of the themes
+    it inherits, once. The index is then kept in a cache file together with
+    the modification times of those directories, so later starts read one
+    file and only check the times instead of walking the theme again.
+    Copies of an index share its data.
+ */
+class UTILS_EXPORT IconThemeIndex
+{
+public:
+    IconThemeIndex();
+    IconThemeIndex(const IconThemeIndex &other);
+    IconThemeIndex &operator=(const IconThemeIndex &other);
+    ~IconThemeIndex();
+
+    static IconThemeIndex build(const QStringList &searchPaths,
+            const QString &themeName);
+    static IconThemeIndex load(const QString &cacheFileName,
+            const QStringList &searchPaths, const QString &themeName);
+
+    bool read(const QString &fileName, QString *errorString = 0);
+    bool write(const QString &fileName, QString *errorString = 0) const;
+    bool isUpToDate() const;
+
+    QString themeName() const;
+    QStringList searchPaths() const;
+
+    bool isEmpty() const;
+    int count() const;
+    bool contains(const QString &iconName) const;
+    QStringList files(const QString &iconName) const;
+    QIcon icon(const QString &iconName) const;
+
+private:
+    QSharedDataPointer<IconThemeIndexData> d;
+};
+
+} // namespace Utils
+
+#endif // UTILS_ICONTHEMEINDEX_H
@@ -21,6 +21,21 @@ public:
       */
     virtual void setStatus(const QString &status) = 0;
 
+    /*!
+      set the amount of work done so far, in any unit shared by both values.
+      Monitors that do not show progress ignore it.
+      \param done work already done
+      \param total estimated work in total, 0 if unknown
+      */
+    virtual void setProgress(int done, int total) { Q_UNUSED(done); Q_UNUSED(total); }
+
+    /*!
+      set the estimated time needed to finish the work.
+      Monitors that do not show it ignore it.
+      \param msecs remaining time in milliseconds
+      */
+    virtual void setRemainingTime(qint64 msecs) { Q_UNUSED(msecs); }
+
 };
 
 } // namespace Utils
@@ -0,0 +1,148 @@
+#include "objectpool.h"
+#include "objectpool_p.h"
+
+using namespace Utils;
+
+// The slots of exiting threads go to the depot for the other threads
+ObjectPoolPrivate::ThreadCache::~ThreadCache()
+{
+    pool->drain(this, count);
+}
+
+ObjectPoolPrivate::ObjectPoolPrivate(size_t objectSize)
+    : slotSize((qMax(objectSize, sizeof(Slot)) + ObjectPoolBase::CacheLineSize
+                - 1) & ~size_t(ObjectPoolBase::CacheLineSize - 1))
+{
+}
+
+ObjectPoolPrivate::~ObjectPoolPrivate()
+{
+    foreach (void *block, blocks)
+        qFreeAligned(block);
+}
+
+ObjectPoolPrivate::ThreadCache *ObjectPoolPrivate::threadCache()
+{
+    ThreadCache *cache = caches.localData();
+    if (cache == 0) {
+        cache = new ThreadCache(this);
+        caches.setLocalData(cache);
+    }
+    return cache;
+}
+
+// Gives the cache a batch from the depot, or a new block
+void ObjectPoolPrivate::refill(ThreadCache *cache)
+{
+    Q_ASSERT(cache->count == 0);
+
+    {
+        QMutexLocker locker(&mutex);
+        if (!batches.isEmpty()) {
+            const Batch batch = batches.last();
+            batches.pop_back();
+            cache->slots = batch.slots;
+            cache->count = batch.count;
+            return;
+        }
+    }
+
+    char *const block = static_cast<char *>(qMallocAligned(
+                slotSize * ObjectPoolBase::BatchSize,
+                ObjectPoolBase::CacheLineSize));
+    Q_CHECK_PTR(block);
+    Slot *slots = 0;
+    for (int i = ObjectPoolBase::BatchSize - 1; i >= 0; --i) {
+        Slot *const slot = reinterpret_cast<Slot *>(block + i * slotSize);
+        slot->next = slots;
+        slots = slot;
+    }
+    cache->slots = slots;
+    cache->count = ObjectPoolBase::BatchSize;
+
+    QMutexLocker locker(&mutex);
+    blocks.append(block);
+}
+
+// Moves \a count slots of the cache to the depot, in batches of BatchSize
+void ObjectPoolPrivate::drain(ThreadCache *cache, int count)
+{
+    QVector<Batch> drained;
+    while (count > 0) {
+        Batch batch;
+        batch.slots = cache->slots;
+        batch.count = qMin(count, int(ObjectPoolBase::BatchSize));
+
+        Slot *last = batch.slots;
+        for (int i = 1; i < batch.count; ++i)
+            last = last->next;
+        cache->slots = last->next;
+        last->next = 0;
+
+        cache->count -= batch.count;
+        count -= batch.count;
+        drained.append(batch);
+    }
+
+    if (drained.isEmpty())
+        return;
+    QMutexLocker locker(&mutex);
+    batches += drained;
+}
+
+/*!
+    Prepares a pool of slots of \a objectSize bytes aligned to \a alignment,
+    which must not be larger than CacheLineSize.
+ */
+ObjectPoolBase::ObjectPoolBase(size_t objectSize, size_t alignment)
+    : d_ptr(new ObjectPoolPrivate(objectSize))
+{
+    Q_ASSERT(alignment <= CacheLineSize);
+    Q_UNUSED(alignment);
+}
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+    delete d_ptr;
+}
+
+//! \return memory for one object, taken from the slots of the thread
+void *ObjectPoolBase::allocate()
+{
+    Q_D(ObjectPoolBase);
+    ObjectPoolPrivate::ThreadCache *const cache = d->threadCache();
+    if (cache->count == 0)
+        d->refill(cache);
+
+    ObjectPoolPrivate::Slot *const slot = cache->slots;
+    cache->slots = slot->next;
+    --cache->count;
+    return slot;
+}
+
+/*!
+    Returns \a slot given by allocate() to the pool, from any thread. A
+    thread holding two batches of free slots passes one to the depot.
+ */
+void ObjectPoolBase::release(void *slot)
+{
+    Q_D(ObjectPoolBase);
+    if (slot == 0)
+        return;
+
+    ObjectPoolPrivate::ThreadCache *const cache = d->threadCache();
+    ObjectPoolPrivate::Slot *const free =
+        static_cast<ObjectPoolPrivate::Slot *>(slot);
+    free->next = cache->slots;
+    cache->slots = free;
+    if (++cache->count >= 2 * BatchSize)
+        d->drain(cache, BatchSize);
+}
+
+//! \return the number of slots allocated from the heap so far
+int ObjectPoolBase::slotCount() const
+{
+    Q_D(const ObjectPoolBase);
+    QMutexLocker locker(&d->mutex);
+    return d->blocks.size() * BatchSize;
+}
@@ -0,0 +1,101 @@
+#ifndef UTILS_OBJECTPOOL_H
+#define UTILS_OBJECTPOOL_H
+
+#include <QtCore/QSharedPointer>
+
+#include <new>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class ObjectPoolPrivate;
+
+/*!
+    \brief Recycles the memory of objects of one size.
+
+    Each thread keeps its own list of free slots, so allocate() and
+    release() take no lock. Threads exchange free slots with a shared depot
+    in batches of BatchSize, e.g. when objects made by one thread are
+    released by another. Slots are aligned to cache lines, thus objects
+    used by different threads never share one.
+
+    The pool has to outlive its objects. It keeps its memory until it's
+    destructed.
+    \sa ObjectPool
+ */
+class UTILS_EXPORT ObjectPoolBase
+{
+    Q_DISABLE_COPY(ObjectPoolBase)
+
+public:
+    enum {
+        CacheLineSize = 64,
+        //! Slots moved between a thread and the depot at once
+        BatchSize = 32
+    };
+
+    ObjectPoolBase(size_t objectSize, size_t alignment);
+    ~ObjectPoolBase();
+
+    void *allocate();
+    void release(void *slot);
+
+    int slotCount() const;
+
+private:
+    Q_DECLARE_PRIVATE(ObjectPoolBase)
+    ObjectPoolPrivate *d_ptr;
+};
+
+/*!
+    \brief Pool of objects of type T.
+
+    Objects made by create() are given back by destroy(), or by the
+    Deleter of the QSharedPointer made by createShared(). A class may use a
+    pool for all its instances by its own operator new and operator delete.
+ */
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+    //! Destroys the objects of a QSharedPointer by the pool
+    class Deleter
+    {
+    public:
+        explicit Deleter(ObjectPool *pool) : m_pool(pool) {}
+        void operator()(T *object) const { m_pool->destroy(object); }
+
+    private:
+        ObjectPool *m_pool;
+    };
+
+    ObjectPool() : ObjectPoolBase(sizeof(T), Q_ALIGNOF(T)) {}
+
+    T *create() { return new (allocate()) T; }
+    template <typename A1>
+    T *create(const A1 &a1) { return new (allocate()) T(a1); }
+    template <typename A1, typename A2>
+    T *create(const A1 &a1, const A2 &a2)
+    { return new (allocate()) T(a1, a2); }
+    template <typename A1, typename A2, typename A3>
+    T *create(const A1 &a1, const A2 &a2, const A3 &a3)
+    { return new (allocate()) T(a1, a2, a3); }
+
+    void destroy(T *object)
+    {
+        if (object == 0)
+            return;
+        object->~T();
+        release(object);
+    }
+
+    QSharedPointer<T> createShared()
+    { return QSharedPointer<T>(create(), Deleter(this)); }
+
+    Deleter deleter() { return Deleter(this); }
+};
+
+} // namespace Utils
+
+#endif // UTILS_OBJECTPOOL_H
@@ -0,0 +1,60 @@
+#ifndef UTILS_OBJECTPOOL_P_H
+#define UTILS_OBJECTPOOL_P_H
+/*! \cond __pimpl */
+
+#include <QtCore/QMutex>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QVector>
+
+#include "objectpool.h"
+
+namespace Utils {
+
+class ObjectPoolPrivate
+{
+public:
+    //! Free slot, linked through its own memory
+    struct Slot
+    {
+        Slot *next;
+    };
+
+    //! Chain of free slots
+    struct Batch
+    {
+        Slot *slots;
+        int count;
+    };
+
+    //! Free slots of one thread
+    struct ThreadCache
+    {
+        ThreadCache(ObjectPoolPrivate *pool) : pool(pool), slots(0),
+            count(0) {}
+        ~ThreadCache();
+
+        ObjectPoolPrivate *const pool;
+        Slot *slots;
+        int count;
+    };
+
+    ObjectPoolPrivate(size_t objectSize);
+    ~ObjectPoolPrivate();
+
+    ThreadCache *threadCache();
+    void refill(ThreadCache *cache);
+    void drain(ThreadCache *cache, int count);
+
+    const size_t slotSize;
+    QThreadStorage<ThreadCache *> caches;
+
+    mutable QMutex mutex;
+    //! Free slots given up by the threads, up to BatchSize per batch
+    QVector<Batch> batches;
+    QVector<void *> blocks;
+};
+
+} // namespace Utils
+
+/*! \endcond */
+#endif // UTILS_OBJECTPOOL_P_H
@@ -3,6 +3,8 @@
 
 #include <QtCore/QtGlobal>
 
+#include <new>
+
 namespace Utils {
 
 /*!
@@ -55,6 +57,105 @@ private:
     T *p;
 };
 
+/*! \cond __pimpl */
+namespace Internal {
+    // Fails to compile when the condition is false
+    template <bool> struct StaticCheck;
+    template <> struct StaticCheck<true> { enum { Passed = 1 }; };
+} // namespace Internal
+/*! \endcond */
+
+/*!
+    \brief Pimpl keeping the private object inside the public one.
+
+    Works like DQPtr owning the private object, but stores it in \a Size
+    bytes of storage instead of allocating it separately. This saves a heap
+    allocation and a pointer chase for each object of the public class,
+    while the header still doesn't depend on the private class. The
+    constructor and destructor of the public class have to be defined where
+    the private class is complete; they fail to compile when \a Size is too
+    small. FastPimpl also fits Q_DECLARE_PRIVATE:
+    \code
+    class MyClass
+    {
+    public:
+        MyClass();
+        ~MyClass();
+    private:
+        Q_DECLARE_PRIVATE(MyClass)
+        Utils::FastPimpl<MyClassPrivate, 64> d_ptr;
+    };
+
+    MyClass::MyClass() : d_ptr(this) {}
+    MyClass::~MyClass() {}
+    \endcode
+    Leave some slack in \a Size, as changing it changes the binary interface
+    like adding members does.
+ */
+template <class T, int Size>
+class FastPimpl
+{
+    Q_DISABLE_COPY(FastPimpl)
+
+public:
+    typedef T *pointer;
+
+    //! Constructs the private object by its default constructor.
+    FastPimpl()
+    { check(); new (m_storage.bytes) T; }
+
+    //! Constructs the private object with \a a1, e.g. the public object.
+    template <typename A1>
+    explicit FastPimpl(A1 a1)
+    { check(); new (m_storage.bytes) T(a1); }
+
+    template <typename A1, typename A2>
+    FastPimpl(A1 a1, A2 a2)
+    { check(); new (m_storage.bytes) T(a1, a2); }
+
+    ~FastPimpl()
+    { check(); data()->~T(); }
+
+public:
+    //@{
+    //! \name Imitate a pointer
+    T *operator->()
+    { return data(); }
+
+    const T *operator->() const
+    { return data(); }
+
+    operator T *()
+    { return data(); }
+
+    operator const T *() const
+    { return data(); }
+    //@}
+
+    //! Used by Q_DECLARE_PRIVATE
+    T *data() const
+    { return reinterpret_cast<T *>(const_cast<char *>(m_storage.bytes)); }
+
+private:
+    static void check()
+    {
+        (void) sizeof(Internal::StaticCheck<(sizeof(T) <= Size)>);
+        (void) sizeof(Internal::StaticCheck<
+                (Q_ALIGNOF(T) <= Q_ALIGNOF(Storage))>);
+    }
+
+private:
+    // The members of the union give the strictest common alignment
+    union Storage
+    {
+        char bytes[Size];
+        double d;
+        qint64 i;
+        void *p;
+    };
+    Storage m_storage;
+};
+
 } //namespace Utils
 
 #endif // UTILS_PIMPL_H
@@ -0,0 +1,470 @@
+#include "resultcache.h"
+#include "resultcache_p.h"
+
+#include <QtCore/QSet>
+
+using namespace Utils;
+
+namespace {
+    // Bookkeeping of an entry, added to the sizes of its key and value
+    const qint64 NODE_OVERHEAD = sizeof(ResultCacheShard::Node) + 32;
+    // Share of a shard the protected segment may take (in percent)
+    const int PROTECTED_SHARE = 80;
+
+    inline qint64 entrySize(const QByteArray &key, const QByteArray &value)
+    {
+        return key.size() + value.size() + NODE_OVERHEAD;
+    }
+}
+
+void ResultCacheShard::Segment::prepend(Node *node)
+{
+    node->previous = 0;
+    node->next = first;
+    if (first != 0)
+        first->previous = node;
+    first = node;
+    if (last == 0)
+        last = node;
+    size += node->size;
+}
+
+void ResultCacheShard::Segment::unlink(Node *node)
+{
+    if (node->previous != 0)
+        node->previous->next = node->next;
+    else
+        first = node->next;
+    if (node->next != 0)
+        node->next->previous = node->previous;
+    else
+        last = node->previous;
+    node->previous = 0;
+    node->next = 0;
+    size -= node->size;
+}
+
+ResultCacheShard::~ResultCacheShard()
+{
+    qDeleteAll(nodes);
+}
+
+// Records a hit of the node
+void ResultCacheShard::touch(Node *node)
+{
+    unlinkNode(node);
+    node->isProtected = true;
+    protectedSegment.prepend(node);
+
+    // Entries not used for the longest time get another chance in probation
+    while (protectedSegment.size > protectedBudget
+            && protectedSegment.last != node) {
+        Node *const demoted = protectedSegment.last;
+        protectedSegment.unlink(demoted);
+        demoted->isProtected = false;
+        probation.prepend(demoted);
+    }
+}
+
+void ResultCacheShard::unlinkNode(Node *node)
+{
+    if (node->isProtected)
+        protectedSegment.unlink(node);
+    else
+        probation.unlink(node);
+}
+
+void ResultCacheShard::removeNode(Node *node, bool evicted)
+{
+    unlinkNode(node);
+    nodes.remove(node->key);
+
+    NamespaceState &state = namespaces[node->key.ns];
+    state.size -= node->size;
+    --state.count;
+    if (evicted)
+        ++state.statistics.evictions;
+    cache->account(node->key.ns, -node->size);
+    delete node;
+}
+
+/*
+    Evicts entries of the shard while the cache exceeds the quota of \a ns
+    (if valid) or its budget.
+    Returns false if the shard has no entries left to evict.
+*/
+bool ResultCacheShard::evict(const UniqueId &ns)
+{
+    if (ns.isValid()) {
+        while (cache->quotaExcess(ns) > 0) {
+            Node *const node = victim(ns);
+            if (node == 0)
+                return false;
+            removeNode(node, true);
+        }
+    }
+
+    while (cache->budgetExcess() > 0) {
+        Node *const node = victim(UniqueId());
+        if (node == 0)
+            return false;
+        removeNode(node, true);
+    }
+    return true;
+}
+
+// The least recently used entry of ns (any namespace if invalid), probation
+// first
+ResultCacheShard::Node *ResultCacheShard::victim(const UniqueId &ns) const
+{
+    for (Node *node = probation.last; node != 0; node = node->previous) {
+        if (!ns.isValid() || node->key.ns == ns)
+            return node;
+    }
+    for (Node *node = protectedSegment.last; node != 0; node = node->previous) {
+        if (!ns.isValid() || node->key.ns == ns)
+            return node;
+    }
+    return 0;
+}
+
+ResultCachePrivate::ResultCachePrivate(qint64 budget, int shardCount)
+    : budget(budget),
+    size(0)
+{
+    Q_ASSERT(shardCount > 0);
+    shards.resize(shardCount);
+    for (int i = 0; i < shardCount; ++i) {
+        shards[i] = new ResultCacheShard(this);
+        shards[i]->protectedBudget =
+            budget / shardCount * PROTECTED_SHARE / 100;
+    }
+}
+
+ResultCacheShard &ResultCachePrivate::shard(const ResultCacheKey &key)
+{
+    // The low bits select the bucket within the shard
+    const uint hash = qHash(key) * 0x9e3779b1u;
+    return *shards.at((hash >> 16) % shards.size());
+}
+
+const ResultCacheShard &ResultCachePrivate::shard(
+        const ResultCacheKey &key) const
+{
+    const uint hash = qHash(key) * 0x9e3779b1u;
+    return *shards.at((hash >> 16) % shards.size());
+}
+
+// Adds size bytes, negative when removing, to the usage of ns and the cache
+void ResultCachePrivate::account(const UniqueId &ns, qint64 size)
+{
+    QMutexLocker locker(&usageMutex);
+    this->size += size;
+    usage[ns].size += size;
+}
+
+// The bytes to evict to keep the budget
+qint64 ResultCachePrivate::budgetExcess() const
+{
+    QMutexLocker locker(&usageMutex);
+    return size - budget;
+}
+
+// The bytes of ns to evict to keep its quota, 0 if it has none
+qint64 ResultCachePrivate::quotaExcess(const UniqueId &ns) const
+{
+    QMutexLocker locker(&usageMutex);
+    const Usage nsUsage = usage.value(ns);
+    return nsUsage.quota > 0 ? nsUsage.size - nsUsage.quota : 0;
+}
+
+/*
+    Evicts entries until the budget and the quota of ns (if valid) are kept,
+    from the shards following skip, which is left out. Must be called
+    without holding the mutex of a shard.
+*/
+void ResultCachePrivate::evict(ResultCacheShard *skip, const UniqueId &ns)
+{
+    const int start = shards.indexOf(skip) + 1;
+    for (int i = 0; i < shards.size(); ++i) {
+        ResultCacheShard *const shard = shards.at((start + i) % shards.size());
+        if (shard == skip)
+            continue;
+        QMutexLocker locker(&shard->mutex);
+        if (shard->evict(ns))
+            return;
+    }
+}
+
+/*!
+    \class Utils::ResultCache
+    \brief Memory bounded cache of results shared by plugins
+
+    The entries are byte arrays, stored by namespace and key. Plugins use
+    their own namespace, e.g. UniqueId of the plugin name, and can be
+    limited by a quota. When the cache reaches its budget, it evicts the
+    entries used least recently, preferring entries that were hit only once.
+
+    The cache is split into shards locked independently, so threads working
+    with different keys rarely wait for each other. The budget and quotas
+    apply to the whole cache, a single entry may take up to the budget or
+    the quota of its namespace. Room for a new entry is made in its own
+    shard first, then in the others, thus the entries evicted are the least
+    recently used ones of a shard rather than of the whole cache. Inserts
+    running at the same time may exceed the budget or a quota briefly. All
+    methods are thread-safe. The values are implicitly shared, returning
+    them does not copy the data.
+
+    The cache of the application is available through
+    PluginLoader::PluginManager::resultCache().
+ */
+
+/*!
+    Constructs an empty cache of at most \a budget bytes split into \a
+    shardCount shards.
+ */
+ResultCache::ResultCache(qint64 budget, int shardCount)
+    : d_ptr(new ResultCachePrivate(budget, shardCount))
+{
+}
+
+ResultCache::~ResultCache()
+{
+    Q_D(ResultCache);
+    qDeleteAll(d->shards);
+    delete d_ptr;
+}
+
+//! Sets the memory budget, evicting entries if needed.
+void ResultCache::setBudget(qint64 budget)
+{
+    Q_D(ResultCache);
+    {
+        QMutexLocker locker(&d->usageMutex);
+        d->budget = budget;
+    }
+    foreach (ResultCacheShard *shard, d->shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->protectedBudget =
+            budget / d->shards.size() * PROTECTED_SHARE / 100;
+    }
+    d->evict(0, UniqueId());
+}
+
+qint64 ResultCache::budget() const
+{
+    Q_D(const ResultCache);
+    QMutexLocker locker(&d->usageMutex);
+    return d->budget;
+}
+
+/*!
+    Limits the memory taken by the entries of \a ns to \a quota bytes, 0
+    removes the limit.
+ */
+void ResultCache::setQuota(const UniqueId &ns, qint64 quota)
+{
+    Q_D(ResultCache);
+    Q_ASSERT(ns.isValid());
+
+    {
+        QMutexLocker locker(&d->usageMutex);
+        d->usage[ns].quota = qMax(quota, qint64(0));
+    }
+    if (quota > 0)
+        d->evict(0, ns);
+}
+
+qint64 ResultCache::quota(const UniqueId &ns) const
+{
+    Q_D(const ResultCache);
+    QMutexLocker locker(&d->usageMutex);
+    return d->usage.value(ns).quota;
+}
+
+/*!
+    Stores \a value under \a key in \a ns, replacing the previous value.
+    \return false if the value is too large for the budget or the quota
+ */
+bool ResultCache::insert(const UniqueId &ns, const QByteArray &key,
+        const QByteArray &value)
+{
+    Q_D(ResultCache);
+    Q_ASSERT(ns.isValid());
+
+    const ResultCacheKey cacheKey(ns, key);
+    const qint64 size = entrySize(key, value);
+    const qint64 nsQuota = quota(ns);
+    if (size > budget() || (nsQuota > 0 && size > nsQuota))
+        return false;
+    ResultCacheShard &shard = d->shard(cacheKey);
+
+    QMutexLocker locker(&shard.mutex);
+    if (ResultCacheShard::Node *const old = shard.nodes.value(cacheKey))
+        shard.removeNode(old, false);
+
+    // The entry is counted before it's inserted, so room is made for it in
+    // its own shard first, then in the others
+    d->account(ns, size);
+    const bool evicted = shard.evict(ns);
+
+    ResultCacheShard::Node *const node = new ResultCacheShard::Node;
+    node->key = cacheKey;
+    node->value = value;
+    node->size = size;
+    node->isProtected = false;
+    shard.probation.prepend(node);
+    shard.nodes.insert(cacheKey, node);
+
+    ResultCacheShard::NamespaceState &state = shard.namespaces[ns];
+    state.size += size;
+    ++state.count;
+    ++state.statistics.insertions;
+    locker.unlock();
+
+    if (!evicted)
+        d->evict(&shard, ns);
+    return true;
+}
+
+/*!
+    \return the value stored under \a key in \a ns, a null byte array if
+    there's none
+    \param found if not null, set to whether the value was found
+ */
+QByteArray ResultCache::value(const UniqueId &ns, const QByteArray &key,
+        bool *found)
+{
+    Q_D(ResultCache);
+
+    const ResultCacheKey cacheKey(ns, key);
+    ResultCacheShard &shard = d->shard(cacheKey);
+
+    QMutexLocker locker(&shard.mutex);
+    ResultCacheShard::Node *const node = shard.nodes.value(cacheKey);
+    ResultCache::Statistics &statistics = shard.namespaces[ns].statistics;
+    if (found != 0)
+        *found = node != 0;
+    if (node == 0) {
+        ++statistics.misses;
+        return QByteArray();
+    }
+
+    ++statistics.hits;
+    shard.touch(node);
+    return node->value;
+}
+
+//! Checks for \a key in \a ns without counting a hit or miss.
+bool ResultCache::contains(const UniqueId &ns, const QByteArray &key) const
+{
+    Q_D(const ResultCache);
+
+    const ResultCacheKey cacheKey(ns, key);
+    const ResultCacheShard &shard = d->shard(cacheKey);
+
+    QMutexLocker locker(&shard.mutex);
+    return shard.nodes.contains(cacheKey);
+}
+
+//! \return true if there was a value stored under \a key in \a ns
+bool ResultCache::remove(const UniqueId &ns, const QByteArray &key)
+{
+    Q_D(ResultCache);
+
+    const ResultCacheKey cacheKey(ns, key);
+    ResultCacheShard &shard = d->shard(cacheKey);
+
+    QMutexLocker locker(&shard.mutex);
+    ResultCacheShard::Node *const node = shard.nodes.value(cacheKey);
+    if (node == 0)
+        return false;
+    shard.removeNode(node, false);
+    return true;
+}
+
+//! Removes all entries of \a ns, the statistics are kept.
+void ResultCache::clear(const UniqueId &ns)
+{
+    Q_D(ResultCache);
+    foreach (ResultCacheShard *shard, d->shards) {
+        QMutexLocker locker(&shard->mutex);
+        foreach (ResultCacheShard::Node *node, shard->nodes) {
+            if (node->key.ns == ns)
+                shard->removeNode(node, false);
+        }
+    }
+}
+
+//! Removes all entries, the statistics are kept.
+void ResultCache::clear()
+{
+    Q_D(ResultCache);
+    foreach (ResultCacheShard *shard, d->shards) {
+        QMutexLocker locker(&shard->mutex);
+        foreach (ResultCacheShard::Node *node, shard->nodes)
+            shard->removeNode(node, false);
+    }
+}
+
+//! \return the number of bytes taken by all entries
+qint64 ResultCache::size() const
+{
+    Q_D(const ResultCache);
+    QMutexLocker locker(&d->usageMutex);
+    return d->size;
+}
+
+//! \return the namespaces used so far
+QList<UniqueId> ResultCache::namespaces() const
+{
+    Q_D(const ResultCache);
+    QSet<UniqueId> namespaces;
+    foreach (ResultCacheShard *shard, d->shards) {
+        QMutexLocker locker(&shard->mutex);
+        foreach (const UniqueId &ns, shard->namespaces.keys())
+            namespaces.insert(ns);
+    }
+    return namespaces.toList();
+}
+
+//! \return the counters of \a ns summed over all shards
+ResultCache::Statistics ResultCache::statistics(const UniqueId &ns) const
+{
+    Q_D(const ResultCache);
+    Statistics total;
+    foreach (ResultCacheShard *shard, d->shards) {
+        QMutexLocker locker(&shard->mutex);
+        const ResultCacheShard::NamespaceState state =
+            shard->namespaces.value(ns);
+        total.hits += state.statistics.hits;
+        total.misses += state.statistics.misses;
+        total.insertions += state.statistics.insertions;
+        total.evictions += state.statistics.evictions;
+        total.size += state.size;
+        total.count += state.count;
+    }
+    return total;
+}
+
+/*!
+    Takes a snapshot of the counters. The map contains \c cache.size and
+    \c cache.budget in bytes, and for every namespace \c cache.<namespace>.
+    followed by \c hits, \c misses, \c evictions and \c size.
+ */
+QVariantMap ResultCache::metrics() const
+{
+    QVariantMap metrics;
+    metrics.insert(QLatin1String("cache.size"), size());
+    metrics.insert(QLatin1String("cache.budget"), budget());
+    foreach (const UniqueId &ns, namespaces()) {
+        const Statistics counters = statistics(ns);
+        const QString prefix = QLatin1String("cache.") + ns.toString()
+            + QLatin1Char('.');
+        metrics.insert(prefix + QLatin1String("hits"), counters.hits);
+        metrics.insert(prefix + QLatin1String("misses"), counters.misses);
+        metrics.insert(prefix + QLatin1String("evictions"), counters.evictions);
+        metrics.insert(prefix + QLatin1String("size"), counters.size);
+    }
+    return metrics;
+}
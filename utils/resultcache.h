@@ -0,0 +1,72 @@
+#ifndef UTILS_RESULTCACHE_H
+#define UTILS_RESULTCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QVariantMap>
+
+#include "uniqueid.h"
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class ResultCachePrivate;
+
+class UTILS_EXPORT ResultCache
+{
+    Q_DISABLE_COPY(ResultCache)
+
+public:
+    //! Counters of one namespace
+    struct Statistics
+    {
+        Statistics() : hits(0), misses(0), insertions(0), evictions(0),
+            size(0), count(0) {}
+
+        qint64 hits;
+        qint64 misses;
+        qint64 insertions;
+        //! Entries removed to make room for others
+        qint64 evictions;
+        //! Bytes taken by the entries, including the keys
+        qint64 size;
+        int count;
+    };
+
+    enum {
+        DefaultBudget = 256 * 1024 * 1024,
+        DefaultShardCount = 16
+    };
+
+    explicit ResultCache(qint64 budget = DefaultBudget,
+            int shardCount = DefaultShardCount);
+    ~ResultCache();
+
+    void setBudget(qint64 budget);
+    qint64 budget() const;
+    void setQuota(const UniqueId &ns, qint64 quota);
+    qint64 quota(const UniqueId &ns) const;
+
+    bool insert(const UniqueId &ns, const QByteArray &key,
+            const QByteArray &value);
+    QByteArray value(const UniqueId &ns, const QByteArray &key,
+            bool *found = 0);
+    bool contains(const UniqueId &ns, const QByteArray &key) const;
+    bool remove(const UniqueId &ns, const QByteArray &key);
+    void clear(const UniqueId &ns);
+    void clear();
+
+    qint64 size() const;
+    QList<UniqueId> namespaces() const;
+    Statistics statistics(const UniqueId &ns) const;
+    QVariantMap metrics() const;
+
+private:
+    Q_DECLARE_PRIVATE(ResultCache)
+    ResultCachePrivate *d_ptr;
+};
+
+} // namespace Utils
+
+#endif // UTILS_RESULTCACHE_H
@@ -0,0 +1,132 @@
+#ifndef UTILS_RESULTCACHE_P_H
+#define UTILS_RESULTCACHE_P_H
+/*! \cond __pimpl */
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+
+#include "resultcache.h"
+
+namespace Utils {
+
+class ResultCachePrivate;
+
+struct ResultCacheKey
+{
+    ResultCacheKey() {}
+    ResultCacheKey(const UniqueId &ns, const QByteArray &key)
+        : ns(ns), key(key) {}
+
+    UniqueId ns;
+    QByteArray key;
+};
+
+inline bool operator==(const ResultCacheKey &key1, const ResultCacheKey &key2)
+{
+    return key1.ns == key2.ns && key1.key == key2.key;
+}
+
+inline uint qHash(const ResultCacheKey &key)
+{
+    return qHash(key.ns) ^ qHash(key.key);
+}
+
+/*
+    One independently locked part of the cache. The entries are kept in a
+    segmented LRU: new entries start in the probation segment and move to the
+    protected segment on their second hit. Victims are taken from the
+    probation segment first, so a scan over many keys used once does not
+    flush the entries used repeatedly.
+*/
+class ResultCacheShard
+{
+public:
+    struct Node
+    {
+        ResultCacheKey key;
+        QByteArray value;
+        qint64 size;
+        bool isProtected;
+        Node *previous;
+        Node *next;
+    };
+
+    //! Doubly linked list with the most recently used node first
+    struct Segment
+    {
+        Segment() : first(0), last(0), size(0) {}
+
+        void prepend(Node *node);
+        void unlink(Node *node);
+
+        Node *first;
+        Node *last;
+        qint64 size;
+    };
+
+    struct NamespaceState
+    {
+        NamespaceState() : size(0), count(0) {}
+
+        ResultCache::Statistics statistics;
+        qint64 size;
+        int count;
+    };
+
+    ResultCacheShard(ResultCachePrivate *cache) : cache(cache),
+        protectedBudget(0) {}
+    ~ResultCacheShard();
+
+    void touch(Node *node);
+    void unlinkNode(Node *node);
+    void removeNode(Node *node, bool evicted);
+    bool evict(const UniqueId &ns);
+    Node *victim(const UniqueId &ns) const;
+
+    ResultCachePrivate *const cache;
+    mutable QMutex mutex;
+    QHash<ResultCacheKey, Node *> nodes;
+    Segment probation;
+    Segment protectedSegment;
+    QHash<UniqueId, NamespaceState> namespaces;
+    //! Share of the budget the protected segment of the shard may take
+    qint64 protectedBudget;
+};
+
+/*
+    The budget and the quotas apply to the whole cache. Their usage is
+    counted under usageMutex, which is taken after the mutex of a shard,
+    never before.
+*/
+class ResultCachePrivate
+{
+public:
+    struct Usage
+    {
+        Usage() : quota(0), size(0) {}
+
+        qint64 quota;
+        qint64 size;
+    };
+
+    ResultCachePrivate(qint64 budget, int shardCount);
+
+    ResultCacheShard &shard(const ResultCacheKey &key);
+    const ResultCacheShard &shard(const ResultCacheKey &key) const;
+    void account(const UniqueId &ns, qint64 size);
+    qint64 budgetExcess() const;
+    qint64 quotaExcess(const UniqueId &ns) const;
+    void evict(ResultCacheShard *skip, const UniqueId &ns);
+
+    QVector<ResultCacheShard *> shards;
+    mutable QMutex usageMutex;
+    qint64 budget;
+    qint64 size;
+    QHash<UniqueId, Usage> usage;
+};
+
+} // namespace Utils
+
+/*! \endcond */
+#endif // UTILS_RESULTCACHE_P_H
@@ -4,9 +4,21 @@
 
 namespace Utils {
 
+namespace {
+    // Minimum time between two repaints, about 30 frames per second
+    const int FRAME_INTERVAL = 33;
+    const int PROGRESS_SPACING = 6;
+    const int PROGRESS_HEIGHT = 4;
+}
+
 /*!
   \class SplashScreen
   \brief extended splash that support free text position
+
+  Status and progress changes are painted synchronously, as the event loop
+  usually does not run while the application starts, but at most once per
+  frame interval. A change arriving sooner is painted by the next change
+  after the interval, or once the event loop runs.
   */
 /*!
   Constructor
@@ -15,8 +27,18 @@ namespace Utils {
   */
 SplashScreen::SplashScreen(const QPixmap &pixmap, const QPoint &textPos) :
     QSplashScreen(pixmap),
-    m_textPos(textPos)
+    m_textPos(textPos),
+    m_font("Arial", 8),
+    m_progressDone(0),
+    m_progressTotal(0),
+    m_remainingSeconds(0)
 {
+    // Progress bar below the status text, as wide as the text is indented
+    m_progressRect = QRect(m_textPos.x(), m_textPos.y() + PROGRESS_SPACING,
+            qMax(pixmap.width() - 2 * m_textPos.x(), 0), PROGRESS_HEIGHT);
+
+    m_repaintTimer.setSingleShot(true);
+    connect(&m_repaintTimer, SIGNAL(timeout()), this, SLOT(repaintPending()));
 }
 
 /*!
@@ -24,8 +46,35 @@ SplashScreen::SplashScreen(const QPixmap &pixmap, const QPoint &textPos) :
   */
 void SplashScreen::setStatus(const QString &status)
 {
+    if (status == m_status)
+        return;
     m_status = status;
-    repaint();
+    scheduleRepaint();
+}
+
+/*!
+  \reimp
+  */
+void SplashScreen::setProgress(int done, int total)
+{
+    if (done == m_progressDone && total == m_progressTotal)
+        return;
+    m_progressDone = done;
+    m_progressTotal = total;
+    scheduleRepaint();
+}
+
+/*!
+  \reimp
+  Only whole seconds are shown, shorter times are not worth a repaint.
+  */
+void SplashScreen::setRemainingTime(qint64 msecs)
+{
+    const int seconds = int(qMax(msecs, qint64(0)) / 1000);
+    if (seconds == m_remainingSeconds)
+        return;
+    m_remainingSeconds = seconds;
+    scheduleRepaint();
 }
 
 /*!
@@ -33,8 +82,40 @@ void SplashScreen::setStatus(const QString &status)
   */
 void SplashScreen::drawContents(QPainter *painter)
 {
-    painter->setFont(QFont("Arial", 8));
+    painter->setFont(m_font);
     painter->drawText(m_textPos, m_status);
+
+    if (m_progressTotal > 0 && !m_progressRect.isEmpty()) {
+        const int done = qBound(0, m_progressDone, m_progressTotal);
+        painter->fillRect(m_progressRect, QColor(0, 0, 0, 64));
+        painter->fillRect(m_progressRect.x(), m_progressRect.y(),
+                int(qint64(m_progressRect.width()) * done / m_progressTotal),
+                m_progressRect.height(), painter->pen().color());
+
+        if (m_remainingSeconds > 0) {
+            const QRect textRect(m_progressRect.x(), 0,
+                    m_progressRect.width(), m_textPos.y());
+            painter->drawText(textRect, Qt::AlignRight | Qt::AlignBottom,
+                    tr("%n s left", 0, m_remainingSeconds));
+        }
+    }
+}
+
+void SplashScreen::repaintPending()
+{
+    m_repaintTimer.stop();
+    m_lastRepaint.start();
+    repaint();
+}
+
+void SplashScreen::scheduleRepaint()
+{
+    if (!m_lastRepaint.isValid() || m_lastRepaint.elapsed() >= FRAME_INTERVAL) {
+        repaintPending();
+    }
+    else if (!m_repaintTimer.isActive()) {
+        m_repaintTimer.start(FRAME_INTERVAL - int(m_lastRepaint.elapsed()));
+    }
 }
 
 } // namespace Utils
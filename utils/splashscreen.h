@@ -4,7 +4,10 @@
 #include <QSplashScreen>
 #include "iprogressmonitor.h"
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QPoint>
+#include <QtCore/QRect>
+#include <QtCore/QTimer>
 
 #include "utils_global.h"
 
@@ -19,13 +22,28 @@ public:
 public:
     //from IProgressMonitor
     virtual void setStatus(const QString &status);
+    virtual void setProgress(int done, int total);
+    virtual void setRemainingTime(qint64 msecs);
 protected:
     // From QSplashScreen
     virtual void drawContents(QPainter *painter);
 
+private slots:
+    void repaintPending();
+
+private:
+    void scheduleRepaint();
+
 private:
     QString m_status;
     QPoint m_textPos;
+    QFont m_font;
+    QRect m_progressRect;
+    int m_progressDone;
+    int m_progressTotal;
+    int m_remainingSeconds;
+    QElapsedTimer m_lastRepaint;
+    QTimer m_repaintTimer;
 };
 
 } // namespace Utils
@@ -0,0 +1,57 @@
+#include "stringpool.h"
+#include "stringpool_p.h"
+
+using namespace Utils;
+
+namespace {
+    Q_GLOBAL_STATIC(StringPool, globalPool)
+}
+
+StringPool::StringPool()
+    : d_ptr(new StringPoolPrivate)
+{
+}
+
+StringPool::~StringPool()
+{
+    delete d_ptr;
+}
+
+//! The pool shared by the application and its plugins
+StringPool *StringPool::globalInstance()
+{
+    return globalPool();
+}
+
+//! \return the pooled string equal to \a string, adding it if it's new
+QString StringPool::intern(const QString &string)
+{
+    Q_D(StringPool);
+    if (string.isEmpty())
+        return QString();
+
+    {
+        QReadLocker locker(&d->lock);
+        const QSet<QString>::const_iterator it = d->strings.constFind(string);
+        if (it != d->strings.constEnd())
+            return *it;
+    }
+
+    QWriteLocker locker(&d->lock);
+    return *d->strings.insert(string);
+}
+
+int StringPool::size() const
+{
+    Q_D(const StringPool);
+    QReadLocker locker(&d->lock);
+    return d->strings.size();
+}
+
+//! Drops the pooled strings, the strings handed out stay valid.
+void StringPool::clear()
+{
+    Q_D(StringPool);
+    QWriteLocker locker(&d->lock);
+    d->strings.clear();
+}
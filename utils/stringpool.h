@@ -0,0 +1,42 @@
+#ifndef UTILS_STRINGPOOL_H
+#define UTILS_STRINGPOOL_H
+
+#include <QtCore/QString>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class StringPoolPrivate;
+
+/*!
+    \brief Shares the data of equal strings.
+
+    intern() returns the copy of a string kept by the pool, so all equal
+    strings interned refer to one buffer. This pays off for strings held
+    many times, e.g. the directories of thousands of plugin specs. The pool
+    is thread-safe.
+ */
+class UTILS_EXPORT StringPool
+{
+    Q_DISABLE_COPY(StringPool)
+
+public:
+    StringPool();
+    ~StringPool();
+
+    static StringPool *globalInstance();
+
+    QString intern(const QString &string);
+
+    int size() const;
+    void clear();
+
+private:
+    Q_DECLARE_PRIVATE(StringPool)
+    StringPoolPrivate *d_ptr;
+};
+
+} // namespace Utils
+
+#endif // UTILS_STRINGPOOL_H
@@ -0,0 +1,22 @@
+#ifndef UTILS_STRINGPOOL_P_H
+#define UTILS_STRINGPOOL_P_H
+/*! \cond __pimpl */
+
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSet>
+
+#include "stringpool.h"
+
+namespace Utils {
+
+class StringPoolPrivate
+{
+public:
+    mutable QReadWriteLock lock;
+    QSet<QString> strings;
+};
+
+} // namespace Utils
+
+/*! \endcond */
+#endif // UTILS_STRINGPOOL_P_H
@@ -78,6 +78,18 @@ void StyleSheetLoader::setPaths(const QStringList &paths)
     findFiles();
 }
 
+/*!
+ * Set paths to search for style sheets together with \a styleSheets found
+ * in them by findStyleSheets(), e.g. in another thread while the
+ * application was starting. The paths are not searched again.
+ */
+void StyleSheetLoader::setPaths(const QStringList &paths,
+        const QMap<QString, QString> &styleSheets)
+{
+    m_paths = QSet<QString>::fromList(paths);
+    updateFiles(styleSheets);
+}
+
 //! Query paths searched for style sheets
 QStringList StyleSheetLoader::paths() const
 {
@@ -116,6 +128,12 @@ void StyleSheetLoader::unload()
 void StyleSheetLoader::reload()
 {
     findFiles();
+    activate();
+}
+
+//! Apply active style sheet without searching the paths again
+void StyleSheetLoader::activate()
+{
     unload();
 
     if (m_activeName.isEmpty()) {
@@ -150,11 +168,16 @@ void StyleSheetLoader::saveSettings()
     settings.endGroup();
 }
 
-void StyleSheetLoader::findFiles()
+/*!
+ * Search \a paths and their direct subfolders for style sheets. Does not
+ * touch any instance, so it is safe to call from any thread.
+ * \return paths of the style sheets found by their names
+ */
+QMap<QString, QString> StyleSheetLoader::findStyleSheets(
+        const QStringList &paths)
 {
-    m_namePathMap.clear();
     QFileInfoList infoList;
-    foreach (const QString &path, m_paths) {
+    foreach (const QString &path, paths) {
         QDir dir(path);
         if (!dir.exists()) {
             continue;
@@ -177,16 +200,27 @@ void StyleSheetLoader::findFiles()
         }
     }
 
-    // Update map
+    QMap<QString, QString> styleSheets;
     foreach (const QFileInfo &info, infoList) {
-        m_namePathMap[info.completeBaseName()] = info.absoluteFilePath();
+        styleSheets[info.completeBaseName()] = info.absoluteFilePath();
     }
+    return styleSheets;
+}
+
+void StyleSheetLoader::findFiles()
+{
+    updateFiles(findStyleSheets(m_paths.values()));
+}
+
+void StyleSheetLoader::updateFiles(const QMap<QString, QString> &styleSheets)
+{
+    m_namePathMap = styleSheets;
 
     // Update internal variables if needed
-    if (!m_namePathMap.keys().contains(m_defaultName)) {
+    if (!m_namePathMap.contains(m_defaultName)) {
         m_defaultName.clear();
     }
-    if (!m_namePathMap.keys().contains(m_activeName)) {
+    if (!m_namePathMap.contains(m_activeName)) {
         m_activeName = m_defaultName;
     }
 
@@ -24,6 +24,7 @@ class UTILS_EXPORT StyleSheetLoader : public QObject
 public:
     static StyleSheetLoader *instance();
     static QString fixButtonText(const QString &text);
+    static QMap<QString, QString> findStyleSheets(const QStringList &paths);
 
 public:
     bool isStyleSheetSet() const;
@@ -32,6 +33,8 @@ public:
     QString defaultName() const;
 
     void setPaths(const QStringList &paths);
+    void setPaths(const QStringList &paths,
+            const QMap<QString, QString> &styleSheets);
     QStringList paths() const;
 
     QStringList names() const;
@@ -41,12 +44,14 @@ public slots:
     void load(const QString &name);
     void unload();
     void reload();
+    void activate();
 
 private:
     void restoreSettings();
     void saveSettings();
 
     void findFiles();
+    void updateFiles(const QMap<QString, QString> &styleSheets);
 
 private slots:
     void startWatcherOnActiveFile();
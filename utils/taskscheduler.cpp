@@ -0,0 +1,333 @@
+#include "taskscheduler.h"
+#include "taskscheduler_p.h"
+
+#include <QtCore/QElapsedTimer>
+
+using namespace Utils;
+
+namespace {
+    Q_GLOBAL_STATIC(TaskScheduler, globalScheduler)
+}
+
+/*!
+    \class Utils::Task
+    \brief Unit of work for the TaskScheduler that may have continuations.
+ */
+
+Task::Task()
+    : m_pending(1),
+    m_affinity(TaskScheduler::NoAffinity)
+{
+}
+
+Task::~Task()
+{
+}
+
+/*!
+    Makes \a continuation wait for this task. A continuation may continue
+    several tasks, it starts after the last of them finished. Has to be called
+    before this task is started, \a continuation has to be started as well.
+ */
+void Task::then(Task *continuation)
+{
+    Q_ASSERT(continuation != 0);
+    Q_ASSERT(m_pending != 0);
+    continuation->m_pending.ref();
+    m_continuations.append(continuation);
+}
+
+/*!
+    Asks to run the task by the \a worker of the scheduler, e.g. the worker
+    which already has the data of the task in its cache. It's a hint only,
+    idle workers may still steal the task.
+ */
+void Task::setAffinity(int worker)
+{
+    m_affinity = worker;
+}
+
+int Task::affinity() const
+{
+    return m_affinity;
+}
+
+TaskWorker::TaskWorker(TaskSchedulerPrivate *scheduler, int index)
+    : scheduler(scheduler),
+    index(index),
+    m_seed(uint(index) * 2654435761u + 1)
+{
+}
+
+void TaskWorker::push(QRunnable *runnable)
+{
+    QMutexLocker locker(&m_mutex);
+    m_deque.append(runnable);
+}
+
+// The newest runnable, for the worker itself
+QRunnable *TaskWorker::pop()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_deque.isEmpty())
+        return 0;
+    scheduler->queued.deref();
+    return m_deque.takeLast();
+}
+
+// The oldest runnable, for the other workers
+QRunnable *TaskWorker::steal()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_deque.isEmpty())
+        return 0;
+    scheduler->queued.deref();
+    return m_deque.takeFirst();
+}
+
+void TaskWorker::run()
+{
+    forever {
+        QRunnable *runnable = pop();
+        if (runnable == 0)
+            runnable = stealFromOthers();
+        if (runnable != 0) {
+            scheduler->execute(runnable);
+            continue;
+        }
+        if (!scheduler->waitForWork())
+            return;
+    }
+}
+
+// Tries the other workers once, starting with a random one
+QRunnable *TaskWorker::stealFromOthers()
+{
+    const int count = scheduler->workers.size();
+    if (count < 2 || scheduler->queued == 0)
+        return 0;
+
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    const int first = m_seed % count;
+
+    for (int i = 0; i < count; ++i) {
+        TaskWorker *const victim = scheduler->workers.at((first + i) % count);
+        if (victim == this)
+            continue;
+        if (QRunnable *runnable = victim->steal()) {
+            scheduler->stolen.ref();
+            return runnable;
+        }
+    }
+    return 0;
+}
+
+TaskSchedulerPrivate::TaskSchedulerPrivate(int workerCount)
+    : stopping(false)
+{
+    workers.resize(workerCount);
+    for (int i = 0; i < workerCount; ++i)
+        workers[i] = new TaskWorker(this, i);
+    foreach (TaskWorker *worker, workers)
+        worker->start();
+}
+
+TaskSchedulerPrivate::~TaskSchedulerPrivate()
+{
+    idleMutex.lock();
+    stopping = true;
+    workAvailable.wakeAll();
+    idleMutex.unlock();
+
+    foreach (TaskWorker *worker, workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+//! The worker running the calling thread, 0 for other threads
+TaskWorker *TaskSchedulerPrivate::currentWorker() const
+{
+    TaskWorker *const worker =
+        dynamic_cast<TaskWorker *>(QThread::currentThread());
+    return worker != 0 && worker->scheduler == this ? worker : 0;
+}
+
+void TaskSchedulerPrivate::enqueue(QRunnable *runnable, int affinity)
+{
+    unfinished.ref();
+
+    // Work created by a worker stays with it, unless asked otherwise
+    TaskWorker *worker = 0;
+    if (affinity >= 0)
+        worker = workers.at(affinity % workers.size());
+    else
+        worker = currentWorker();
+    if (worker == 0)
+        worker = workers.at(uint(nextWorker.fetchAndAddRelaxed(1))
+                % workers.size());
+
+    queued.ref();
+    worker->push(runnable);
+
+    // Sleeping workers count themselves idle before they check the queue,
+    // so either they see the runnable or it sees them
+    if (idle > 0) {
+        QMutexLocker locker(&idleMutex);
+        workAvailable.wakeOne();
+    }
+}
+
+void TaskSchedulerPrivate::execute(QRunnable *runnable)
+{
+    Task *const task = dynamic_cast<Task *>(runnable);
+    const bool autoDelete = runnable->autoDelete();
+
+    runnable->run();
+
+    QList<Task *> continuations;
+    if (task != 0)
+        continuations = task->m_continuations;
+    if (autoDelete)
+        delete runnable;
+
+    foreach (Task *continuation, continuations) {
+        if (!continuation->m_pending.deref())
+            enqueue(continuation, continuation->m_affinity);
+    }
+
+    executed.ref();
+    if (!unfinished.deref()) {
+        QMutexLocker locker(&doneMutex);
+        done.wakeAll();
+    }
+}
+
+// Returns false when the worker should finish
+bool TaskSchedulerPrivate::waitForWork()
+{
+    QMutexLocker locker(&idleMutex);
+    idle.ref();
+    while (!stopping && queued == 0)
+        workAvailable.wait(&idleMutex);
+    idle.deref();
+    return !stopping;
+}
+
+/*!
+    \class Utils::TaskScheduler
+    \brief Runs many small tasks on a fixed set of worker threads.
+
+    Each worker has its own deque of runnables. Runnables started by a worker
+    go to its own deque and are run newest first, idle workers steal the
+    oldest runnables of a randomly chosen worker. Unlike the single queue of
+    QThreadPool, starting and taking work rarely contends on a lock.
+
+    Task adds continuations and affinity hints to QRunnable, so dependent
+    work can be expressed without blocking the workers. Runnables must not
+    wait for other runnables of the same scheduler, e.g. by waitForDone().
+ */
+
+/*!
+    Starts \a workerCount workers, 0 starts one per processor core.
+ */
+TaskScheduler::TaskScheduler(int workerCount)
+    : d_ptr(new TaskSchedulerPrivate(workerCount > 0
+                ? workerCount : qMax(QThread::idealThreadCount(), 1)))
+{
+}
+
+/*!
+    Waits for all started runnables and stops the workers.
+ */
+TaskScheduler::~TaskScheduler()
+{
+    waitForDone();
+    delete d_ptr;
+}
+
+//! The scheduler shared by the application and its plugins
+TaskScheduler *TaskScheduler::globalInstance()
+{
+    return globalScheduler();
+}
+
+int TaskScheduler::workerCount() const
+{
+    Q_D(const TaskScheduler);
+    return d->workers.size();
+}
+
+//! \return the index of the worker calling, -1 outside of the workers
+int TaskScheduler::currentWorker() const
+{
+    Q_D(const TaskScheduler);
+    TaskWorker *const worker = d->currentWorker();
+    return worker != 0 ? worker->index : -1;
+}
+
+/*!
+    Runs \a runnable by the worker given by \a affinity, by any worker if it
+    is NoAffinity. The runnable is deleted after running if its autoDelete()
+    is set.
+ */
+void TaskScheduler::start(QRunnable *runnable, int affinity)
+{
+    Q_D(TaskScheduler);
+    Q_ASSERT(runnable != 0);
+    d->enqueue(runnable, affinity);
+}
+
+/*!
+    Runs \a task once all tasks it continues have finished, on the worker
+    given by its affinity.
+    \sa Task::then()
+ */
+void TaskScheduler::start(Task *task)
+{
+    Q_D(TaskScheduler);
+    Q_ASSERT(task != 0);
+    if (!task->m_pending.deref())
+        d->enqueue(task, task->m_affinity);
+}
+
+/*!
+    Waits up to \a timeout milliseconds, -1 for no limit, until all started
+    runnables and their continuations have finished.
+    \return true if all have finished
+ */
+bool TaskScheduler::waitForDone(int timeout)
+{
+    Q_D(TaskScheduler);
+    Q_ASSERT(d->currentWorker() == 0);
+
+    QElapsedTimer timer;
+    timer.start();
+    QMutexLocker locker(&d->doneMutex);
+    while (d->unfinished != 0) {
+        if (timeout < 0) {
+            d->done.wait(&d->doneMutex);
+            continue;
+        }
+        const qint64 remaining = timeout - timer.elapsed();
+        if (remaining <= 0 || !d->done.wait(&d->doneMutex, remaining))
+            return d->unfinished == 0;
+    }
+    return true;
+}
+
+//! \return the number of runnables run so far
+int TaskScheduler::executedCount() const
+{
+    Q_D(const TaskScheduler);
+    return d->executed;
+}
+
+//! \return the number of runnables run by another worker than queued by
+int TaskScheduler::stolenCount() const
+{
+    Q_D(const TaskScheduler);
+    return d->stolen;
+}
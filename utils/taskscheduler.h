@@ -0,0 +1,75 @@
+#ifndef UTILS_TASKSCHEDULER_H
+#define UTILS_TASKSCHEDULER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QRunnable>
+
+#include "utils_global.h"
+
+namespace Utils {
+
+class TaskScheduler;
+class TaskSchedulerPrivate;
+
+/*!
+    \brief Unit of work for the TaskScheduler that may have continuations.
+
+    A continuation registered by then() starts once this task and all other
+    tasks it continues have finished, on the worker that finished the last
+    of them. Like QRunnable, a task is deleted after running when
+    autoDelete() is set.
+ */
+class UTILS_EXPORT Task : public QRunnable
+{
+public:
+    Task();
+    virtual ~Task();
+
+    void then(Task *continuation);
+
+    void setAffinity(int worker);
+    int affinity() const;
+
+private:
+    friend class TaskScheduler;
+    friend class TaskSchedulerPrivate;
+
+    //! Unfinished prerequisites, plus one until the task is started
+    QAtomicInt m_pending;
+    QList<Task *> m_continuations;
+    int m_affinity;
+};
+
+class UTILS_EXPORT TaskScheduler
+{
+    Q_DISABLE_COPY(TaskScheduler)
+
+public:
+    enum {
+        NoAffinity = -1
+    };
+
+    explicit TaskScheduler(int workerCount = 0);
+    ~TaskScheduler();
+
+    static TaskScheduler *globalInstance();
+
+    int workerCount() const;
+    int currentWorker() const;
+
+    void start(QRunnable *runnable, int affinity = NoAffinity);
+    void start(Task *task);
+    bool waitForDone(int timeout = -1);
+
+    int executedCount() const;
+    int stolenCount() const;
+
+private:
+    Q_DECLARE_PRIVATE(TaskScheduler)
+    TaskSchedulerPrivate *d_ptr;
+};
+
+} // namespace Utils
+
+#endif // UTILS_TASKSCHEDULER_H
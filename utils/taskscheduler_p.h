@@ -0,0 +1,79 @@
+#ifndef UTILS_TASKSCHEDULER_P_H
+#define UTILS_TASKSCHEDULER_P_H
+/*! \cond __pimpl */
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+#include "taskscheduler.h"
+
+namespace Utils {
+
+class TaskSchedulerPrivate;
+
+/*
+    Worker thread with its own deque. The worker takes the newest runnable
+    from its back, thieves take the oldest from its front, so the worker
+    keeps running on warm data while others get the large chunks of work.
+*/
+class TaskWorker : public QThread
+{
+public:
+    TaskWorker(TaskSchedulerPrivate *scheduler, int index);
+
+    void push(QRunnable *runnable);
+    QRunnable *pop();
+    QRunnable *steal();
+
+    TaskSchedulerPrivate *const scheduler;
+    const int index;
+
+protected:
+    virtual void run();
+
+private:
+    QRunnable *stealFromOthers();
+
+private:
+    QMutex m_mutex;
+    QList<QRunnable *> m_deque;
+    //! State of the random number generator choosing the victims
+    uint m_seed;
+};
+
+class TaskSchedulerPrivate
+{
+public:
+    TaskSchedulerPrivate(int workerCount);
+    ~TaskSchedulerPrivate();
+
+    TaskWorker *currentWorker() const;
+    void enqueue(QRunnable *runnable, int affinity);
+    void execute(QRunnable *runnable);
+    bool waitForWork();
+
+    QVector<TaskWorker *> workers;
+    //! Runnables in the deques
+    QAtomicInt queued;
+    //! Runnables enqueued and not finished yet
+    QAtomicInt unfinished;
+    QAtomicInt executed;
+    QAtomicInt stolen;
+    //! Spreads the runnables started outside of the workers
+    QAtomicInt nextWorker;
+
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+    QAtomicInt idle;
+    bool stopping;
+
+    QMutex doneMutex;
+    QWaitCondition done;
+};
+
+} // namespace Utils
+
+/*! \endcond */
+#endif // UTILS_TASKSCHEDULER_P_H
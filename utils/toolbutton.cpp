@@ -1,10 +1,26 @@
 #include "toolbutton.h"
 
+#include <QtCore/QCache>
+#include <QtCore/QEvent>
 #include <QtGui/QStylePainter>
 #include <QtGui/QStyleOptionToolButton>
 
 using namespace Utils;
 
+namespace {
+    // Wrap results shared by all buttons. Buttons of a ribbon mostly share
+    // font and width, so laying them out again usually costs a lookup only.
+    enum {
+        WrapCacheSize = 2048
+    };
+
+    QCache<QString, QString> &wrapCache()
+    {
+        static QCache<QString, QString> cache(WrapCacheSize);
+        return cache;
+    }
+}
+
 /*!
  * \class Utils::ToolButton
  * \brief Tool button with automatical text wrapping
@@ -21,8 +37,12 @@ ToolButton::ToolButton(QWidget *parent) :
     txtLayoutPolicy(ToolButton::Eager),
     txtWrapPolicy(ToolButton::WrapAndElide),
     txtMargins(QMargins(0, 0, 0, 0)),
-    updateNeeded(false)
+    updateNeeded(false),
+    sizeHintIconNull(true),
+    sizeHintStyle(-1),
+    sizeHintPopupMode(-1)
 {
+    applyTextFont();
 }
 
 /*!
@@ -70,7 +90,12 @@ void ToolButton::setTextWrapPolicy(TextWrapPolicy policy)
   */
 void ToolButton::setTextMargins(const QMargins &margins)
 {
+    if (margins == txtMargins)
+        return;
+
     txtMargins = margins;
+    cachedSizeHint = QSize();
+    updateGeometry();
 }
 
 /*!
@@ -126,6 +151,18 @@ QSize ToolButton::minimumSizeHint() const
   */
 QSize ToolButton::sizeHint() const
 {
+    // Computed again only when something it depends on has changed
+    if (cachedSizeHint.isValid()
+            && sizeHintText == text()
+            && sizeHintWrapedText == wrapedText
+            && sizeHintFont == font().key()
+            && sizeHintIconSize == iconSize()
+            && sizeHintIconNull == icon().isNull()
+            && sizeHintStyle == toolButtonStyle()
+            && sizeHintPopupMode == popupMode()) {
+        return cachedSizeHint;
+    }
+
     const QSize originalSize = QToolButton::sizeHint();
 
     int w = 0, h = 0;
@@ -173,7 +210,15 @@ QSize ToolButton::sizeHint() const
     if (popupMode() == MenuButtonPopup || popupMode() == InstantPopup)
         w += style()->pixelMetric(QStyle::PM_MenuButtonIndicator);
 
-    return QSize(w, h);
+    cachedSizeHint = QSize(w, h);
+    sizeHintText = text();
+    sizeHintWrapedText = wrapedText;
+    sizeHintFont = font().key();
+    sizeHintIconSize = iconSize();
+    sizeHintIconNull = icon().isNull();
+    sizeHintStyle = toolButtonStyle();
+    sizeHintPopupMode = popupMode();
+    return cachedSizeHint;
 }
 
 /*!
@@ -184,11 +229,13 @@ void ToolButton::paintEvent(QPaintEvent *)
     //if not initialized or if text changed
     if (updateNeeded || wrapedText.isNull() ||
         wrapedText.isEmpty() || text() != oldNotWrapedText) {
-        wrapedText = txtWrapPolicy == ToolButton::WrapAndElide ?
-                     wrapAndElideText(text()) : smartSplit(text());
+        const QString newWrapedText = layoutText(text());
         oldNotWrapedText = text();
         updateNeeded = false;
-        updateGeometry();
+        if (newWrapedText != wrapedText) {
+            wrapedText = newWrapedText;
+            updateGeometry();
+        }
     }
 
     QStylePainter p(this);
@@ -207,52 +254,109 @@ void ToolButton::resizeEvent(QResizeEvent *)
 }
 
 /*!
-  Wraps and elides the given text
+  \reimp
+  */
+void ToolButton::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::FontChange
+            || event->type() == QEvent::StyleChange) {
+        if (event->type() == QEvent::FontChange)
+            applyTextFont();
+        cachedSizeHint = QSize();
+        updateNeeded = true;
+    }
+    QToolButton::changeEvent(event);
+}
+
+/*!
+  Makes the button use the text font size of the ribbon. Done when the
+  button is created or gets another font, never while painting, as setting
+  the font posts change events and relayouts the button.
+  */
+void ToolButton::applyTextFont()
+{
+#ifndef Q_WS_WIN
+    if (font().pixelSize() == TextPixelSize)
+        return;
+
+    QFont textFont = font();
+    textFont.setPixelSize(TextPixelSize);
+    setFont(textFont);
+#endif
+}
+
+/*!
+  Lays out the given text by the wrap policy, reusing the result of any
+  button that laid out the same text with the same font and width
   \param textData input text
-  \return wrapped and elited form of text
+  \return laid out text
   */
-QString ToolButton::wrapAndElideText(const QString &textData)
+QString ToolButton::layoutText(const QString &textData) const
 {
+    const QFont currFont = font();
     const int iconWidth = iconSize().width();
-    const int textWidth = txtLayoutPolicy == ToolButton::Compact
-            ? (iconWidth > minTextWidth ? iconWidth : minTextWidth)
-            : (iconWidth > maxTextWidth ? iconWidth : maxTextWidth);
+    int textWidth;
+    if (txtWrapPolicy == ToolButton::WrapAndElide) {
+        textWidth = txtLayoutPolicy == ToolButton::Compact
+            ? qMax(iconWidth, minTextWidth) : qMax(iconWidth, maxTextWidth);
+    } else {
+        textWidth = qMax(iconWidth, minTextWidth);
+    }
 
-    const QStringList textDataList = textData.split(' ');
+    const QChar separator(0x1f);
+    const QString key = QString::number(txtWrapPolicy) + separator
+        + QString::number(toolButtonStyle()) + separator
+        + QString::number(textWidth) + separator
+        + currFont.key() + separator + textData;
+
+    if (const QString *cached = wrapCache().object(key))
+        return *cached;
 
-#ifdef Q_WS_WIN
-    const QFontMetrics fontMetrics(font());
-#else
-    QFont currFont = font();
-    currFont.setPixelSize(11);
-    setFont(currFont);
     const QFontMetrics fontMetrics(currFont);
-#endif
+    const QString result = txtWrapPolicy == ToolButton::WrapAndElide
+        ? wrapAndElideText(textData, fontMetrics, textWidth)
+        : smartSplit(textData, fontMetrics, textWidth);
+    wrapCache().insert(key, new QString(result));
+    return result;
+}
 
-    QString newTextData = "";
-    QString firstLine = "";
-    QString secondLine = "";
+/*!
+  Wraps and elides the given text
+  \param textData input text
+  \param fontMetrics metrics of the font the text is drawn with
+  \param textWidth maximum width of a line
+  \return wrapped and elited form of text
+  */
+QString ToolButton::wrapAndElideText(const QString &textData,
+        const QFontMetrics &fontMetrics, int textWidth) const
+{
+    const QStringList textDataList = textData.split(' ');
+    const QLatin1Char space(' ');
+
+    QString newTextData;
+    QString firstLine;
+    QString secondLine;
     int lines = 1;
     int index = 1;
-    bool firstWordOnSecondLine = true;
 
     foreach (const QString &textDataPart, textDataList) {
         bool needForElide = false;
         bool needForBreak = false;
-        if (lines == 1 && fontMetrics.width(QString("%1 %2")
-                .arg(firstLine).arg(textDataPart).trimmed()) > textWidth) {
+        if (lines == 1 && fontMetrics.width((firstLine + space
+                + textDataPart).trimmed()) > textWidth) {
             if (index == 1)
                 needForElide = true;
             else
                 ++lines;
-        } else if (lines == 2 && fontMetrics.width(QString("%1 %2")
-                .arg(secondLine).arg(textDataPart).trimmed()) > textWidth) {
+        } else if (lines == 2 && fontMetrics.width((secondLine + space
+                + textDataPart).trimmed()) > textWidth) {
             ++lines;
         }
 
         if (lines == 1) {
-            const QString space = index == 1 ? "" : " ";
-            firstLine.append(QString("%1%2").arg(space).arg(textDataPart));
+            if (index != 1)
+                firstLine += space;
+            firstLine += textDataPart;
 
             if(needForElide || fontMetrics.width(firstLine) > textWidth) {
                 firstLine = fontMetrics.elidedText(firstLine,
@@ -263,9 +367,9 @@ QString ToolButton::wrapAndElideText(const QString &textData)
         }
 
         if (lines >= 2) {
-            const QString space = firstWordOnSecondLine == true ? "" : " ";
-            secondLine.append(QString("%1%2").arg(space).arg(textDataPart));
-            firstWordOnSecondLine = false;
+            if (!secondLine.isEmpty())
+                secondLine += space;
+            secondLine += textDataPart;
         }
 
         if (index == textDataList.size() || needForBreak || lines == 3) {
@@ -275,9 +379,7 @@ QString ToolButton::wrapAndElideText(const QString &textData)
                                         textWidth);
             }
             newTextData = secondLine.isEmpty()
-                    ? firstLine : QString("%1\n%2")
-                        .arg(firstLine)
-                        .arg(secondLine);
+                    ? firstLine : firstLine + QLatin1Char('\n') + secondLine;
 
             newTextData = newTextData.trimmed();
             break;
@@ -292,66 +394,57 @@ QString ToolButton::wrapAndElideText(const QString &textData)
 /*!
   Performs smart split to text
   \param textData input
+  \param fontMetrics metrics of the font the text is drawn with
+  \param textWidth width below which the text is not split
   \return output
   */
-QString ToolButton::smartSplit(const QString &textData)
+QString ToolButton::smartSplit(const QString &textData,
+        const QFontMetrics &fontMetrics, int textWidth) const
 {
-    const int textWidth = iconSize().width() > minTextWidth ?
-                          iconSize().width() : minTextWidth;
-#ifdef Q_WS_WIN
-    const QFontMetrics fontMetrics(font());
-#else
-    QFont currFont = font();
-    currFont.setPixelSize(11);
-    setFont(currFont);
-    const QFontMetrics fontMetrics(currFont);
-#endif
+    const int totalTextWidth = fontMetrics.width(textData);
+    if (totalTextWidth <= textWidth
+            || toolButtonStyle() != Qt::ToolButtonTextUnderIcon)
+        return textData;
 
-    QString newTextData = fontMetrics.width(textData) <= textWidth ||
-        toolButtonStyle() != Qt::ToolButtonTextUnderIcon ? textData : "";
-
-    if (newTextData.isEmpty()) {
-        const int halfTotalTextWidth = fontMetrics.width(textData) / 2;
-        const QStringList textDataList = textData.split(' ');
-        QString firstLine;
-        QString secondLine;
-        QStringListIterator i(textDataList);
-        int index = 1;
-        while (i.hasNext()) {
-            const QString textDataPart = i.next();
-            const int tempStringWidth = fontMetrics.width(QString("%1 %2")
-                            .arg(firstLine).arg(textDataPart).trimmed());
-            /*ident to second line if the width of previously composed
-              string + width of the new part is bigger than half of width of
-              the original not indented string AND if the width of newly
-              composed string - the width of a half of the original string
-              is bigger than half width of the new part
-            */
-            if (tempStringWidth > halfTotalTextWidth
-                    && (tempStringWidth - halfTotalTextWidth)
-                        > (fontMetrics.width(textDataPart) / 2)) {
-                if (index == 1) {
-                    firstLine.append(textDataPart);
-                } else {
-                    secondLine.append(QString("%1 ").arg(textDataPart));
-                }
-
-                while (i.hasNext()) {
-                    secondLine.append(QString("%1 ").arg(i.next()));
-                }
-
-                secondLine = secondLine.trimmed();
-                break;
+    const QLatin1Char space(' ');
+    const int halfTotalTextWidth = totalTextWidth / 2;
+    const QStringList textDataList = textData.split(' ');
+    QString firstLine;
+    QString secondLine;
+    QStringListIterator i(textDataList);
+    int index = 1;
+    while (i.hasNext()) {
+        const QString textDataPart = i.next();
+        const int tempStringWidth = fontMetrics.width(
+                (firstLine + space + textDataPart).trimmed());
+        /*ident to second line if the width of previously composed
+          string + width of the new part is bigger than half of width of
+          the original not indented string AND if the width of newly
+          composed string - the width of a half of the original string
+          is bigger than half width of the new part
+        */
+        if (tempStringWidth > halfTotalTextWidth
+                && (tempStringWidth - halfTotalTextWidth)
+                    > (fontMetrics.width(textDataPart) / 2)) {
+            if (index == 1) {
+                firstLine.append(textDataPart);
             } else {
-                firstLine.append(QString("%1 ").arg(textDataPart));
+                secondLine.append(textDataPart).append(space);
             }
 
-            ++index;
+            while (i.hasNext()) {
+                secondLine.append(i.next()).append(space);
+            }
+
+            secondLine = secondLine.trimmed();
+            break;
+        } else {
+            firstLine.append(textDataPart).append(space);
         }
 
-        newTextData = QString("%1\n%2").arg(firstLine.trimmed())
-                      .arg(secondLine.trimmed()).trimmed();
+        ++index;
     }
 
-    return newTextData;
+    return (firstLine.trimmed() + QLatin1Char('\n')
+            + secondLine.trimmed()).trimmed();
 }
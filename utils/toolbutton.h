@@ -5,6 +5,10 @@
 
 #include "utils_global.h"
 
+QT_BEGIN_NAMESPACE
+class QFontMetrics;
+QT_END_NAMESPACE
+
 namespace Utils {
 
 class UTILS_EXPORT ToolButton : public QToolButton
@@ -38,17 +42,23 @@ public:
 protected:
      virtual void paintEvent(QPaintEvent *);
      virtual void resizeEvent(QResizeEvent *);
+     virtual void changeEvent(QEvent *);
 
 private:
-     QString wrapAndElideText(const QString &textData);
-     QString smartSplit(const QString &textData);
+     void applyTextFont();
+     QString layoutText(const QString &textData) const;
+     QString wrapAndElideText(const QString &textData,
+             const QFontMetrics &fontMetrics, int textWidth) const;
+     QString smartSplit(const QString &textData,
+             const QFontMetrics &fontMetrics, int textWidth) const;
 
 private:
     enum {
         DefaultMinTextWidth = 16,
         DefaultMaxTextWidth = 5555,
         LargeVariationWidth = 32,
-        DefaultLargeVariationPadding = 4
+        DefaultLargeVariationPadding = 4,
+        TextPixelSize = 11
     };
     int minTextWidth;
     int maxTextWidth;
@@ -61,6 +71,16 @@ private:
     QString oldNotWrapedText;
 
     bool updateNeeded;
+
+    // sizeHint() and what it was computed from
+    mutable QSize cachedSizeHint;
+    mutable QString sizeHintText;
+    mutable QString sizeHintWrapedText;
+    mutable QString sizeHintFont;
+    mutable QSize sizeHintIconSize;
+    mutable bool sizeHintIconNull;
+    mutable int sizeHintStyle;
+    mutable int sizeHintPopupMode;
 };
 
 } //namespace Utils
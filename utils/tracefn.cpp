@@ -0,0 +1,14 @@
+#include "tracefn.h"
+
+using namespace Utils;
+
+/*! \cond false */
+// Tracing is on by default in debug builds only, it can be switched at
+// runtime (e.g. through the application's control endpoint) in any build.
+// Initialized statically, so tracers of static constructors see it.
+#if defined(QT_NO_DEBUG)
+QBasicAtomicInt Tracer::m_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+#else
+QBasicAtomicInt Tracer::m_enabled = Q_BASIC_ATOMIC_INITIALIZER(1);
+#endif
+/*! \endcond */
@@ -3,35 +3,42 @@
 
 #include "utils_global.h"
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QtGlobal>
 
 namespace Utils {
 
 /*! \cond false */ /* undocumented feature */
-#if defined(QT_NO_DEBUG)
-# define TraceFn() /* nothing */
-#else
-# define TraceFn() Utils::Tracer(this, Q_FUNC_INFO);
+#define TraceFn() Utils::Tracer tracer_(this, Q_FUNC_INFO);
 class UTILS_EXPORT Tracer
 {
 public:
     Tracer(const void *instance, const char *function)
         : m_instance(instance),
-          m_function(function)
+          m_function(function),
+          m_active(m_enabled != 0)
     {
-        qDebug("%s: %p/%p [[[", m_function, m_instance, this);
+        if (m_active)
+            qDebug("%s: %p/%p [[[", m_function, m_instance, this);
     }
 
     ~Tracer()
     {
-        qDebug("%s: %p/%p ]]]", m_function, m_instance, this);
+        if (m_active)
+            qDebug("%s: %p/%p ]]]", m_function, m_instance, this);
     }
 
+    static bool isEnabled() { return m_enabled != 0; }
+    static void setEnabled(bool enabled)
+    { m_enabled.fetchAndStoreOrdered(enabled ? 1 : 0); }
+
 private:
     const void *const m_instance;
     const char *const m_function;
+    const bool m_active;
+    //! Switched by the control server while other threads trace
+    static QBasicAtomicInt m_enabled;
 };
-#endif
 /*! \endcond */
 
 } //namespace Utils
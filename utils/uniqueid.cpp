@@ -1,22 +1,31 @@
 #include "uniqueid.h"
 
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QVector>
 #if defined(QT_DEBUG)
 #include <QtCore/QRegExp>
 #endif
 
 using namespace Utils;
 
+namespace {
+    // Ids are made by any thread, e.g. while plugin specs are read in
+    // parallel, and mostly looked up
+    struct Registry
+    {
+        QReadWriteLock lock;
+        QHash<QString, int> ids;
+        QVector<QString> names;
+    };
+
+    Q_GLOBAL_STATIC(Registry, registry)
+}
+
 /*!
  * \class Utils::UniqueId
  * \brief Fast manipulation with human-readable unique identifiers
  */
 
-/*!
-  \var UniqueId::m_idMap
-  id map
-  */
-QHash<QString, int> UniqueId::m_idMap;
-
 /*!
  * \fn Utils::UniqueId::UniqueId()
  * \brief Constructs an invalid ID
@@ -33,25 +42,61 @@ QHash<QString, int> UniqueId::m_idMap;
  * \brief Primary constructor
  */
 
-int UniqueId::uniqueId(const QString &id)
+int UniqueId::uniqueId(const QString &id, bool checkSpaces)
 {
     Q_ASSERT(!id.isEmpty());
 
-    const QHash<QString, int>::const_iterator it = m_idMap.find(id);
-    if (it != m_idMap.end())
+    Registry *const r = registry();
+    {
+        QReadLocker locker(&r->lock);
+        const QHash<QString, int>::const_iterator it = r->ids.constFind(id);
+        if (it != r->ids.constEnd())
+            return *it;
+    }
+
+    QWriteLocker locker(&r->lock);
+    // Another thread may have added it meanwhile
+    const QHash<QString, int>::const_iterator it = r->ids.constFind(id);
+    if (it != r->ids.constEnd())
         return *it;
 
 #if defined(QT_DEBUG)
     static QRegExp *const space = new QRegExp("\\s");
-    if (id.contains(*space))
+    if (checkSpaces && id.contains(*space))
         qWarning("%s: id contains spaces <%s>", Q_FUNC_INFO, qPrintable(id));
 #endif
 
-    const int uid = m_idMap.size();
-    m_idMap.insert(id, uid);
+    const int uid = r->names.size();
+    r->ids.insert(id, uid);
+    r->names.append(id);
     return uid;
 }
 
+bool UniqueId::hasUniqueId(const QString &id)
+{
+    Registry *const r = registry();
+    QReadLocker locker(&r->lock);
+    return r->ids.contains(id);
+}
+
+QString UniqueId::toString() const
+{
+    Q_ASSERT(isKnown(m_id));
+    if (m_id == INVALID_ID)
+        return QString();
+
+    Registry *const r = registry();
+    QReadLocker locker(&r->lock);
+    return r->names.at(m_id);
+}
+
+bool UniqueId::isKnown(int id)
+{
+    Registry *const r = registry();
+    QReadLocker locker(&r->lock);
+    return id >= INVALID_ID && id < r->names.size();
+}
+
 /*!
  * \fn bool Utils::UniqueId::isValid() const
  * \brief ID contructed using the default constructor is invalid
@@ -100,6 +145,13 @@ int UniqueId::uniqueId(const QString &id)
  * \see toInt(), fromInt(int id)
  */
 
+/*!
+ * \fn Utils::UniqueId::fromName(const QString &name)
+ * \brief Constructs the ID of a \a name read from data, e.g. a plugin spec
+ *
+ * Unlike the constructors it accepts names containing spaces silently.
+ */
+
 /*!
  * \fn Utils::UniqueId::operator=(const QString &id)
  * \brief Assignment operator
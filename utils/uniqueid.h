@@ -18,7 +18,7 @@ public:
 
 public:
     static inline bool hasUniqueId(const char *id);
-    static inline bool hasUniqueId(const QString &id);
+    static bool hasUniqueId(const QString &id);
 
 public:
     bool isValid() const;
@@ -29,6 +29,7 @@ public:
     inline int toInt() const;
     static UniqueId fromInt(int id);
     static UniqueId fromInt(int id, bool *ok);
+    static inline UniqueId fromName(const QString &name);
 
 public:
     UniqueId &operator=(const char *id);
@@ -40,15 +41,14 @@ public:
 
 private:
     explicit inline UniqueId(int id);
-    static int uniqueId(const QString &id);
-    static inline bool isKnown(int id);
+    static int uniqueId(const QString &id, bool checkSpaces = true);
+    static bool isKnown(int id);
 
 private:
     enum {
         INVALID_ID = -1
     };
     int m_id;
-    static QHash<QString, int> m_idMap;
 };
 
 /*! \relates UniqueId */
@@ -77,22 +77,11 @@ inline bool UniqueId::hasUniqueId(const char *id)
     return hasUniqueId(QString(id));
 }
 
-inline bool UniqueId::hasUniqueId(const QString &id)
-{
-    return m_idMap.contains(id);
-}
-
 inline bool UniqueId::isValid() const
 {
     return m_id != INVALID_ID;
 }
 
-inline QString UniqueId::toString() const
-{
-    Q_ASSERT(isKnown(m_id));
-    return m_idMap.key(m_id);
-}
-
 inline QByteArray UniqueId::toLocal8Bit() const
 {
     return toString().toLocal8Bit();
@@ -115,6 +104,11 @@ inline UniqueId UniqueId::fromInt(int id, bool *ok)
     return UniqueId((*ok = isKnown(id)) ? id : INVALID_ID);
 }
 
+inline UniqueId UniqueId::fromName(const QString &name)
+{
+    return UniqueId(uniqueId(name, false));
+}
+
 inline UniqueId &UniqueId::operator=(const QString &id)
 {
     m_id = uniqueId(id);
@@ -150,11 +144,6 @@ inline UniqueId::UniqueId(int id)
     Q_ASSERT(isKnown(id));
 }
 
-inline bool UniqueId::isKnown(int id)
-{
-    return id >= INVALID_ID && id < m_idMap.size();
-}
-
 } //namespace Utils
 
 #if defined(Q_CC_MSVC)
@@ -19,18 +19,40 @@ SOURCES += configuration.cpp \
 
 HEADERS += debugger.h
 SOURCES += debugger.cpp
+win32:LIBS += -lpsapi
 
 HEADERS += dependencygraph.h
 
 HEADERS += uniqueid.h
 SOURCES += uniqueid.cpp
 
+HEADERS += stringpool.h stringpool_p.h
+SOURCES += stringpool.cpp
+
+HEADERS += resultcache.h resultcache_p.h
+SOURCES += resultcache.cpp
+
+HEADERS += taskscheduler.h taskscheduler_p.h
+SOURCES += taskscheduler.cpp
+
+HEADERS += future.h
+SOURCES += future.cpp
+
+HEADERS += arena.h
+SOURCES += arena.cpp
+
+HEADERS += objectpool.h objectpool_p.h
+SOURCES += objectpool.cpp
+
 HEADERS += filehelper.h
 SOURCES += filehelper.cpp
 
 HEADERS += stylesheetloader.h
 SOURCES += stylesheetloader.cpp
 
+HEADERS += iconthemeindex.h
+SOURCES += iconthemeindex.cpp
+
 HEADERS += filenamedelegate.h
 SOURCES += filenamedelegate.cpp
 
@@ -40,3 +62,4 @@ SOURCES += filesystemwatcher.cpp
 HEADERS += pimpl.h
 
 HEADERS += tracefn.h
+SOURCES += tracefn.cpp